@@ -0,0 +1,808 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <ftw.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "util.h"
+
+// build-cache restore <KEY> <INSTALL-DIR>
+// build-cache store   <KEY> <INSTALL-DIR> <PACKAGE-SPEC>
+// build-cache stats
+// build-cache prune   [--max-size=<SIZE>] [--max-age=<DAYS>] [--dry-run]
+//
+// the installed trees are kept in $PPKG_BUILD_CACHE_DIR, one directory per build key:
+//
+// <KEY>/tree  a copy of the install directory, without .ppkg/MANIFEST.txt and .ppkg/RECEIPT.yml
+// <KEY>/info  <name>\t<value> lines: prefix, package, size, created, lastused, hits
+//
+// restore : copy <KEY>/tree to <INSTALL-DIR>, which must not exist. exit 10 if there is no such key.
+//           a package might have its install directory embedded in its files and symlinks, every occurrence of the prefix it was built with
+//           is replaced with <INSTALL-DIR> while copying. this is only possible when both have the same length, exit 10 otherwise.
+//           the modes and the modification times of the files are kept. the paths of the relocated regular files are printed.
+// store   : copy <INSTALL-DIR> to <KEY>/tree, an existing key is kept as is.
+// stats   : show every key and a summary.
+// prune   : remove the keys which were not used in the last <DAYS> days, then the least recently used ones until the total size
+//           is not greater than <SIZE>, which may have a K, M, G or T suffix. all of them are removed if neither is given.
+//
+// if PPKG_BUILD_CACHE_READONLY=1 is set, the cache directory is never modified: store does nothing, prune is refused, restore does not count hits.
+// this is meant for a cache directory shared by many machines, which is filled by one of them.
+//
+// a key is written to <KEY>.<PID>.tmp then renamed, so that a half-written key is never seen.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char *  key;
+    char *  dir;
+    char *  prefix;
+    char *  package;
+    int64_t size;
+    int64_t created;
+    int64_t lastused;
+    int64_t hits;
+} Entry;
+
+typedef struct {
+    Entry * items;
+    size_t  size;
+    size_t  capacity;
+} Entries;
+
+static const char * cacheDir;
+
+static int readonly;
+
+/////////////////////////////////////////////////////////////////
+
+static int is_build_key(const char * name) {
+    for (int i = 0; i < 64; i++) {
+        if (!isxdigit((unsigned char)name[i]) || isupper((unsigned char)name[i])) {
+            return 0;
+        }
+    }
+
+    return name[64] == '\0';
+}
+
+static char * tmp_path_of(const char * path) {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), ".%d.tmp", (int)getpid());
+
+    return strdup3(path, "", buf);
+}
+
+// returns 1 if the info file is missing or has no prefix.
+static int info_read(Entry * entry) {
+    char * path = strdup3(entry->dir, "/", "info");
+
+    FILE * file = fopen(path, "r");
+
+    free(path);
+
+    if (file == NULL) {
+        return 1;
+    }
+
+    char * line = NULL;
+    size_t lineCapacity = 0;
+
+    for (;;) {
+        ssize_t n = getline(&line, &lineCapacity, file);
+
+        if (n < 0) break;
+
+        if (n > 0 && line[n - 1] == '\n') {
+            line[--n] = '\0';
+        }
+
+        char * value = strchr(line, '\t');
+
+        if (value == NULL) continue;
+
+        *value++ = '\0';
+
+        if (strcmp(line, "prefix") == 0) {
+            free(entry->prefix);
+            entry->prefix = strdup2(value);
+        } else if (strcmp(line, "package") == 0) {
+            free(entry->package);
+            entry->package = strdup2(value);
+        } else if (strcmp(line, "size") == 0) {
+            entry->size = (int64_t)strtoll(value, NULL, 10);
+        } else if (strcmp(line, "created") == 0) {
+            entry->created = (int64_t)strtoll(value, NULL, 10);
+        } else if (strcmp(line, "lastused") == 0) {
+            entry->lastused = (int64_t)strtoll(value, NULL, 10);
+        } else if (strcmp(line, "hits") == 0) {
+            entry->hits = (int64_t)strtoll(value, NULL, 10);
+        }
+    }
+
+    free(line);
+
+    fclose(file);
+
+    return entry->prefix == NULL ? 1 : 0;
+}
+
+// concurrent restores might lose a hit of each other, it is only a hint.
+static int info_write(const Entry * entry) {
+    char * path    = strdup3(entry->dir, "/", "info");
+    char * tmpPath = tmp_path_of(path);
+
+    FILE * file = fopen(tmpPath, "w");
+
+    if (file == NULL) {
+        perror(tmpPath);
+        free(path);
+        free(tmpPath);
+        return 1;
+    }
+
+    fprintf(file, "prefix\t%s\n",     entry->prefix);
+    fprintf(file, "package\t%s\n",    entry->package == NULL ? "" : entry->package);
+    fprintf(file, "size\t%lld\n",     (long long)entry->size);
+    fprintf(file, "created\t%lld\n",  (long long)entry->created);
+    fprintf(file, "lastused\t%lld\n", (long long)entry->lastused);
+    fprintf(file, "hits\t%lld\n",     (long long)entry->hits);
+
+    int ret = 0;
+
+    if (fflush(file) != 0 || ferror(file)) {
+        perror(tmpPath);
+        ret = 1;
+    }
+
+    fclose(file);
+
+    if (ret == 0 && rename(tmpPath, path) != 0) {
+        perror(path);
+        ret = 1;
+    }
+
+    if (ret != 0) {
+        unlink(tmpPath);
+    }
+
+    free(path);
+    free(tmpPath);
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int remove_one(const char * fpath, const struct stat * st, int typeflag, struct FTW * ftwbuf) {
+    (void)st;
+    (void)ftwbuf;
+
+    if (typeflag == FTW_DP) {
+        // a read-only directory can not be emptied.
+        chmod(fpath, 0700);
+    }
+
+    if (remove(fpath) != 0 && errno != ENOENT) {
+        perror(fpath);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int remove_tree(const char * path) {
+    struct stat st;
+
+    if (lstat(path, &st) != 0) {
+        return errno == ENOENT ? 0 : 1;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        chmod(path, 0700);
+    }
+
+    return nftw(path, remove_one, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// the state of copy_tree, since nftw takes no user data.
+static size_t       copyFromLength;
+static const char * copyTo;
+static const char * relocateFrom;
+static const char * relocateTo;
+static size_t       relocateLength;
+static int          copySkipsMetadata;
+static int64_t      copiedSize;
+
+// replace every occurrence of relocateFrom with relocateTo in place, both have the same length. returns the number of them.
+static size_t relocate(unsigned char * buf, size_t size) {
+    size_t count = 0;
+
+    if (relocateFrom == NULL || size < relocateLength) {
+        return 0;
+    }
+
+    const unsigned char first = (unsigned char)relocateFrom[0];
+
+    unsigned char * p   = buf;
+    unsigned char * end = buf + size - relocateLength + 1;
+
+    while (p < end) {
+        p = (unsigned char*)memchr(p, first, (size_t)(end - p));
+
+        if (p == NULL) break;
+
+        if (memcmp(p, relocateFrom, relocateLength) == 0) {
+            memcpy(p, relocateTo, relocateLength);
+            p += relocateLength;
+            count++;
+        } else {
+            p++;
+        }
+    }
+
+    return count;
+}
+
+static int copy_regular_file(const char * from, const char * to, const struct stat * st) {
+    int ifd = open(from, O_RDONLY);
+
+    if (ifd == -1) {
+        perror(from);
+        return 1;
+    }
+
+    int ofd = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+    if (ofd == -1) {
+        perror(to);
+        close(ifd);
+        return 1;
+    }
+
+    int ret = 0;
+
+    if (st->st_size > 0) {
+        size_t size = (size_t)st->st_size;
+
+        // a private writable mapping, the changes made by relocate are never written back to the source file.
+        unsigned char * buf = (unsigned char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, ifd, 0);
+
+        if (buf == MAP_FAILED) {
+            perror(from);
+            ret = 1;
+        } else {
+            // a relocated Mach-O file has to be signed again.
+            if (relocate(buf, size) > 0) {
+                printf("%s%s\n", relocateTo, to + strlen(copyTo));
+            }
+
+            if (write_fully(ofd, buf, size) != 0) {
+                perror(to);
+                ret = 1;
+            }
+
+            munmap(buf, size);
+        }
+    }
+
+    if (ret == 0) {
+        struct timespec times[2];
+
+        times[0].tv_sec  = ST_MTIME_SEC(*st);
+        times[0].tv_nsec = ST_MTIME_NSEC(*st);
+        times[1] = times[0];
+
+        if (fchmod(ofd, st->st_mode & 07777) != 0 || futimens(ofd, times) != 0) {
+            perror(to);
+            ret = 1;
+        }
+    }
+
+    if (close(ofd) != 0 && ret == 0) {
+        perror(to);
+        ret = 1;
+    }
+
+    close(ifd);
+
+    if (ret == 0) {
+        copiedSize += (int64_t)st->st_size;
+    }
+
+    return ret;
+}
+
+static int copy_symlink(const char * from, const char * to, const struct stat * st) {
+    size_t capacity = (size_t)st->st_size + 1;
+
+    if (capacity < 256) {
+        capacity = 256;
+    }
+
+    char * target = (char*)malloc(capacity);
+
+    if (target == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    ssize_t n = readlink(from, target, capacity - 1);
+
+    if (n < 0) {
+        perror(from);
+        free(target);
+        return 1;
+    }
+
+    target[n] = '\0';
+
+    relocate((unsigned char*)target, (size_t)n);
+
+    int ret = 0;
+
+    if (symlink(target, to) != 0) {
+        perror(to);
+        ret = 1;
+    }
+
+    free(target);
+
+    return ret;
+}
+
+static int copy_one(const char * fpath, const struct stat * st, int typeflag, struct FTW * ftwbuf) {
+    (void)ftwbuf;
+
+    const char * relativePath = fpath + copyFromLength;
+
+    // they are regenerated by ppkg for every installation.
+    if (copySkipsMetadata && (strcmp(relativePath, "/.ppkg/MANIFEST.txt") == 0 || strcmp(relativePath, "/.ppkg/RECEIPT.yml") == 0)) {
+        return 0;
+    }
+
+    char * to = strdup3(copyTo, "", relativePath);
+
+    int ret = 0;
+
+    switch (typeflag) {
+        case FTW_D:
+            // a directory has to be writable while it is being filled, copy_tree gives it its own mode afterwards.
+            if (mkdir(to, 0700) != 0) {
+                perror(to);
+                ret = 1;
+            }
+            break;
+        case FTW_F:
+            if (S_ISREG(st->st_mode)) {
+                ret = copy_regular_file(fpath, to, st);
+            }
+            break;
+        case FTW_SL:
+            ret = copy_symlink(fpath, to, st);
+            break;
+        default:
+            fprintf(stderr, "can not read %s\n", fpath);
+            ret = 1;
+    }
+
+    free(to);
+
+    return ret;
+}
+
+
+// give the copied directories the modes of the source directories, after all of them are filled.
+static int copy_dir_mode_one(const char * fpath, const struct stat * st, int typeflag, struct FTW * ftwbuf) {
+    (void)ftwbuf;
+
+    if (typeflag != FTW_DP) {
+        return 0;
+    }
+
+    char * to = strdup3(copyTo, "", fpath + copyFromLength);
+
+    int ret = 0;
+
+    if (chmod(to, st->st_mode & 07777) != 0) {
+        perror(to);
+        ret = 1;
+    }
+
+    free(to);
+
+    return ret;
+}
+
+// copy the tree <FROM> to <TO>, every occurrence of <RELOCATE-FROM> is replaced with <RELOCATE-TO> if it is not NULL.
+static int copy_tree(const char * from, const char * to, const char * relocateFrom_, const char * relocateTo_, int skipsMetadata) {
+    copyFromLength    = strlen(from);
+    copyTo            = to;
+    relocateFrom      = relocateFrom_;
+    relocateTo        = relocateTo_;
+    relocateLength    = relocateFrom_ == NULL ? 0 : strlen(relocateFrom_);
+    copySkipsMetadata = skipsMetadata;
+    copiedSize        = 0;
+
+    if (nftw(from, copy_one, 16, FTW_PHYS) != 0) {
+        return 1;
+    }
+
+    return nftw(from, copy_dir_mode_one, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int restore(const char * key, const char * installDir) {
+    Entry entry = {0};
+
+    entry.key = (char*)key;
+    entry.dir = strdup3(cacheDir, "/", key);
+
+    if (!is_directory(entry.dir) || info_read(&entry) != 0) {
+        return 10;
+    }
+
+    if (strlen(entry.prefix) != strlen(installDir)) {
+        fprintf(stderr, "%s was built in %s, it can not be relocated to %s\n", key, entry.prefix, installDir);
+        return 10;
+    }
+
+    if (exists(installDir)) {
+        fprintf(stderr, "%s already exists.\n", installDir);
+        return 1;
+    }
+
+    char * treeDir = strdup3(entry.dir, "/", "tree");
+    char * tmpDir  = tmp_path_of(installDir);
+
+    remove_tree(tmpDir);
+
+    // the files are copied with the final prefix, only the top directory is renamed at last.
+    int ret = copy_tree(treeDir, tmpDir, entry.prefix, installDir, 0);
+
+    if (ret == 0 && rename(tmpDir, installDir) != 0) {
+        perror(installDir);
+        ret = 1;
+    }
+
+    if (ret != 0) {
+        remove_tree(tmpDir);
+        return ret;
+    }
+
+    if (!readonly) {
+        entry.lastused = (int64_t)time(NULL);
+        entry.hits++;
+        info_write(&entry);
+    }
+
+    return 0;
+}
+
+static int store(const char * key, const char * installDir, const char * packageSpec) {
+    if (readonly) {
+        fprintf(stderr, "%s is read-only, %s is not stored.\n", cacheDir, key);
+        return 0;
+    }
+
+    char * dir = strdup3(cacheDir, "/", key);
+
+    if (is_directory(dir)) {
+        return 0;
+    }
+
+    if (!is_directory(installDir)) {
+        fprintf(stderr, "%s was expected to be a directory, but it was not.\n", installDir);
+        return 1;
+    }
+
+    if (mkdir(cacheDir, 0755) != 0 && errno != EEXIST) {
+        perror(cacheDir);
+        return 1;
+    }
+
+    char * tmpDir = tmp_path_of(dir);
+
+    remove_tree(tmpDir);
+
+    if (mkdir(tmpDir, 0755) != 0) {
+        perror(tmpDir);
+        return 1;
+    }
+
+    Entry entry = {0};
+
+    entry.key     = (char*)key;
+    entry.dir     = tmpDir;
+    entry.prefix  = (char*)installDir;
+    entry.package = (char*)packageSpec;
+
+    char * treeDir = strdup3(tmpDir, "/", "tree");
+
+    int ret = copy_tree(installDir, treeDir, NULL, NULL, 1);
+
+    if (ret == 0) {
+        entry.size     = copiedSize;
+        entry.created  = (int64_t)time(NULL);
+        entry.lastused = entry.created;
+
+        ret = info_write(&entry);
+    }
+
+    if (ret == 0 && rename(tmpDir, dir) != 0) {
+        // another installation has stored the same key in the meantime.
+        if (errno != EEXIST && errno != ENOTEMPTY) {
+            perror(dir);
+            ret = 1;
+        }
+    }
+
+    remove_tree(tmpDir);
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// every key of $PPKG_BUILD_CACHE_DIR, the stale temporary directories are put in <STALE> if it is not NULL.
+static int scan_cache_dir(Entries * entries, Entries * stale) {
+    DIR * d = opendir(cacheDir);
+
+    if (d == NULL) {
+        if (errno == ENOENT) return 0;
+        perror(cacheDir);
+        return 1;
+    }
+
+    time_t now = time(NULL);
+
+    struct dirent * e;
+
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+
+        Entries * list;
+
+        if (is_build_key(e->d_name)) {
+            list = entries;
+        } else if (stale != NULL && ends_with(e->d_name, ".tmp")) {
+            // a temporary directory which was not renamed within a day was left by a killed installation.
+            char * path = strdup3(cacheDir, "/", e->d_name);
+
+            struct stat st;
+
+            if (lstat(path, &st) != 0 || now - ST_MTIME_SEC(st) < 86400) {
+                free(path);
+                continue;
+            }
+
+            free(path);
+
+            list = stale;
+        } else {
+            continue;
+        }
+
+        if (list->size == list->capacity) {
+            list->capacity = list->capacity == 0 ? 64 : list->capacity << 1;
+            list->items = (Entry*)realloc(list->items, list->capacity * sizeof(Entry));
+
+            if (list->items == NULL) {
+                perror(NULL);
+                exit(1);
+            }
+        }
+
+        Entry * entry = &list->items[list->size++];
+
+        memset(entry, 0, sizeof(Entry));
+
+        entry->key = strdup2(e->d_name);
+        entry->dir = strdup3(cacheDir, "/", e->d_name);
+
+        if (list == entries) {
+            info_read(entry);
+        }
+    }
+
+    closedir(d);
+
+    return 0;
+}
+
+static int compare_entry_by_lastused(const void * a, const void * b) {
+    const Entry * x = (const Entry *)a;
+    const Entry * y = (const Entry *)b;
+
+    if (x->lastused != y->lastused) {
+        return x->lastused < y->lastused ? -1 : 1;
+    }
+
+    return strcmp(x->key, y->key);
+}
+
+static int stats(void) {
+    Entries entries = {0};
+
+    if (scan_cache_dir(&entries, NULL) != 0) {
+        return 1;
+    }
+
+    qsort(entries.items, entries.size, sizeof(Entry), compare_entry_by_lastused);
+
+    int64_t totalSize = 0;
+    int64_t totalHits = 0;
+
+    for (size_t i = 0; i < entries.size; i++) {
+        const Entry * entry = &entries.items[i];
+
+        char lastused[32] = "-";
+
+        time_t t = (time_t)entry->lastused;
+
+        struct tm * tm = localtime(&t);
+
+        if (entry->lastused > 0 && tm != NULL) {
+            strftime(lastused, sizeof(lastused), "%Y-%m-%d %H:%M:%S", tm);
+        }
+
+        printf("%.16s %-40s %12lld bytes %6lld hits, last used at %s\n", entry->key, entry->package == NULL ? "-" : entry->package, (long long)entry->size, (long long)entry->hits, lastused);
+
+        totalSize += entry->size;
+        totalHits += entry->hits;
+    }
+
+    printf("%zu keys, %lld bytes, %lld hits, %s%s\n", entries.size, (long long)totalSize, (long long)totalHits, cacheDir, readonly ? " (read-only)" : "");
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int prune(int argc, char * argv[]) {
+    int64_t maxSize = -1;
+    int64_t maxAge  = -1;
+
+    int dryRun = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (starts_with(argv[i], "--max-size=")) {
+            if (parse_size(argv[i] + 11, &maxSize) != 0) {
+                fprintf(stderr, "--max-size=<SIZE>, <SIZE> must be an integer with an optional K, M, G or T suffix.\n");
+                return 1;
+            }
+        } else if (starts_with(argv[i], "--max-age=")) {
+            if (!is_integer(argv[i] + 10)) {
+                fprintf(stderr, "--max-age=<DAYS>, <DAYS> must be an integer.\n");
+                return 1;
+            }
+
+            maxAge = (int64_t)strtoll(argv[i] + 10, NULL, 10);
+        } else if (strcmp(argv[i], "--dry-run") == 0) {
+            dryRun = 1;
+        } else {
+            fprintf(stderr, "Usage: build-cache prune [--max-size=<SIZE>] [--max-age=<DAYS>] [--dry-run], unrecognized argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (readonly) {
+        fprintf(stderr, "%s is read-only, it can not be pruned.\n", cacheDir);
+        return 1;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    Entries entries = {0};
+    Entries stale   = {0};
+
+    if (scan_cache_dir(&entries, &stale) != 0) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < stale.size; i++) {
+        if (!dryRun) {
+            remove_tree(stale.items[i].dir);
+        }
+
+        printf("removed %s\n", stale.items[i].dir);
+    }
+
+    int64_t totalSize = 0;
+
+    for (size_t i = 0; i < entries.size; i++) {
+        totalSize += entries.items[i].size;
+    }
+
+    qsort(entries.items, entries.size, sizeof(Entry), compare_entry_by_lastused);
+
+    int64_t expiredAt = maxAge < 0 ? INT64_MAX : (int64_t)time(NULL) - maxAge * 86400;
+
+    size_t  removedCount = 0;
+    int64_t removedSize  = 0;
+
+    for (size_t i = 0; i < entries.size; i++) {
+        const Entry * entry = &entries.items[i];
+
+        if (maxAge >= 0 || maxSize >= 0) {
+            int expired  = entry->lastused < expiredAt;
+            int oversize = maxSize >= 0 && totalSize - removedSize > maxSize;
+
+            if (!expired && !oversize) break;
+        }
+
+        if (!dryRun && remove_tree(entry->dir) != 0) {
+            continue;
+        }
+
+        printf("removed %s %s %lld\n", entry->dir, entry->package == NULL ? "-" : entry->package, (long long)entry->size);
+
+        removedCount++;
+        removedSize += entry->size;
+    }
+
+    printf("%zu keys, %lld bytes removed, %lld bytes kept\n", removedCount, (long long)removedSize, (long long)(totalSize - removedSize));
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <restore|store|stats|prune> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    cacheDir = getenv("PPKG_BUILD_CACHE_DIR");
+
+    if (cacheDir == NULL || cacheDir[0] != '/') {
+        fprintf(stderr, "PPKG_BUILD_CACHE_DIR environment variable must be set to an absolute path.\n");
+        return 1;
+    }
+
+    const char * readonlyEnv = getenv("PPKG_BUILD_CACHE_READONLY");
+
+    readonly = readonlyEnv != NULL && strcmp(readonlyEnv, "1") == 0;
+
+    int ret;
+
+    if (strcmp(argv[1], "restore") == 0) {
+        if (argc != 4 || !is_build_key(argv[2]) || argv[3][0] != '/') {
+            fprintf(stderr, "Usage: %s restore <KEY> <INSTALL-DIR>, <KEY> is a sha256sum, <INSTALL-DIR> is an absolute path.\n", argv[0]);
+            return 1;
+        }
+
+        ret = restore(argv[2], argv[3]);
+    } else if (strcmp(argv[1], "store") == 0) {
+        if (argc != 5 || !is_build_key(argv[2]) || argv[3][0] != '/') {
+            fprintf(stderr, "Usage: %s store <KEY> <INSTALL-DIR> <PACKAGE-SPEC>, <KEY> is a sha256sum, <INSTALL-DIR> is an absolute path.\n", argv[0]);
+            return 1;
+        }
+
+        ret = store(argv[2], argv[3], argv[4]);
+    } else if (strcmp(argv[1], "stats") == 0) {
+        ret = stats();
+    } else if (strcmp(argv[1], "prune") == 0) {
+        ret = prune(argc - 2, argv + 2);
+    } else {
+        fprintf(stderr, "unrecognized action: %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
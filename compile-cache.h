@@ -0,0 +1,1285 @@
+#ifndef PPKG_COMPILE_CACHE_H
+#define PPKG_COMPILE_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#if defined (__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "sha256.h"
+#include "util.h"
+
+// a direct mode object cache for wrapper-target-cc, wrapper-target-c++ and wrapper-target-objc, it is used only if PPKG_COMPILE_CACHE_DIR is set.
+//
+// a compilation of one source file with -c -o <OUTPUT> is looked up by two keys:
+//
+// 1. the manifest key, the sha256sum of the compiler's path, size and mtime, the current working directory, the rewritten argv and
+//    the environment variables which change the result. $PPKG_COMPILE_CACHE_DIR/<XX>/<MANIFEST-KEY>.manifest lists the results
+//    compiled with that key, each of them with the sha256sum of every file it depended on, which is taken from the depfile of the compilation.
+// 2. the result key, the sha256sum of the manifest key and those files. $PPKG_COMPILE_CACHE_DIR/<XX>/<RESULT-KEY>.o is the object file,
+//    <RESULT-KEY>.d is the depfile requested by -MD/-MMD -MF <FILE>, <RESULT-KEY>.stderr is the diagnostics of the compiler.
+//
+// a hit costs hashing the depended files and copying the object file, the preprocessor is never run.
+// a miss runs the compiler with -MD -MF <TMP-FILE> added if no depfile was requested, then stores its result.
+//
+// every occurrence of PPKG_COMPILE_CACHE_BASE_DIR, the working directory of a package, is hashed as a placeholder,
+// so that the next build of the same package in another session hits. the object files keep the paths of the session they were compiled in.
+//
+// <XX> is the first two hex digits of a key, each of these 256 directories takes no more than PPKG_COMPILE_CACHE_MAX_SIZE / 256 bytes, which may have a
+// K, M, G or T suffix, 5G by default. <XX>/size is the total size of the files in <XX>, once it is exceeded, the least recently used files are removed.
+//
+// compilations which write other files than <OUTPUT> and the requested depfile, or read stdin or a response file, are not cached.
+// neither are compilations which depend on a file that uses __DATE__, __TIME__ or __TIMESTAMP__, their object files are different every time.
+
+#define COMPILE_CACHE_BASE_DIR_PLACEHOLDER "@PPKG_COMPILE_CACHE_BASE_DIR@"
+
+#define COMPILE_CACHE_MAX_RESULTS_PER_MANIFEST 16
+
+// hit or miss once compile_cache_run looked up the cache, it is recorded by compile-trace.h
+static const char * compile_cache_outcome = NULL;
+
+typedef struct {
+    const char * dir;
+    const char * baseDir;
+    size_t       baseDirLength;
+    int64_t      maxSize;
+
+    const char * output;
+    const char * source;
+    const char * depfile;
+
+    // the sha256sums of the depended files which have been hashed by this process.
+    char **      hashedPaths;
+    char (*      hashedSums)[65];
+    size_t       hashedCount;
+    size_t       hashedCapacity;
+} CompileCache;
+
+/////////////////////////////////////////////////////////////////
+
+static char * compile_cache_tmp_path_of(const char * path) {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), ".%d.tmp", (int)getpid());
+
+    return strdup3(path, "", buf);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// returns a NUL-terminated copy of the content of the given file, NULL if it can not be read.
+static char * compile_cache_read_file(const char * path, size_t * size) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    char * buf = (char*)malloc((size_t)st.st_size + 1);
+
+    if (buf == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t n = 0;
+
+    while (n < (size_t)st.st_size) {
+        ssize_t r = read(fd, buf + n, (size_t)st.st_size - n);
+
+        if (r < 0 && errno == EINTR) continue;
+
+        if (r <= 0) break;
+
+        n += (size_t)r;
+    }
+
+    close(fd);
+
+    buf[n] = '\0';
+
+    *size = n;
+
+    return buf;
+}
+
+// write to <PATH>.<PID>.tmp then rename it to <PATH>, so that nobody sees a half-written file.
+static int compile_cache_write_file(const char * path, const char * buf, size_t size) {
+    char * tmpPath = compile_cache_tmp_path_of(path);
+
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1) {
+        free(tmpPath);
+        return -1;
+    }
+
+    int ret = write_fully(fd, buf, size);
+
+    if (close(fd) != 0) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        ret = rename(tmpPath, path);
+    }
+
+    if (ret != 0) {
+        unlink(tmpPath);
+    }
+
+    free(tmpPath);
+
+    return ret;
+}
+
+// copy <FROM> to <TO> through <TO>.<PID>.tmp, in the kernel if possible.
+static int compile_cache_copy_file(const char * from, const char * to) {
+    int ifd = open(from, O_RDONLY);
+
+    if (ifd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(ifd, &st) != 0) {
+        close(ifd);
+        return -1;
+    }
+
+    char * tmpPath = compile_cache_tmp_path_of(to);
+
+    int ofd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (ofd == -1) {
+        close(ifd);
+        free(tmpPath);
+        return -1;
+    }
+
+    int ret = 0;
+
+    size_t remaining = (size_t)st.st_size;
+
+#if defined (__linux__) && defined (SYS_copy_file_range)
+    while (remaining > 0) {
+        long n = syscall(SYS_copy_file_range, ifd, NULL, ofd, NULL, remaining, 0U);
+
+        if (n < 0 && errno == EINTR) continue;
+
+        // not supported by this kernel or across these filesystems, the rest is copied below.
+        if (n <= 0) break;
+
+        remaining -= (size_t)n;
+    }
+#endif
+
+    if (remaining > 0) {
+        off_t offset = st.st_size - (off_t)remaining;
+
+        char * p = (char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, ifd, 0);
+
+        if (p == MAP_FAILED) {
+            ret = -1;
+        } else {
+            if (lseek(ofd, offset, SEEK_SET) == (off_t)-1 || write_fully(ofd, p + offset, remaining) != 0) {
+                ret = -1;
+            }
+
+            munmap(p, (size_t)st.st_size);
+        }
+    }
+
+    if (close(ofd) != 0) {
+        ret = -1;
+    }
+
+    close(ifd);
+
+    if (ret == 0) {
+        ret = rename(tmpPath, to);
+    }
+
+    if (ret != 0) {
+        unlink(tmpPath);
+    }
+
+    free(tmpPath);
+
+    return ret;
+}
+
+// returns a copy of <BUF> in which every <FROM> is replaced with <TO>.
+static char * compile_cache_replace(const char * buf, size_t size, const char * from, const char * to, size_t * newSize) {
+    size_t fromLength = strlen(from);
+    size_t toLength   = strlen(to);
+
+    size_t count = 0;
+
+    if (fromLength > 0) {
+        for (const char * p = buf; (p = strstr(p, from)) != NULL; p += fromLength) {
+            count++;
+        }
+    }
+
+    char * out = (char*)malloc(size + count * toLength + 1);
+
+    if (out == NULL) {
+        perror(NULL);
+        exit(255);
+    }
+
+    char * q = out;
+
+    const char * p = buf;
+
+    if (fromLength > 0) {
+        for (const char * r; (r = strstr(p, from)) != NULL; p = r + fromLength) {
+            memcpy(q, p, (size_t)(r - p));
+            q += r - p;
+            memcpy(q, to, toLength);
+            q += toLength;
+        }
+    }
+
+    size_t rest = size - (size_t)(p - buf);
+
+    memcpy(q, p, rest);
+    q += rest;
+    *q = '\0';
+
+    *newSize = (size_t)(q - out);
+
+    return out;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// hash <S> and a NUL, every occurrence of the base directory is hashed as a placeholder.
+static void compile_cache_hash_string(const CompileCache * cache, SHA256 * ctx, const char * s) {
+    if (cache->baseDir != NULL) {
+        for (const char * r; (r = strstr(s, cache->baseDir)) != NULL; s = r + cache->baseDirLength) {
+            sha256_update(ctx, s, (size_t)(r - s));
+            sha256_update(ctx, COMPILE_CACHE_BASE_DIR_PLACEHOLDER, strlen(COMPILE_CACHE_BASE_DIR_PLACEHOLDER));
+        }
+    }
+
+    sha256_update(ctx, s, strlen(s) + 1);
+}
+
+// returns NULL if the given file can not be read.
+static const char * compile_cache_hash_file(CompileCache * cache, const char * path) {
+    for (size_t i = 0; i < cache->hashedCount; i++) {
+        if (strcmp(cache->hashedPaths[i], path) == 0) {
+            return cache->hashedSums[i][0] == '\0' ? NULL : cache->hashedSums[i];
+        }
+    }
+
+    if (cache->hashedCount == cache->hashedCapacity) {
+        cache->hashedCapacity = cache->hashedCapacity == 0 ? 256 : cache->hashedCapacity << 1;
+
+        cache->hashedPaths = (char**)realloc(cache->hashedPaths, cache->hashedCapacity * sizeof(char*));
+        cache->hashedSums  = (char(*)[65])realloc(cache->hashedSums, cache->hashedCapacity * 65);
+
+        if (cache->hashedPaths == NULL || cache->hashedSums == NULL) {
+            perror(NULL);
+            exit(255);
+        }
+    }
+
+    size_t i = cache->hashedCount++;
+
+    cache->hashedPaths[i] = strdup2(path);
+
+    if (sha256_of_file(path, cache->hashedSums[i]) != 0) {
+        cache->hashedSums[i][0] = '\0';
+        return NULL;
+    }
+
+    return cache->hashedSums[i];
+}
+
+// returns 1 if <PATH> contains __DATE__, __TIME__ or __TIMESTAMP__, or it can not be read.
+// a comment which mentions one of them is a false positive, which only costs a miss.
+static int compile_cache_uses_time_macros(const char * path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return 1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    char * p = (char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        return 1;
+    }
+
+    const char * end = p + st.st_size;
+
+    int found = 0;
+
+    for (const char * q = p; (q = (const char*)memchr(q, '_', (size_t)(end - q))) != NULL; q++) {
+        size_t n = (size_t)(end - q);
+
+        if ((n >= 8 && (memcmp(q, "__DATE__", 8) == 0 || memcmp(q, "__TIME__", 8) == 0)) || (n >= 13 && memcmp(q, "__TIMESTAMP__", 13) == 0)) {
+            found = 1;
+            break;
+        }
+    }
+
+    munmap(p, (size_t)st.st_size);
+
+    return found;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int compile_cache_is_source_file(const char * arg) {
+    static const char * const suffixes[] = { ".c", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".C", ".CPP", ".m", ".mm", ".M", ".i", ".ii", ".s", ".S", ".sx", NULL };
+
+    for (int i = 0; suffixes[i] != NULL; i++) {
+        if (ends_with(arg, suffixes[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// returns 1 if arg is -o or -o<OUTPUT>. clang's -objcmt-* and -object options also start with -o, they are not the output.
+static int compile_cache_is_output_option(const char * arg) {
+    return strncmp(arg, "-o", 2) == 0 && strncmp(arg, "-obj", 4) != 0;
+}
+
+// the options whose value is the next argument.
+static int compile_cache_takes_value(const char * arg) {
+    static const char * const options[] = {
+        "-o", "-MF", "-MT", "-MQ", "-I", "-D", "-U", "-x", "-include", "-imacros", "-isystem", "-idirafter", "-iquote", "-isysroot",
+        "-iprefix", "-iwithprefix", "-iwithprefixbefore", "-arch", "-target", "-Xclang", "-Xassembler", "-Xpreprocessor", "-Xlinker",
+        "--param", "-aux-info", "-L", "-F", "-framework", "-install_name", NULL
+    };
+
+    for (int i = 0; options[i] != NULL; i++) {
+        if (strcmp(arg, options[i]) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// returns 1 if the compilation writes nothing but <OUTPUT> and the requested depfile.
+static int compile_cache_inspect_argv(CompileCache * cache, char * argv[]) {
+    int depfileRequested = 0;
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        const char * arg = argv[i];
+
+        if (arg[0] == '@') {
+            return 0;
+        }
+
+        if (arg[0] != '-') {
+            if (cache->source != NULL || !compile_cache_is_source_file(arg)) {
+                return 0;
+            }
+
+            cache->source = arg;
+            continue;
+        }
+
+        if (strcmp(arg, "-") == 0 || strcmp(arg, "-M") == 0 || strcmp(arg, "-MM") == 0 || strcmp(arg, "-E") == 0 || strcmp(arg, "-S") == 0) {
+            return 0;
+        }
+
+        if (strncmp(arg, "-MJ", 3) == 0 || strncmp(arg, "-save-temps", 11) == 0 || strcmp(arg, "-gsplit-dwarf") == 0 || strcmp(arg, "--coverage") == 0 ||
+            strcmp(arg, "-ftest-coverage") == 0 || strcmp(arg, "-fprofile-arcs") == 0 || strncmp(arg, "-fprofile-use", 13) == 0 ||
+            strncmp(arg, "-fauto-profile", 14) == 0 || strncmp(arg, "-fprofile-instr-use", 19) == 0 || strncmp(arg, "-fdump-", 7) == 0) {
+            return 0;
+        }
+
+        if (strcmp(arg, "-MD") == 0 || strcmp(arg, "-MMD") == 0) {
+            depfileRequested = 1;
+            continue;
+        }
+
+        if (strncmp(arg, "-MF", 3) == 0) {
+            cache->depfile = arg[3] == '\0' ? argv[++i] : arg + 3;
+            if (cache->depfile == NULL) return 0;
+            continue;
+        }
+
+        if (compile_cache_is_output_option(arg)) {
+            cache->output = arg[2] == '\0' ? argv[++i] : arg + 2;
+            if (cache->output == NULL) return 0;
+            continue;
+        }
+
+        if (compile_cache_takes_value(arg)) {
+            if (argv[++i] == NULL) return 0;
+        }
+    }
+
+    if (cache->source == NULL || cache->output == NULL || strncmp(cache->output, "/dev/", 5) == 0) {
+        return 0;
+    }
+
+    // -MD without -MF writes a depfile named after <OUTPUT>, -MF without -MD is a preprocessing only option.
+    if (depfileRequested != (cache->depfile != NULL)) {
+        return 0;
+    }
+
+    // these ones make the compiler write more files.
+    if (getenv("DEPENDENCIES_OUTPUT") != NULL || getenv("SUNPRO_DEPENDENCIES") != NULL) {
+        return 0;
+    }
+
+    return 1;
+}
+
+static void compile_cache_manifest_key(const CompileCache * cache, const char * compiler, char * argv[], char hex[65]) {
+    SHA256 ctx;
+
+    sha256_init(&ctx);
+
+    sha256_update(&ctx, "ppkg-compile-cache-1", 21);
+
+    compile_cache_hash_string(cache, &ctx, compiler);
+
+    struct stat st;
+
+    if (stat(compiler, &st) == 0) {
+        char buf[64];
+
+        snprintf(buf, sizeof(buf), "%lld %lld", (long long)st.st_size, (long long)st.st_mtime);
+
+        compile_cache_hash_string(cache, &ctx, buf);
+    }
+
+    char cwd[4096];
+
+    if (getcwd(cwd, sizeof(cwd)) != NULL) {
+        compile_cache_hash_string(cache, &ctx, cwd);
+    }
+
+    static const char * const envs[] = { "CPATH", "C_INCLUDE_PATH", "CPLUS_INCLUDE_PATH", "OBJC_INCLUDE_PATH", "SOURCE_DATE_EPOCH", "MACOSX_DEPLOYMENT_TARGET", "SDKROOT", "GCC_EXEC_PREFIX", "COMPILER_PATH", NULL };
+
+    for (int i = 0; envs[i] != NULL; i++) {
+        const char * value = getenv(envs[i]);
+
+        compile_cache_hash_string(cache, &ctx, envs[i]);
+        compile_cache_hash_string(cache, &ctx, value == NULL ? "" : value);
+    }
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        // the object file does not depend on its own path, but the depfile names it as the target.
+        if (cache->depfile == NULL && strncmp(argv[i], "-o", 2) == 0) {
+            if (argv[i][2] == '\0') i++;
+            continue;
+        }
+
+        compile_cache_hash_string(cache, &ctx, argv[i]);
+    }
+
+    uint8_t digest[32];
+
+    sha256_final(&ctx, digest);
+    sha256_to_hex(digest, hex);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// <DIR>/<XX>/<KEY><SUFFIX>
+static char * compile_cache_path_of(const CompileCache * cache, const char * key, const char * suffix) {
+    char shard[4] = { '/', key[0], key[1], '\0' };
+
+    char * p = strdup3(cache->dir, shard, "/");
+    char * q = strdup3(p, key, suffix);
+
+    free(p);
+
+    return q;
+}
+
+// a depended file is written in a manifest as <SHA256> <b|a> <PATH>, b means <PATH> is relative to the base directory.
+static char * compile_cache_depended_path(const CompileCache * cache, char flag, const char * path) {
+    if (flag == 'b' && cache->baseDir != NULL) {
+        return strdup3(cache->baseDir, "/", path);
+    }
+
+    return strdup2(path);
+}
+
+// find a result in the manifest whose depended files all have the recorded sha256sums.
+static int compile_cache_lookup(CompileCache * cache, const char * manifestKey, char resultKey[65]) {
+    char * manifestPath = compile_cache_path_of(cache, manifestKey, ".manifest");
+
+    size_t size;
+
+    char * manifest = compile_cache_read_file(manifestPath, &size);
+
+    if (manifest == NULL) {
+        free(manifestPath);
+        return 0;
+    }
+
+    int found = 0;
+
+    int matches = 0;
+
+    char * line = manifest;
+
+    for (;;) {
+        char * next = strchr(line, '\n');
+
+        if (next != NULL) {
+            *next = '\0';
+        }
+
+        if (strncmp(line, "result ", 7) == 0 || next == NULL) {
+            if (matches) {
+                found = 1;
+                break;
+            }
+
+            if (next == NULL) break;
+
+            matches = strlen(line + 7) == 64;
+
+            if (matches) {
+                memcpy(resultKey, line + 7, 65);
+            }
+        } else if (matches) {
+            if (strlen(line) < 68 || line[64] != ' ' || line[66] != ' ') {
+                matches = 0;
+            } else {
+                char * path = compile_cache_depended_path(cache, line[65], line + 67);
+
+                const char * sum = compile_cache_hash_file(cache, path);
+
+                matches = sum != NULL && strncmp(sum, line, 64) == 0;
+
+                free(path);
+            }
+        }
+
+        line = next + 1;
+    }
+
+    // the least recently used manifests are removed first.
+    if (found) {
+        utimensat(AT_FDCWD, manifestPath, NULL, 0);
+    }
+
+    free(manifest);
+    free(manifestPath);
+
+    return found;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// the prerequisites of a make rule, the targets are skipped.
+static char ** compile_cache_parse_depfile(const char * content, size_t * count) {
+    size_t capacity = 64;
+
+    char ** deps = (char**)malloc(capacity * sizeof(char*));
+
+    char * token = (char*)malloc(strlen(content) + 1);
+
+    if (deps == NULL || token == NULL) {
+        perror(NULL);
+        exit(255);
+    }
+
+    *count = 0;
+
+    const char * p = content;
+
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || (p[0] == '\\' && (p[1] == '\n' || (p[1] == '\r' && p[2] == '\n')))) {
+            p += p[0] == '\\' ? (p[1] == '\r' ? 3 : 2) : 1;
+        }
+
+        if (*p == '\0') break;
+
+        size_t n = 0;
+
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            if (p[0] == '\\' && (p[1] == ' ' || p[1] == '#' || p[1] == '\\')) {
+                token[n++] = p[1];
+                p += 2;
+            } else if (p[0] == '\\' && (p[1] == '\n' || p[1] == '\r')) {
+                break;
+            } else if (p[0] == '$' && p[1] == '$') {
+                token[n++] = '$';
+                p += 2;
+            } else {
+                token[n++] = *p++;
+            }
+        }
+
+        token[n] = '\0';
+
+        // a target
+        if (n == 0 || token[n - 1] == ':') continue;
+
+        int duplicated = 0;
+
+        for (size_t i = 0; i < *count; i++) {
+            if (strcmp(deps[i], token) == 0) {
+                duplicated = 1;
+                break;
+            }
+        }
+
+        if (duplicated) continue;
+
+        if (*count == capacity) {
+            capacity <<= 1;
+
+            deps = (char**)realloc(deps, capacity * sizeof(char*));
+
+            if (deps == NULL) {
+                perror(NULL);
+                exit(255);
+            }
+        }
+
+        deps[(*count)++] = strdup2(token);
+    }
+
+    free(token);
+
+    return deps;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int compile_cache_compare_mtime(const void * a, const void * b) {
+    const struct { char * path; time_t mtime; off_t size; } * x = a, * y = b;
+
+    return x->mtime < y->mtime ? -1 : x->mtime > y->mtime ? 1 : 0;
+}
+
+// remove the least recently used files of <SHARD-DIR> until it takes no more than 90% of <LIMIT>. returns the new total size.
+static int64_t compile_cache_cleanup(const char * shardDir, int64_t limit) {
+    typedef struct { char * path; time_t mtime; off_t size; } Item;
+
+    Item * items = NULL;
+
+    size_t count = 0, capacity = 0;
+
+    int64_t total = 0;
+
+    DIR * d = opendir(shardDir);
+
+    if (d == NULL) {
+        return 0;
+    }
+
+    time_t now = time(NULL);
+
+    struct dirent * e;
+
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.' || strcmp(e->d_name, "size") == 0) continue;
+
+        char * path = strdup3(shardDir, "/", e->d_name);
+
+        struct stat st;
+
+        if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        // left by a killed compilation
+        if (ends_with(e->d_name, ".tmp")) {
+            if (now - st.st_mtime > 3600) {
+                unlink(path);
+            }
+
+            free(path);
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 256 : capacity << 1;
+
+            items = (Item*)realloc(items, capacity * sizeof(Item));
+
+            if (items == NULL) {
+                perror(NULL);
+                exit(255);
+            }
+        }
+
+        items[count].path  = path;
+        items[count].mtime = st.st_mtime;
+        items[count].size  = st.st_size;
+
+        count++;
+
+        total += st.st_size;
+    }
+
+    closedir(d);
+
+    qsort(items, count, sizeof(Item), compile_cache_compare_mtime);
+
+    for (size_t i = 0; i < count; i++) {
+        if (total > limit / 10 * 9 && unlink(items[i].path) == 0) {
+            total -= items[i].size;
+        }
+
+        free(items[i].path);
+    }
+
+    free(items);
+
+    return total;
+}
+
+// add <DELTA> to <XX>/size under a lock of it, clean up <XX> if it exceeds its share of PPKG_COMPILE_CACHE_MAX_SIZE.
+static void compile_cache_account(const CompileCache * cache, const char * key, int64_t delta) {
+    char shard[4] = { '/', key[0], key[1], '\0' };
+
+    char * shardDir = strdup3(cache->dir, shard, "");
+    char * sizePath = strdup3(shardDir, "/", "size");
+
+    int fd = open(sizePath, O_RDWR | O_CREAT, 0644);
+
+    if (fd != -1) {
+        struct flock lock = {0};
+
+        lock.l_type   = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+
+        int locked;
+
+        while ((locked = fcntl(fd, F_SETLKW, &lock)) == -1 && errno == EINTR);
+
+        if (locked == 0) {
+            char buf[32] = {0};
+
+            ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+            int64_t total = n > 0 ? (int64_t)strtoll(buf, NULL, 10) : 0;
+
+            total += delta;
+
+            int64_t limit = cache->maxSize / 256;
+
+            if (total > limit) {
+                total = compile_cache_cleanup(shardDir, limit);
+            }
+
+            if (total < 0) {
+                total = 0;
+            }
+
+            n = snprintf(buf, sizeof(buf), "%lld\n", (long long)total);
+
+            if (ftruncate(fd, 0) == 0) {
+                pwrite(fd, buf, (size_t)n, 0);
+            }
+        }
+
+        close(fd);
+    }
+
+    free(sizePath);
+    free(shardDir);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// restore a text file written with the base directory replaced with the placeholder.
+static int compile_cache_restore_text(const CompileCache * cache, const char * from, int fd, const char * to) {
+    size_t size;
+
+    char * content = compile_cache_read_file(from, &size);
+
+    if (content == NULL) {
+        return -1;
+    }
+
+    size_t newSize;
+
+    char * newContent = compile_cache_replace(content, size, COMPILE_CACHE_BASE_DIR_PLACEHOLDER, cache->baseDir == NULL ? COMPILE_CACHE_BASE_DIR_PLACEHOLDER : cache->baseDir, &newSize);
+
+    int ret = to == NULL ? write_fully(fd, newContent, newSize) : compile_cache_write_file(to, newContent, newSize);
+
+    free(content);
+    free(newContent);
+
+    return ret;
+}
+
+static int compile_cache_store_text(const CompileCache * cache, const char * content, size_t size, const char * to) {
+    size_t newSize;
+
+    char * newContent = compile_cache_replace(content, size, cache->baseDir == NULL ? COMPILE_CACHE_BASE_DIR_PLACEHOLDER : cache->baseDir, COMPILE_CACHE_BASE_DIR_PLACEHOLDER, &newSize);
+
+    int ret = compile_cache_write_file(to, newContent, newSize);
+
+    free(newContent);
+
+    return ret == 0 ? (int)newSize : -1;
+}
+
+static int compile_cache_restore(const CompileCache * cache, const char * resultKey) {
+    char * objectPath  = compile_cache_path_of(cache, resultKey, ".o");
+    char * depfilePath = compile_cache_path_of(cache, resultKey, ".d");
+    char * stderrPath  = compile_cache_path_of(cache, resultKey, ".stderr");
+
+    int ret = -1;
+
+    if (cache->depfile == NULL || access(depfilePath, F_OK) == 0) {
+        ret = compile_cache_copy_file(objectPath, cache->output);
+    }
+
+    if (ret == 0 && cache->depfile != NULL) {
+        ret = compile_cache_restore_text(cache, depfilePath, -1, cache->depfile);
+    }
+
+    if (ret == 0) {
+        // the diagnostics are shown as if the compiler ran.
+        if (access(stderrPath, F_OK) == 0) {
+            compile_cache_restore_text(cache, stderrPath, STDERR_FILENO, NULL);
+        }
+
+        // the least recently used results are removed first.
+        utimensat(AT_FDCWD, objectPath, NULL, 0);
+    }
+
+    free(objectPath);
+    free(depfilePath);
+    free(stderrPath);
+
+    return ret;
+}
+
+// returns the exit status of the compiler.
+static int compile_cache_compile(const char * compiler, char * argv[], int stderrFd) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        perror("fork");
+        return 255;
+    }
+
+    if (pid == 0) {
+        dup2(stderrFd, STDERR_FILENO);
+        execv(compiler, argv);
+        perror(compiler);
+        _exit(255);
+    }
+
+    int status;
+
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            return 255;
+        }
+    }
+
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+
+    return 128 + WTERMSIG(status);
+}
+
+static void compile_cache_store(CompileCache * cache, const char * manifestKey, const char * depfile, const char * diagnostics, size_t diagnosticsSize) {
+    size_t size;
+
+    char * depfileContent = compile_cache_read_file(depfile, &size);
+
+    if (depfileContent == NULL) {
+        return;
+    }
+
+    size_t depCount;
+
+    char ** deps = compile_cache_parse_depfile(depfileContent, &depCount);
+
+    /////////////////////////////////////////////////////////////////
+
+    // <SHA256> <b|a> <PATH> lines
+    size_t entryCapacity = 128;
+    size_t entrySize = 0;
+
+    char * entry = (char*)malloc(entryCapacity);
+
+    if (entry == NULL) {
+        perror(NULL);
+        exit(255);
+    }
+
+    SHA256 ctx;
+
+    sha256_init(&ctx);
+
+    sha256_update(&ctx, manifestKey, 64);
+
+    int ok = 1;
+
+    for (size_t i = 0; i < depCount; i++) {
+        const char * sum = compile_cache_hash_file(cache, deps[i]);
+
+        if (sum == NULL || strchr(deps[i], '\n') != NULL || compile_cache_uses_time_macros(deps[i])) {
+            ok = 0;
+            break;
+        }
+
+        char flag = 'a';
+
+        const char * path = deps[i];
+
+        if (cache->baseDir != NULL && strncmp(path, cache->baseDir, cache->baseDirLength) == 0 && path[cache->baseDirLength] == '/') {
+            flag = 'b';
+            path += cache->baseDirLength + 1;
+        }
+
+        size_t n = 64 + 3 + strlen(path) + 1;
+
+        while (entrySize + n + 1 > entryCapacity) {
+            entryCapacity <<= 1;
+
+            entry = (char*)realloc(entry, entryCapacity);
+
+            if (entry == NULL) {
+                perror(NULL);
+                exit(255);
+            }
+        }
+
+        entrySize += (size_t)snprintf(entry + entrySize, entryCapacity - entrySize, "%s %c %s\n", sum, flag, path);
+
+        sha256_update(&ctx, sum, 64);
+        sha256_update(&ctx, &flag, 1);
+        sha256_update(&ctx, path, strlen(path) + 1);
+    }
+
+    for (size_t i = 0; i < depCount; i++) {
+        free(deps[i]);
+    }
+
+    free(deps);
+
+    if (!ok) {
+        free(depfileContent);
+        free(entry);
+        return;
+    }
+
+    uint8_t digest[32];
+
+    char resultKey[65];
+
+    sha256_final(&ctx, digest);
+    sha256_to_hex(digest, resultKey);
+
+    /////////////////////////////////////////////////////////////////
+
+    char shard[4] = { '/', resultKey[0], resultKey[1], '\0' };
+
+    char * shardDir = strdup3(cache->dir, shard, "");
+
+    mkdir(cache->dir, 0755);
+    mkdir(shardDir, 0755);
+
+    free(shardDir);
+
+    int64_t delta = 0;
+
+    char * objectPath = compile_cache_path_of(cache, resultKey, ".o");
+
+    struct stat st;
+
+    if (compile_cache_copy_file(cache->output, objectPath) == 0 && stat(objectPath, &st) == 0) {
+        delta += st.st_size;
+
+        if (cache->depfile != NULL) {
+            char * depfilePath = compile_cache_path_of(cache, resultKey, ".d");
+
+            int n = compile_cache_store_text(cache, depfileContent, size, depfilePath);
+
+            if (n < 0) ok = 0; else delta += n;
+
+            free(depfilePath);
+        }
+
+        if (diagnosticsSize > 0) {
+            char * stderrPath = compile_cache_path_of(cache, resultKey, ".stderr");
+
+            int n = compile_cache_store_text(cache, diagnostics, diagnosticsSize, stderrPath);
+
+            if (n < 0) ok = 0; else delta += n;
+
+            free(stderrPath);
+        }
+    } else {
+        ok = 0;
+    }
+
+    free(objectPath);
+    free(depfileContent);
+
+    compile_cache_account(cache, resultKey, delta);
+
+    if (!ok) {
+        free(entry);
+        return;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    // the new result comes first, the oldest ones are dropped. concurrent compilations might lose a result of each other, it is only a miss.
+    shard[1] = manifestKey[0];
+    shard[2] = manifestKey[1];
+
+    shardDir = strdup3(cache->dir, shard, "");
+
+    mkdir(shardDir, 0755);
+
+    free(shardDir);
+
+    char * manifestPath = compile_cache_path_of(cache, manifestKey, ".manifest");
+
+    size_t oldSize = 0;
+
+    char * old = compile_cache_read_file(manifestPath, &oldSize);
+
+    char header[80];
+
+    snprintf(header, sizeof(header), "result %s\n", resultKey);
+
+    char * p = strdup2(header);
+    char * q = strdup3(p, "", entry);
+
+    free(p);
+
+    size_t newSize = strlen(q);
+
+    if (old != NULL) {
+        int results = 1;
+
+        int skipping = 0;
+
+        for (char * r = old; *r != '\0'; ) {
+            char * next = strchr(r, '\n');
+
+            next = next == NULL ? r + strlen(r) : next + 1;
+
+            if (strncmp(r, "result ", 7) == 0) {
+                // the same result as the new one is dropped.
+                skipping = strncmp(r + 7, resultKey, 64) == 0;
+
+                if (!skipping && ++results > COMPILE_CACHE_MAX_RESULTS_PER_MANIFEST) {
+                    break;
+                }
+            }
+
+            if (skipping) {
+                r = next;
+                continue;
+            }
+
+            size_t n = (size_t)(next - r);
+
+            q = (char*)realloc(q, newSize + n + 1);
+
+            if (q == NULL) {
+                perror(NULL);
+                exit(255);
+            }
+
+            memcpy(q + newSize, r, n);
+
+            newSize += n;
+
+            q[newSize] = '\0';
+
+            r = next;
+        }
+
+        free(old);
+    }
+
+    if (compile_cache_write_file(manifestPath, q, newSize) == 0) {
+        compile_cache_account(cache, manifestKey, (int64_t)newSize - (int64_t)oldSize);
+    }
+
+    free(manifestPath);
+    free(q);
+    free(entry);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// returns -1 if this compilation is not cached, the caller runs the compiler itself then.
+// otherwise returns the exit status of the compilation, which was either restored from the cache or run and stored.
+static inline int compile_cache_run(const char * compiler, char * argv[]) {
+    CompileCache cache = {0};
+
+    cache.dir = getenv("PPKG_COMPILE_CACHE_DIR");
+
+    if (cache.dir == NULL || cache.dir[0] != '/') {
+        return -1;
+    }
+
+    cache.baseDir = getenv("PPKG_COMPILE_CACHE_BASE_DIR");
+
+    if (cache.baseDir != NULL && cache.baseDir[0] != '/') {
+        cache.baseDir = NULL;
+    }
+
+    cache.baseDirLength = cache.baseDir == NULL ? 0 : strlen(cache.baseDir);
+
+    const char * maxSize = getenv("PPKG_COMPILE_CACHE_MAX_SIZE");
+
+    if (maxSize == NULL || parse_size(maxSize, &cache.maxSize) != 0) {
+        cache.maxSize = (int64_t)5 << 30;
+    }
+
+    if (!compile_cache_inspect_argv(&cache, argv)) {
+        return -1;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    char manifestKey[65];
+    char resultKey[65];
+
+    compile_cache_manifest_key(&cache, compiler, argv, manifestKey);
+
+    if (compile_cache_lookup(&cache, manifestKey, resultKey) && compile_cache_restore(&cache, resultKey) == 0) {
+        compile_cache_outcome = "hit";
+        return 0;
+    }
+
+    compile_cache_outcome = "miss";
+
+    /////////////////////////////////////////////////////////////////
+
+    int argc = 0;
+
+    while (argv[argc] != NULL) argc++;
+
+    char ** argv2 = (char**)malloc((argc + 4) * sizeof(char*));
+
+    if (argv2 == NULL) {
+        perror(NULL);
+        exit(255);
+    }
+
+    memcpy(argv2, argv, argc * sizeof(char*));
+
+    char * depfile = NULL;
+
+    if (cache.depfile == NULL) {
+        char buf[32];
+
+        snprintf(buf, sizeof(buf), ".%d.d", (int)getpid());
+
+        depfile = strdup3(cache.output, "", buf);
+
+        argv2[argc++] = (char*)"-MD";
+        argv2[argc++] = (char*)"-MF";
+        argv2[argc++] = depfile;
+    }
+
+    argv2[argc] = NULL;
+
+    /////////////////////////////////////////////////////////////////
+
+    // the diagnostics are written to an unlinked temporary file, then shown and stored.
+    FILE * diagnosticsFile = tmpfile();
+
+    if (diagnosticsFile == NULL) {
+        free(argv2);
+        free(depfile);
+        return -1;
+    }
+
+    int ret = compile_cache_compile(compiler, argv2, fileno(diagnosticsFile));
+
+    size_t diagnosticsSize = 0;
+
+    char * diagnostics = NULL;
+
+    struct stat st;
+
+    if (fstat(fileno(diagnosticsFile), &st) == 0 && st.st_size > 0) {
+        diagnostics = (char*)malloc((size_t)st.st_size + 1);
+
+        if (diagnostics != NULL) {
+            diagnosticsSize = (size_t)pread(fileno(diagnosticsFile), diagnostics, (size_t)st.st_size, 0);
+
+            if ((ssize_t)diagnosticsSize < 0) {
+                diagnosticsSize = 0;
+            }
+
+            diagnostics[diagnosticsSize] = '\0';
+
+            write_fully(STDERR_FILENO, diagnostics, diagnosticsSize);
+        }
+    }
+
+    fclose(diagnosticsFile);
+
+    if (ret == 0) {
+        compile_cache_store(&cache, manifestKey, depfile == NULL ? cache.depfile : depfile, diagnostics, diagnosticsSize);
+    }
+
+    if (depfile != NULL) {
+        unlink(depfile);
+        free(depfile);
+    }
+
+    free(diagnostics);
+    free(argv2);
+
+    return ret;
+}
+
+#endif
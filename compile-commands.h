@@ -0,0 +1,129 @@
+#ifndef PPKG_COMPILE_COMMANDS_H
+#define PPKG_COMPILE_COMMANDS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "compile-cache.h"
+
+// if PPKG_COMPILE_COMMANDS_FILE is set, the wrappers append one line per source file they compile to that file:
+//
+// {"directory":"<CWD>","file":"<SOURCE>","output":"<OUTPUT>","arguments":["<COMPILER>","<ARG>",...]}
+//
+// the arguments are the rewritten ones which were really passed to the compiler.
+// every line is written by a single write(2) to a file opened with O_APPEND, concurrent wrappers never interleave their lines and need no lock.
+// ppkg merges these lines into a compile_commands.json, see https://clang.llvm.org/docs/JSONCompilationDatabase.html
+
+static void compile_command_append_json_string(StringBuffer * sb, const char * s) {
+    sb_append_c(sb, '"');
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+
+        if (c == '"' || c == '\\') {
+            char e[2] = { '\\', (char)c };
+            sb_append_n(sb, e, 2);
+        } else if (c < 0x20) {
+            char e[8];
+            snprintf(e, sizeof(e), "\\u%04x", c);
+            sb_append_n(sb, e, 6);
+        } else {
+            sb_append_c(sb, (char)c);
+        }
+    }
+
+    sb_append_c(sb, '"');
+}
+
+// record a compile command for every source file of argv, argv[0] is the compiler.
+static void compile_commands_record(char * argv[]) {
+    const char * file = getenv("PPKG_COMPILE_COMMANDS_FILE");
+
+    if (file == NULL || file[0] == '\0') {
+        return;
+    }
+
+    const char * output = NULL;
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (compile_cache_is_output_option(argv[i])) {
+            output = argv[i][2] == '\0' ? argv[++i] : argv[i] + 2;
+            if (output == NULL) break;
+        } else if (compile_cache_takes_value(argv[i])) {
+            if (argv[++i] == NULL) break;
+        }
+    }
+
+    char cwd[4096];
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        return;
+    }
+
+    int fd = -1;
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (argv[i][0] == '-') {
+            if (compile_cache_takes_value(argv[i])) {
+                if (argv[++i] == NULL) break;
+            }
+
+            continue;
+        }
+
+        if (!compile_cache_is_source_file(argv[i])) {
+            continue;
+        }
+
+        StringBuffer cmd = {0};
+
+        sb_append(&cmd, "{\"directory\":");
+        compile_command_append_json_string(&cmd, cwd);
+        sb_append(&cmd, ",\"file\":");
+        compile_command_append_json_string(&cmd, argv[i]);
+
+        if (output != NULL) {
+            sb_append(&cmd, ",\"output\":");
+            compile_command_append_json_string(&cmd, output);
+        }
+
+        sb_append(&cmd, ",\"arguments\":[");
+
+        for (int j = 0; argv[j] != NULL; j++) {
+            if (j > 0) {
+                sb_append_c(&cmd, ',');
+            }
+
+            compile_command_append_json_string(&cmd, argv[j]);
+        }
+
+        sb_append(&cmd, "]}\n");
+
+        if (fd == -1) {
+            fd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+            if (fd == -1) {
+                perror(file);
+                free(cmd.buf);
+                return;
+            }
+        }
+
+        if (write(fd, cmd.buf, cmd.len) != (ssize_t)cmd.len) {
+            perror(file);
+        }
+
+        free(cmd.buf);
+    }
+
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef PPKG_COMPILE_TRACE_H
+#define PPKG_COMPILE_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// if PPKG_COMPILE_TRACE_FILE is set, the wrappers run the compiler as a child instead of replacing themselves with it,
+// then append one line per invocation to that file:
+//
+// <ACTION>\t<EXIT-STATUS>\t<WALL-MS>\t<USER-MS>\t<SYS-MS>\t<MAX-RSS-KB>\t<CACHE>\t<CWD>\t<OUTPUT>\n
+//
+// <ACTION> is one of preprocess, compile, assemble, shared, static-exe, link
+// <CACHE>  is hit or miss if the compile cache was looked up, - otherwise.
+// <OUTPUT> is the value of -o, - if not given.
+//
+// the line is written by a single write(2) to a file opened with O_APPEND, concurrent wrappers never interleave their lines and need no lock.
+
+typedef struct {
+    const char *    file;
+    struct timespec begin;
+} CompileTrace;
+
+// returns 0 if the trace is not requested.
+static int compile_trace_begin(CompileTrace * trace) {
+    trace->file = getenv("PPKG_COMPILE_TRACE_FILE");
+
+    if (trace->file == NULL || trace->file[0] == '\0') {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &trace->begin);
+
+    return 1;
+}
+
+// the action of a compiler invocation whose argv has not been inspected otherwise.
+static inline const char * compile_trace_action_of(char * argv[]) {
+    const char * action = "link";
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (strcmp(argv[i], "-E") == 0) return "preprocess";
+        if (strcmp(argv[i], "-S") == 0) return "compile";
+        if (strcmp(argv[i], "-c") == 0) return "assemble";
+
+        if (strcmp(argv[i], "-shared") == 0 || strcmp(argv[i], "-dynamiclib") == 0) {
+            action = "shared";
+        } else if (strcmp(argv[i], "-static") == 0 || strcmp(argv[i], "--static") == 0) {
+            if (strcmp(action, "link") == 0) action = "static-exe";
+        }
+    }
+
+    return action;
+}
+
+// run the compiler as a child, returns its exit status.
+static int compile_trace_spawn(const char * compiler, char * argv[]) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        perror("fork");
+        return 255;
+    }
+
+    if (pid == 0) {
+        execv(compiler, argv);
+        perror(compiler);
+        _exit(255);
+    }
+
+    int status;
+
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            return 255;
+        }
+    }
+
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+
+    return 128 + WTERMSIG(status);
+}
+
+static long compile_trace_ms_of(struct timeval tv) {
+    return (long)tv.tv_sec * 1000L + (long)tv.tv_usec / 1000L;
+}
+
+// the cpu time of this process and the compilers it waited for.
+static void compile_trace_end(const CompileTrace * trace, const char * action, const char * cache, char * argv[], int status) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    long wallMs = (long)(end.tv_sec - trace->begin.tv_sec) * 1000L + (end.tv_nsec - trace->begin.tv_nsec) / 1000000L;
+
+    struct rusage self;
+    struct rusage children;
+
+    getrusage(RUSAGE_SELF,     &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    long userMs = compile_trace_ms_of(self.ru_utime) + compile_trace_ms_of(children.ru_utime);
+    long sysMs  = compile_trace_ms_of(self.ru_stime) + compile_trace_ms_of(children.ru_stime);
+
+    long maxRss = self.ru_maxrss > children.ru_maxrss ? self.ru_maxrss : children.ru_maxrss;
+
+#if defined (__APPLE__)
+    // in bytes on macOS, in kilobytes elsewhere.
+    maxRss /= 1024;
+#endif
+
+    const char * output = "-";
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (strcmp(argv[i], "-o") == 0) {
+            if (argv[i + 1] != NULL) {
+                output = argv[i + 1];
+            }
+        } else if (strncmp(argv[i], "-o", 2) == 0) {
+            output = argv[i] + 2;
+        }
+    }
+
+    char cwd[4096];
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        strcpy(cwd, "-");
+    }
+
+    char line[9000];
+
+    int n = snprintf(line, sizeof(line), "%s\t%d\t%ld\t%ld\t%ld\t%ld\t%s\t%s\t%s\n", action, status, wallMs, userMs, sysMs, maxRss, cache == NULL ? "-" : cache, cwd, output);
+
+    if (n <= 0) {
+        return;
+    }
+
+    if ((size_t)n >= sizeof(line)) {
+        n = sizeof(line) - 1;
+        line[n - 1] = '\n';
+    }
+
+    int fd = open(trace->file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+    if (fd == -1) {
+        perror(trace->file);
+        return;
+    }
+
+    if (write(fd, line, (size_t)n) != n) {
+        perror(trace->file);
+    }
+
+    close(fd);
+}
+
+#endif
@@ -0,0 +1,902 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ctype.h>
+#include <signal.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "sha256.h"
+#include "util.h"
+
+// downloads-db check  <FILEPATH> <SHA256>
+// downloads-db store  <FILEPATH> <SHA256> < stream > stream
+// downloads-db verify [--jobs=<N>]
+// downloads-db gc     [--max-size=<SIZE>] [--dry-run] < referenced-filenames
+//
+// the verified files are remembered in $PPKG_HOME/downloads.db, one line per file, sorted by path:
+//
+// <path>\t<size>\t<mtime-sec>\t<mtime-nsec>\t<dev>\t<ino>\t<sha256>
+//
+// check  : exit 0 if the given file has the given sha256sum, exit 10 if it does not exist or has a different sha256sum.
+//          a file whose path, size, mtime and inode are the same as when it was verified is trusted without reading it,
+//          otherwise it is hashed, and remembered if it matches.
+// store  : copy stdin to stdout, hash it and write it to <FILEPATH> in the same pass. so that a download can be unpacked while it is arriving.
+//          <FILEPATH> is renamed into place and remembered only if the whole stream has the given sha256sum, otherwise exit 10 and nothing is left.
+//          stdin is drained even if stdout is closed early, since an unpacker might stop reading at the end of an archive.
+// verify : re-hash every file of $PPKG_DOWNLOADS_DIR whose filename starts with its sha256sum in <N> processes, report the corrupted ones.
+//          the database is regenerated from the result. exit 10 if any file is corrupted.
+// gc     : remove the files of $PPKG_DOWNLOADS_DIR which are not in the given filename list, the least recently modified first,
+//          until the total size is not greater than <SIZE>, which may have a K, M, G or T suffix.
+//          if --max-size is not given, only the files remembered in the database are removed, the others were not fetched by ppkg.
+//
+// every modification is made under an exclusive lock of $PPKG_HOME/downloads.db.lock, the new database is written to a temporary file then renamed.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char *  path;
+    int64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    int64_t dev;
+    int64_t ino;
+    char    sha256[65];
+} Stamp;
+
+typedef struct {
+    Stamp * items;
+    size_t  size;
+    size_t  capacity;
+} Stamps;
+
+static char * dbFilePath;
+static char * lockFilePath;
+
+static const char * downloadsDir;
+
+/////////////////////////////////////////////////////////////////
+
+static Stamp * stamps_add(Stamps * stamps) {
+    if (stamps->size == stamps->capacity) {
+        size_t capacity = stamps->capacity == 0 ? 64 : stamps->capacity << 1;
+
+        Stamp * p = (Stamp*)realloc(stamps->items, capacity * sizeof(Stamp));
+
+        if (p == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+
+        stamps->items = p;
+        stamps->capacity = capacity;
+    }
+
+    Stamp * s = &stamps->items[stamps->size++];
+
+    memset(s, 0, sizeof(Stamp));
+
+    return s;
+}
+
+static Stamp * stamps_find(const Stamps * stamps, const char * path) {
+    for (size_t i = 0; i < stamps->size; i++) {
+        if (strcmp(stamps->items[i].path, path) == 0) {
+            return &stamps->items[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_stamp(const void * a, const void * b) {
+    return strcmp(((const Stamp *)a)->path, ((const Stamp *)b)->path);
+}
+
+static void stamp_of(Stamp * s, const struct stat * st) {
+    s->size      = (int64_t)st->st_size;
+    s->mtimeSec  = ST_MTIME_SEC(*st);
+    s->mtimeNsec = ST_MTIME_NSEC(*st);
+    s->dev       = (int64_t)st->st_dev;
+    s->ino       = (int64_t)st->st_ino;
+}
+
+// returns 1 if the file was not changed since it was stamped.
+static int stamp_matches(const Stamp * s, const struct stat * st) {
+    Stamp t;
+
+    stamp_of(&t, st);
+
+    return s->size == t.size && s->mtimeSec == t.mtimeSec && s->mtimeNsec == t.mtimeNsec && s->dev == t.dev && s->ino == t.ino;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// a missing database is an empty one.
+static int db_read(Stamps * stamps) {
+    FILE * file = fopen(dbFilePath, "r");
+
+    if (file == NULL) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+
+        perror(dbFilePath);
+        return 1;
+    }
+
+    char * line = NULL;
+    size_t lineCapacity = 0;
+
+    for (;;) {
+        ssize_t n = getline(&line, &lineCapacity, file);
+
+        if (n < 0) break;
+
+        if (n > 0 && line[n - 1] == '\n') {
+            line[--n] = '\0';
+        }
+
+        if (n == 0 || line[0] == '#') continue;
+
+        char * tab = strchr(line, '\t');
+
+        if (tab == NULL) continue;
+
+        *tab = '\0';
+
+        long long size, mtimeSec, mtimeNsec, dev, ino;
+
+        char sha256[65];
+
+        if (sscanf(tab + 1, "%lld\t%lld\t%lld\t%lld\t%lld\t%64s", &size, &mtimeSec, &mtimeNsec, &dev, &ino, sha256) != 6) continue;
+
+        Stamp * s = stamps_add(stamps);
+
+        s->path      = strdup2(line);
+        s->size      = size;
+        s->mtimeSec  = mtimeSec;
+        s->mtimeNsec = mtimeNsec;
+        s->dev       = dev;
+        s->ino       = ino;
+
+        memcpy(s->sha256, sha256, 65);
+    }
+
+    free(line);
+
+    int failed = ferror(file);
+
+    fclose(file);
+
+    if (failed) {
+        perror(dbFilePath);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int db_write(Stamps * stamps) {
+    qsort(stamps->items, stamps->size, sizeof(Stamp), compare_stamp);
+
+    char tmpSuffix[32];
+
+    snprintf(tmpSuffix, sizeof(tmpSuffix), ".%d.tmp", (int)getpid());
+
+    char * tmpFilePath = strdup3(dbFilePath, tmpSuffix, "");
+
+    FILE * file = fopen(tmpFilePath, "w");
+
+    if (file == NULL) {
+        perror(tmpFilePath);
+        return 1;
+    }
+
+    fputs("# ppkg verified downloads database, regenerate it with: ppkg downloads verify\n", file);
+
+    for (size_t i = 0; i < stamps->size; i++) {
+        const Stamp * s = &stamps->items[i];
+
+        fprintf(file, "%s\t%lld\t%lld\t%lld\t%lld\t%lld\t%s\n", s->path, (long long)s->size, (long long)s->mtimeSec, (long long)s->mtimeNsec, (long long)s->dev, (long long)s->ino, s->sha256);
+    }
+
+    int ok = fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        perror(tmpFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    if (rename(tmpFilePath, dbFilePath) != 0) {
+        perror(dbFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    free(tmpFilePath);
+
+    return 0;
+}
+
+static int lockFD = -1;
+
+static int db_lock(void) {
+    lockFD = open(lockFilePath, O_RDWR | O_CREAT, 0644);
+
+    if (lockFD == -1) {
+        perror(lockFilePath);
+        return 1;
+    }
+
+    struct flock lock;
+
+    memset(&lock, 0, sizeof(lock));
+
+    lock.l_type   = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+
+    while (fcntl(lockFD, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR) {
+            perror(lockFilePath);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void db_unlock(void) {
+    if (lockFD != -1) {
+        close(lockFD);
+        lockFD = -1;
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int record(const char * path, const char * sha256) {
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    if (db_lock() != 0) {
+        return 1;
+    }
+
+    Stamps stamps = {0};
+
+    if (db_read(&stamps) != 0) {
+        db_unlock();
+        return 1;
+    }
+
+    Stamp * s = stamps_find(&stamps, path);
+
+    if (s == NULL) {
+        s = stamps_add(&stamps);
+        s->path = strdup2(path);
+    }
+
+    stamp_of(s, &st);
+
+    memcpy(s->sha256, sha256, 65);
+
+    int ret = db_write(&stamps);
+
+    db_unlock();
+
+    return ret;
+}
+
+static int check(const char * filepath, const char * expected) {
+    if (strlen(expected) != 64) {
+        fprintf(stderr, "not a sha256sum: %s\n", expected);
+        return 1;
+    }
+
+    char * path = realpath(filepath, NULL);
+
+    if (path == NULL) {
+        return errno == ENOENT ? 10 : (perror(filepath), 1);
+    }
+
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        return 10;
+    }
+
+    Stamps stamps = {0};
+
+    if (db_read(&stamps) != 0) {
+        return 1;
+    }
+
+    Stamp * s = stamps_find(&stamps, path);
+
+    if (s != NULL && stamp_matches(s, &st) && strcmp(s->sha256, expected) == 0) {
+        return 0;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    char actual[65];
+
+    if (sha256_of_file(path, actual) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    if (strcmp(actual, expected) != 0) {
+        return 10;
+    }
+
+    return record(path, actual);
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int store(const char * filepath, const char * expected) {
+    if (strlen(expected) != 64) {
+        fprintf(stderr, "not a sha256sum: %s\n", expected);
+        return 1;
+    }
+
+    char tmpSuffix[32];
+
+    snprintf(tmpSuffix, sizeof(tmpSuffix), ".%d.tmp", (int)getpid());
+
+    char * tmpFilePath = strdup3(filepath, tmpSuffix, "");
+
+    int fd = open(tmpFilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1) {
+        perror(tmpFilePath);
+        return 1;
+    }
+
+    // a closed stdout is reported by write() as EPIPE instead of killing this process.
+    signal(SIGPIPE, SIG_IGN);
+
+    int forwarding = 1;
+
+    SHA256 ctx;
+
+    sha256_init(&ctx);
+
+    unsigned char buf[65536];
+
+    for (;;) {
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+
+        if (n == 0) break;
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("stdin");
+            goto failed;
+        }
+
+        sha256_update(&ctx, buf, (size_t)n);
+
+        if (write_fully(fd, buf, (size_t)n) != 0) {
+            perror(tmpFilePath);
+            goto failed;
+        }
+
+        if (forwarding && write_fully(STDOUT_FILENO, buf, (size_t)n) != 0) {
+            if (errno != EPIPE) {
+                perror("stdout");
+                goto failed;
+            }
+
+            forwarding = 0;
+        }
+    }
+
+    unsigned char digest[32];
+
+    char actual[65];
+
+    sha256_final(&ctx, digest);
+    sha256_to_hex(digest, actual);
+
+    if (strcmp(actual, expected) != 0) {
+        fprintf(stderr, "sha256sum mismatch.\n    expect : %s\n    actual : %s\n", expected, actual);
+        close(fd);
+        unlink(tmpFilePath);
+        return 10;
+    }
+
+    if (fsync(fd) != 0 || close(fd) != 0) {
+        perror(tmpFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    if (rename(tmpFilePath, filepath) != 0) {
+        perror(filepath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    char * path = realpath(filepath, NULL);
+
+    if (path == NULL) {
+        perror(filepath);
+        return 1;
+    }
+
+    return record(path, actual);
+
+failed:
+    close(fd);
+    unlink(tmpFilePath);
+    return 1;
+}
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char *  path;
+    char *  name;
+    int64_t size;
+    int64_t mtimeSec;
+    struct stat st;
+} Entry;
+
+typedef struct {
+    Entry * items;
+    size_t  size;
+    size_t  capacity;
+} Entries;
+
+// every regular file directly under $PPKG_DOWNLOADS_DIR
+static int scan_downloads_dir(Entries * entries) {
+    char * dir = realpath(downloadsDir, NULL);
+
+    if (dir == NULL) {
+        if (errno == ENOENT) return 0;
+        perror(downloadsDir);
+        return 1;
+    }
+
+    DIR * d = opendir(dir);
+
+    if (d == NULL) {
+        perror(dir);
+        return 1;
+    }
+
+    struct dirent * e;
+
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+
+        char * path = strdup3(dir, "/", e->d_name);
+
+        struct stat st;
+
+        if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        if (entries->size == entries->capacity) {
+            entries->capacity = entries->capacity == 0 ? 64 : entries->capacity << 1;
+            entries->items = (Entry*)realloc(entries->items, entries->capacity * sizeof(Entry));
+
+            if (entries->items == NULL) {
+                perror(NULL);
+                exit(1);
+            }
+        }
+
+        Entry * entry = &entries->items[entries->size++];
+
+        entry->path     = path;
+        entry->name     = path + strlen(dir) + 1;
+        entry->size     = (int64_t)st.st_size;
+        entry->mtimeSec = ST_MTIME_SEC(st);
+        entry->st       = st;
+    }
+
+    closedir(d);
+
+    free(dir);
+
+    return 0;
+}
+
+// a file fetched for a formula is named <SHA256><FILETYPE>
+static int is_named_by_sha256(const char * name) {
+    for (int i = 0; i < 64; i++) {
+        if (!isxdigit((unsigned char)name[i]) || isupper((unsigned char)name[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int verify(int argc, char * argv[]) {
+    int jobs = 4;
+
+    for (int i = 0; i < argc; i++) {
+        if (starts_with(argv[i], "--jobs=") && is_integer(argv[i] + 7) && atoi(argv[i] + 7) > 0) {
+            jobs = atoi(argv[i] + 7);
+        } else {
+            fprintf(stderr, "Usage: downloads-db verify [--jobs=<N>], unrecognized argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    Entries entries = {0};
+
+    if (scan_downloads_dir(&entries) != 0) {
+        return 1;
+    }
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < entries.size; i++) {
+        if (is_named_by_sha256(entries.items[i].name)) {
+            entries.items[n++] = entries.items[i];
+        }
+    }
+
+    entries.size = n;
+
+    if ((size_t)jobs > entries.size) {
+        jobs = entries.size == 0 ? 1 : (int)entries.size;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    // every worker hashes every jobs-th file and writes '<INDEX> <SHA256>' to the pipe, a line is shorter than PIPE_BUF so it is written atomically.
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (int w = 0; w < jobs; w++) {
+        pid_t pid = fork();
+
+        if (pid == -1) {
+            perror(NULL);
+            return 1;
+        }
+
+        if (pid == 0) {
+            close(fds[0]);
+
+            for (size_t i = (size_t)w; i < entries.size; i += (size_t)jobs) {
+                char hex[65];
+
+                if (sha256_of_file(entries.items[i].path, hex) != 0) {
+                    strcpy(hex, "-");
+                }
+
+                char line[128];
+
+                int len = snprintf(line, sizeof(line), "%zu %s\n", i, hex);
+
+                if (write(fds[1], line, (size_t)len) != len) {
+                    _exit(1);
+                }
+            }
+
+            _exit(0);
+        }
+    }
+
+    close(fds[1]);
+
+    /////////////////////////////////////////////////////////////////
+
+    Stamps stamps = {0};
+
+    size_t corrupted = 0;
+    int64_t totalSize = 0;
+
+    FILE * file = fdopen(fds[0], "r");
+
+    if (file == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    char line[128];
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t i;
+        char   hex[65];
+
+        if (sscanf(line, "%zu %64s", &i, hex) != 2 || i >= entries.size) continue;
+
+        const Entry * entry = &entries.items[i];
+
+        totalSize += entry->size;
+
+        if (strncmp(entry->name, hex, 64) == 0) {
+            Stamp * s = stamps_add(&stamps);
+
+            s->path = entry->path;
+
+            stamp_of(s, &entry->st);
+
+            memcpy(s->sha256, hex, 65);
+        } else {
+            corrupted++;
+            printf("corrupted %s\n", entry->path);
+        }
+    }
+
+    fclose(file);
+
+    int ret = 0;
+
+    for (int w = 0; w < jobs; w++) {
+        int status;
+
+        if (wait(&status) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ret = 1;
+        }
+    }
+
+    if (ret != 0) {
+        fprintf(stderr, "some files could not be verified.\n");
+        return 1;
+    }
+
+    if (db_lock() != 0) {
+        return 1;
+    }
+
+    ret = db_write(&stamps);
+
+    db_unlock();
+
+    if (ret != 0) {
+        return 1;
+    }
+
+    printf("%zu files, %lld bytes, %zu verified, %zu corrupted\n", entries.size, (long long)totalSize, stamps.size, corrupted);
+
+    return corrupted == 0 ? 0 : 10;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int compare_string_pointer(const void * a, const void * b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int compare_entry_by_mtime(const void * a, const void * b) {
+    const Entry * x = (const Entry *)a;
+    const Entry * y = (const Entry *)b;
+
+    if (x->mtimeSec != y->mtimeSec) {
+        return x->mtimeSec < y->mtimeSec ? -1 : 1;
+    }
+
+    return strcmp(x->name, y->name);
+}
+
+static int gc(int argc, char * argv[]) {
+    int64_t maxSize = -1;
+
+    int dryRun = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (starts_with(argv[i], "--max-size=")) {
+            if (parse_size(argv[i] + 11, &maxSize) != 0) {
+                fprintf(stderr, "--max-size=<SIZE>, <SIZE> must be an integer with an optional K, M, G or T suffix.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dry-run") == 0) {
+            dryRun = 1;
+        } else {
+            fprintf(stderr, "Usage: downloads-db gc [--max-size=<SIZE>] [--dry-run] < referenced-filenames, unrecognized argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    char ** referenced = NULL;
+    size_t  referencedCount = 0;
+    size_t  referencedCapacity = 0;
+
+    char * line = NULL;
+    size_t lineCapacity = 0;
+
+    for (;;) {
+        ssize_t n = getline(&line, &lineCapacity, stdin);
+
+        if (n < 0) break;
+
+        if (n > 0 && line[n - 1] == '\n') {
+            line[--n] = '\0';
+        }
+
+        if (n == 0) continue;
+
+        if (referencedCount == referencedCapacity) {
+            referencedCapacity = referencedCapacity == 0 ? 256 : referencedCapacity << 1;
+            referenced = (char**)realloc(referenced, referencedCapacity * sizeof(char*));
+
+            if (referenced == NULL) {
+                perror(NULL);
+                return 1;
+            }
+        }
+
+        // a path is accepted as well
+        const char * slash = strrchr(line, '/');
+
+        referenced[referencedCount++] = strdup2(slash == NULL ? line : slash + 1);
+    }
+
+    free(line);
+
+    qsort(referenced, referencedCount, sizeof(char*), compare_string_pointer);
+
+    /////////////////////////////////////////////////////////////////
+
+    Entries entries = {0};
+
+    if (scan_downloads_dir(&entries) != 0) {
+        return 1;
+    }
+
+    int64_t totalSize = 0;
+
+    for (size_t i = 0; i < entries.size; i++) {
+        totalSize += entries.items[i].size;
+    }
+
+    qsort(entries.items, entries.size, sizeof(Entry), compare_entry_by_mtime);
+
+    // a file which is not in the database might have been fetched by another tool, e.g. xbuilder, it is only removed to meet --max-size.
+    Stamps recorded = {0};
+
+    if (maxSize < 0 && db_read(&recorded) != 0) {
+        return 1;
+    }
+
+    size_t  removedCount = 0;
+    int64_t removedSize  = 0;
+
+    for (size_t i = 0; i < entries.size; i++) {
+        if (maxSize >= 0 && totalSize - removedSize <= maxSize) break;
+
+        const Entry * entry = &entries.items[i];
+
+        const char * name = entry->name;
+
+        if (bsearch(&name, referenced, referencedCount, sizeof(char*), compare_string_pointer) != NULL) continue;
+
+        if (maxSize < 0 && stamps_find(&recorded, entry->path) == NULL) continue;
+
+        if (!dryRun && unlink(entry->path) != 0) {
+            perror(entry->path);
+            continue;
+        }
+
+        printf("removed %s %lld\n", entry->path, (long long)entry->size);
+
+        removedCount++;
+        removedSize += entry->size;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    int ret = 0;
+
+    if (!dryRun && removedCount > 0) {
+        if (db_lock() != 0) {
+            return 1;
+        }
+
+        Stamps stamps = {0};
+
+        ret = db_read(&stamps);
+
+        if (ret == 0) {
+            size_t n = 0;
+
+            for (size_t i = 0; i < stamps.size; i++) {
+                if (exists(stamps.items[i].path)) {
+                    stamps.items[n++] = stamps.items[i];
+                }
+            }
+
+            stamps.size = n;
+
+            ret = db_write(&stamps);
+        }
+
+        db_unlock();
+    }
+
+    printf("%zu files, %lld bytes removed, %lld bytes kept\n", removedCount, (long long)removedSize, (long long)(totalSize - removedSize));
+
+    if (maxSize >= 0 && totalSize - removedSize > maxSize) {
+        fprintf(stderr, "the files still referenced by formulas take more than %lld bytes.\n", (long long)maxSize);
+    }
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <check|store|verify|gc> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    const char * ppkgHome = getenv("PPKG_HOME");
+
+    downloadsDir = getenv("PPKG_DOWNLOADS_DIR");
+
+    if (ppkgHome == NULL || ppkgHome[0] == '\0' || downloadsDir == NULL || downloadsDir[0] == '\0') {
+        fprintf(stderr, "PPKG_HOME and PPKG_DOWNLOADS_DIR environment variables must be set.\n");
+        return 1;
+    }
+
+    dbFilePath   = strdup3(ppkgHome, "/", "downloads.db");
+    lockFilePath = strdup3(ppkgHome, "/", "downloads.db.lock");
+
+    int ret;
+
+    if (strcmp(argv[1], "check") == 0) {
+        if (argc != 4 || argv[2][0] == '\0') {
+            fprintf(stderr, "Usage: %s check <FILEPATH> <SHA256>\n", argv[0]);
+            return 1;
+        }
+
+        ret = check(argv[2], argv[3]);
+    } else if (strcmp(argv[1], "store") == 0) {
+        if (argc != 4 || argv[2][0] == '\0') {
+            fprintf(stderr, "Usage: %s store <FILEPATH> <SHA256>\n", argv[0]);
+            return 1;
+        }
+
+        ret = store(argv[2], argv[3]);
+    } else if (strcmp(argv[1], "verify") == 0) {
+        ret = verify(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "gc") == 0) {
+        ret = gc(argc - 2, argv + 2);
+    } else {
+        fprintf(stderr, "unrecognized action: %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
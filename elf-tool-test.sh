@@ -0,0 +1,45 @@
+#!/bin/sh
+
+# the DT_RUNPATH rewritten by elf-tool set-runpath is read back by readelf -d, no patchelf is needed, every edit fits in place.
+
+set -ex
+
+TEST_DIR="$(mktemp -d)"
+
+trap 'rm -rf "$TEST_DIR"' EXIT
+
+cc -std=c99 -Os -o "$TEST_DIR/elf-tool" elf-tool.c
+
+cd "$TEST_DIR"
+
+mkdir -p bin lib x/y
+
+printf 'int main(void) { return 0; }\n' > main.c
+
+cc -o bin/runpath main.c -Wl,--enable-new-dtags  -Wl,-rpath,/placeholder/placeholder/placeholder/placeholder
+cc -o bin/rpath   main.c -Wl,--disable-new-dtags -Wl,-rpath,/placeholder/placeholder/placeholder/placeholder
+cc -o bin/removed main.c -Wl,--enable-new-dtags  -Wl,-rpath,/placeholder
+
+check() {
+    [ "$(readelf -d "$1" | sed -n -e 's/.*(RPATH).*\[\(.*\)\]$/RPATH \1/p' -e 's/.*(RUNPATH).*\[\(.*\)\]$/RUNPATH \1/p')" = "$2" ]
+}
+
+printf '%s\t%s\n' bin/runpath - bin/runpath lib bin/runpath x/y bin/rpath - bin/rpath lib bin/removed - | ./elf-tool set-runpath > result.txt
+
+cat result.txt
+
+# the files are split among the workers, so the lines might be printed in any order.
+[ "$(sort result.txt)" = "$(printf '%s\t%s\t%s\n' bin/removed removed '' bin/rpath in-place '$ORIGIN/../lib' bin/runpath in-place '$ORIGIN/../lib:$ORIGIN/../x/y')" ]
+
+check bin/runpath 'RUNPATH $ORIGIN/../lib:$ORIGIN/../x/y'
+check bin/rpath   'RUNPATH $ORIGIN/../lib'
+check bin/removed ''
+
+./bin/runpath
+./bin/rpath
+./bin/removed
+
+# the same edits again change nothing.
+printf '%s\t%s\n' bin/rpath - bin/rpath lib | ./elf-tool set-runpath > result.txt
+
+[ "$(cat result.txt)" = "$(printf '%s\t%s\t%s\n' bin/rpath unchanged '$ORIGIN/../lib')" ]
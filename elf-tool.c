@@ -0,0 +1,1346 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ftw.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "util.h"
+
+// elf-tool scan <INSTALL-DIR> [DEPENDENCY-INSTALL-DIR]...
+//
+// scan : find the dynamically linked executables and shared libraries under <INSTALL-DIR>, then resolve the libraries they need (DT_NEEDED):
+//        first in <INSTALL-DIR>/lib, then in <DEPENDENCY-INSTALL-DIR>/lib in the given order. the libraries provided by the toolchain are skipped.
+//        the following lines are printed, the paths under <INSTALL-DIR> are relative to it and start with ./
+//
+//        remove-rpath\t<PATH>  <PATH> has a DT_RPATH or DT_RUNPATH
+//        S1\t<PATH>            <PATH> needs a library found in <INSTALL-DIR>/lib
+//        S2\t<PATH>            <PATH> needs a library found in <DEPENDENCY-INSTALL-DIR>/lib
+//        needed\t<LIB-PATH>    <LIB-PATH> in <DEPENDENCY-INSTALL-DIR>/lib is needed, directly or by another needed one.
+//
+//        each file is read by one mmap, the files are split among one worker process per online cpu.
+//        every ELF class and byte order is supported, so that a cross-compiled package is scanned as well as a native one.
+//
+// elf-tool set-runpath < <EDITS>
+//
+// set-runpath : read the edits from stdin, one per line. the paths are relative to the current directory or absolute.
+//
+//        <FILE>\t-      remove the DT_RPATH and DT_RUNPATH of <FILE>
+//        <FILE>\t<DIR>  append $ORIGIN/<the path of DIR relative to the directory of FILE> to the DT_RUNPATH of <FILE>
+//
+//        the edits of a file are applied in the given order but written at once, the following line is printed for every file:
+//
+//        <FILE>\t<in-place|removed|unchanged|patchelf|error>\t<RUNPATH>
+//
+//        the file is modified in place if the new DT_RUNPATH fits in the space of its old DT_RPATH or DT_RUNPATH string,
+//        otherwise the dynamic string table has to grow, it is rewritten by patchelf once. the files are split among one worker process per online cpu.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char ** items;
+    size_t  size;
+    size_t  capacity;
+} Strings;
+
+static void strings_push(Strings * strings, char * s) {
+    if (strings->size == strings->capacity) {
+        strings->capacity = strings->capacity == 0 ? 64 : strings->capacity << 1;
+
+        strings->items = (char**)realloc(strings->items, strings->capacity * sizeof(char*));
+
+        if (strings->items == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    strings->items[strings->size++] = s;
+}
+
+static int strings_contains(const Strings * strings, const char * s) {
+    for (size_t i = 0; i < strings->size; i++) {
+        if (strcmp(strings->items[i], s) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// http://www.sco.com/developers/gabi/latest/ch4.eheader.html
+// http://www.sco.com/developers/gabi/latest/ch5.dynamic.html
+
+#define ELF_ET_EXEC     2
+#define ELF_ET_DYN      3
+
+#define ELF_PT_LOAD     1
+#define ELF_PT_DYNAMIC  2
+
+#define ELF_SHT_DYNSYM  11
+#define ELF_SHT_VERDEF  0x6ffffffd
+#define ELF_SHT_VERNEED 0x6ffffffe
+
+#define ELF_DT_NULL     0
+#define ELF_DT_NEEDED   1
+#define ELF_DT_STRTAB   5
+#define ELF_DT_STRSZ    10
+#define ELF_DT_SONAME   14
+#define ELF_DT_RPATH    15
+#define ELF_DT_RUNPATH  29
+
+#define ELF_DT_CONFIG    0x6ffffefa
+#define ELF_DT_DEPAUDIT  0x6ffffefb
+#define ELF_DT_AUDIT     0x6ffffefc
+#define ELF_DT_AUXILIARY 0x7ffffffd
+#define ELF_DT_FILTER    0x7fffffff
+
+typedef struct {
+    int       hasRunpath;
+    Strings   needed;
+
+    // the following are used by set-runpath
+
+    int       is64;
+    int       bigEndian;
+
+    uint64_t  dynOffset;
+    uint64_t  dynCount;       // the number of the dynamic entries before the first DT_NULL
+
+    uint64_t  strtabOffset;   // UINT64_MAX if the file offset of DT_STRTAB is unknown
+    uint64_t  strtabSize;
+
+    int       runpathCount;   // the number of the DT_RPATH and DT_RUNPATH entries
+    uint64_t  runpathIndex;   // the index of the last one of them
+} ElfInfo;
+
+static uint64_t read_uint(const unsigned char * p, int size, int bigEndian) {
+    uint64_t v = 0;
+
+    for (int i = 0; i < size; i++) {
+        v |= (uint64_t)p[bigEndian ? size - 1 - i : i] << (8 * i);
+    }
+
+    return v;
+}
+
+static void write_uint(unsigned char * p, int size, int bigEndian, uint64_t v) {
+    for (int i = 0; i < size; i++) {
+        p[bigEndian ? size - 1 - i : i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+// returns 0 if <P> is an executable or a shared library which has a dynamic section, -1 otherwise.
+static int parse_elf(const unsigned char * p, size_t size, ElfInfo * info) {
+    if (size < 52 || memcmp(p, "\177ELF", 4) != 0) {
+        return -1;
+    }
+
+    if ((p[4] != 1 && p[4] != 2) || (p[5] != 1 && p[5] != 2)) {
+        return -1;
+    }
+
+    const int is64 = p[4] == 2;
+    const int be   = p[5] == 2;
+
+    if (is64 && size < 64) {
+        return -1;
+    }
+
+    const uint64_t type = read_uint(p + 16, 2, be);
+
+    if (type != ELF_ET_EXEC && type != ELF_ET_DYN) {
+        return -1;
+    }
+
+    const uint64_t phoff     = is64 ? read_uint(p + 32, 8, be) : read_uint(p + 28, 4, be);
+    const uint64_t phentsize = is64 ? read_uint(p + 54, 2, be) : read_uint(p + 42, 2, be);
+    const uint64_t phnum     = is64 ? read_uint(p + 56, 2, be) : read_uint(p + 44, 2, be);
+
+    if (phentsize < (uint64_t)(is64 ? 56 : 32) || phoff > size || phnum > (size - phoff) / phentsize) {
+        return -1;
+    }
+
+    uint64_t dynOffset = 0;
+    uint64_t dynSize   = 0;
+
+    for (uint64_t i = 0; i < phnum; i++) {
+        const unsigned char * ph = p + phoff + i * phentsize;
+
+        if (read_uint(ph, 4, be) == ELF_PT_DYNAMIC) {
+            dynOffset = is64 ? read_uint(ph +  8, 8, be) : read_uint(ph +  4, 4, be);
+            dynSize   = is64 ? read_uint(ph + 32, 8, be) : read_uint(ph + 16, 4, be);
+            break;
+        }
+    }
+
+    if (dynSize == 0 || dynOffset > size || dynSize > size - dynOffset) {
+        return -1;
+    }
+
+    const uint64_t dynEntSize = is64 ? 16 : 8;
+
+    uint64_t dynCount = dynSize / dynEntSize;
+
+    uint64_t strtabAddr = 0;
+    uint64_t strtabSize = 0;
+
+    for (uint64_t i = 0; i < dynCount; i++) {
+        const unsigned char * d = p + dynOffset + i * dynEntSize;
+
+        const uint64_t tag = is64 ? read_uint(d, 8, be) : read_uint(d, 4, be);
+        const uint64_t val = is64 ? read_uint(d + 8, 8, be) : read_uint(d + 4, 4, be);
+
+        if (tag == ELF_DT_NULL) {
+            dynCount = i;
+            break;
+        }
+
+        switch (tag) {
+            case ELF_DT_STRTAB:  strtabAddr = val; break;
+            case ELF_DT_STRSZ:   strtabSize = val; break;
+            case ELF_DT_RPATH:
+            case ELF_DT_RUNPATH:
+                info->hasRunpath = 1;
+                info->runpathCount++;
+                info->runpathIndex = i;
+                break;
+        }
+    }
+
+    info->is64         = is64;
+    info->bigEndian    = be;
+    info->dynOffset    = dynOffset;
+    info->dynCount     = dynCount;
+    info->strtabOffset = UINT64_MAX;
+
+    // DT_STRTAB is a virtual address, find the file offset of it by the loadable segment containing it.
+    uint64_t strtabOffset = UINT64_MAX;
+
+    for (uint64_t i = 0; i < phnum; i++) {
+        const unsigned char * ph = p + phoff + i * phentsize;
+
+        if (read_uint(ph, 4, be) != ELF_PT_LOAD) continue;
+
+        const uint64_t offset = is64 ? read_uint(ph +  8, 8, be) : read_uint(ph +  4, 4, be);
+        const uint64_t vaddr  = is64 ? read_uint(ph + 16, 8, be) : read_uint(ph +  8, 4, be);
+        const uint64_t filesz = is64 ? read_uint(ph + 32, 8, be) : read_uint(ph + 16, 4, be);
+
+        if (strtabAddr >= vaddr && strtabAddr - vaddr < filesz) {
+            strtabOffset = strtabAddr - vaddr + offset;
+            break;
+        }
+    }
+
+    if (strtabOffset >= size) {
+        return 0;
+    }
+
+    if (strtabSize == 0 || strtabSize > size - strtabOffset) {
+        strtabSize = size - strtabOffset;
+    }
+
+    info->strtabOffset = strtabOffset;
+    info->strtabSize   = strtabSize;
+
+    for (uint64_t i = 0; i < dynCount; i++) {
+        const unsigned char * d = p + dynOffset + i * dynEntSize;
+
+        const uint64_t tag = is64 ? read_uint(d, 8, be) : read_uint(d, 4, be);
+        const uint64_t val = is64 ? read_uint(d + 8, 8, be) : read_uint(d + 4, 4, be);
+
+        if (tag == ELF_DT_NULL) break;
+
+        if (tag != ELF_DT_NEEDED || val >= strtabSize) continue;
+
+        const char * name = (const char *)p + strtabOffset + val;
+
+        size_t n = 0;
+
+        while (val + n < strtabSize && name[n] != '\0') n++;
+
+        if (n == 0 || val + n == strtabSize) continue;
+
+        char * s = strndup(name, n);
+
+        if (s == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+
+        strings_push(&info->needed, s);
+    }
+
+    return 0;
+}
+
+// returns 0 if the given file is an executable or a shared library which has a dynamic section, -1 otherwise.
+static int parse_elf_file(const char * path, ElfInfo * info) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 52) {
+        close(fd);
+        return -1;
+    }
+
+    // most of the installed files are not ELF files, only the ELF files are mapped.
+    unsigned char magic[4];
+
+    if (pread(fd, magic, 4, 0) != 4 || memcmp(magic, "\177ELF", 4) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    void * p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    int ret = parse_elf((const unsigned char *)p, (size_t)st.st_size, info);
+
+    munmap(p, (size_t)st.st_size);
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static Strings files;
+
+static int collect_file(const char * fpath, const struct stat * sb, int typeflag, struct FTW * ftwbuf) {
+    (void)ftwbuf;
+
+    if (typeflag == FTW_F && S_ISREG(sb->st_mode)) {
+        strings_push(&files, strdup2(fpath));
+    }
+
+    return 0;
+}
+
+// the file names of the libraries under ./lib, a symlink to a regular file counts. sorted once collected.
+static Strings libNames;
+
+static int collect_lib(const char * fpath, const struct stat * sb, int typeflag, struct FTW * ftwbuf) {
+    (void)sb;
+
+    if (typeflag != FTW_F && typeflag != FTW_SL) {
+        return 0;
+    }
+
+    if (!is_regular_file(fpath)) {
+        return 0;
+    }
+
+    strings_push(&libNames, strdup2(fpath + ftwbuf->base));
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// the libraries provided by the C/C++ toolchain, they are never copied into .ppkg/dependencies/lib
+static int is_toolchain_library(const char * name) {
+    static const char * const names[] = {
+        "libc", "libm", "librt", "libdl", "libomp", "libgomp", "libc++", "libstdc++", "libasan", "libmvec", "libutil", "libcrypt", "libresolv",
+        "libpthread", "libgfortran", "libgcc_s", "libtinfo", NULL
+    };
+
+    // the same as ${NEEDED%.so*}
+    size_t n = strlen(name);
+
+    for (size_t i = n; i >= 3; i--) {
+        if (strncmp(name + i - 3, ".so", 3) == 0) {
+            n = i - 3;
+            break;
+        }
+    }
+
+    for (int i = 0; names[i] != NULL; i++) {
+        if (strlen(names[i]) == n && strncmp(name, names[i], n) == 0) {
+            return 1;
+        }
+    }
+
+    return strncmp(name, "libclang_rt.", 12) == 0 || strncmp(name, "libc.musl-", 10) == 0 || strncmp(name, "ld-linux-", 9) == 0;
+}
+
+static Strings s1;
+static Strings s2;
+static Strings neededLibs;
+
+static char ** dependencyDirs;
+static int     dependencyDirCount;
+
+// returns the path of <NAME> in <DEPENDENCY-INSTALL-DIR>/lib, NULL if it is not found.
+static char * find_in_dependencies(const char * name) {
+    for (int i = 0; i < dependencyDirCount; i++) {
+        char * path = strdup3(dependencyDirs[i], "/lib/", name);
+
+        if (is_regular_file(path)) {
+            return path;
+        }
+
+        free(path);
+    }
+
+    return NULL;
+}
+
+static void resolve_dependency_library(const char * path);
+
+static void resolve(const char * path, const ElfInfo * info, int underInstallDir) {
+    int inS1 = 0;
+    int inS2 = 0;
+
+    for (size_t i = 0; i < info->needed.size; i++) {
+        const char * name = info->needed.items[i];
+
+        if (is_toolchain_library(name)) continue;
+
+        if (underInstallDir) {
+            char * libPath = strdup3("./lib", "/", name);
+
+            int found = is_regular_file(libPath);
+
+            free(libPath);
+
+            if (!found) {
+                found = bsearch(&name, libNames.items, libNames.size, sizeof(char*), compare_string) != NULL;
+            }
+
+            if (found) {
+                // the library itself is scanned as a file under <INSTALL-DIR>
+                if (!inS1) {
+                    strings_push(&s1, strdup2(path));
+                    inS1 = 1;
+                }
+
+                continue;
+            }
+        }
+
+        char * depPath = find_in_dependencies(name);
+
+        if (depPath == NULL) continue;
+
+        if (underInstallDir && !inS2) {
+            strings_push(&s2, strdup2(path));
+            inS2 = 1;
+        }
+
+        if (strings_contains(&neededLibs, depPath)) {
+            free(depPath);
+        } else {
+            strings_push(&neededLibs, depPath);
+            resolve_dependency_library(depPath);
+        }
+    }
+}
+
+static void resolve_dependency_library(const char * path) {
+    ElfInfo info = {0};
+
+    if (parse_elf_file(path, &info) == 0) {
+        resolve(path, &info, 0);
+    }
+
+    for (size_t i = 0; i < info.needed.size; i++) {
+        free(info.needed.items[i]);
+    }
+
+    free(info.needed.items);
+}
+
+/////////////////////////////////////////////////////////////////
+
+#define MAX_WORKER_COUNT 64
+
+// split <ITEM-COUNT> items among one worker process per online cpu, worker i takes the items i, i + n, i + 2n, ...
+// the output of worker i is left in <OUTPUTS>[i], rewound. returns the number of the workers, -1 if any of them failed.
+static int fan_out(size_t itemCount, void (*work)(int worker, int workerCount, FILE * output), FILE * outputs[MAX_WORKER_COUNT]) {
+    long workerCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (workerCount < 1) workerCount = 1;
+    if (workerCount > MAX_WORKER_COUNT) workerCount = MAX_WORKER_COUNT;
+
+    // forking is not worth it for a few items.
+    if ((size_t)workerCount > itemCount / 64 + 1) {
+        workerCount = (long)(itemCount / 64 + 1);
+    }
+
+    pid_t pids[MAX_WORKER_COUNT];
+
+    for (long i = 0; i < workerCount; i++) {
+        outputs[i] = tmpfile();
+
+        if (outputs[i] == NULL) {
+            perror("tmpfile");
+            return -1;
+        }
+
+        if (workerCount == 1) {
+            work(0, 1, outputs[i]);
+            pids[i] = -1;
+            continue;
+        }
+
+        fflush(stdout);
+
+        pids[i] = fork();
+
+        if (pids[i] == -1) {
+            perror("fork");
+            return -1;
+        }
+
+        if (pids[i] == 0) {
+            work((int)i, (int)workerCount, outputs[i]);
+            _exit(fflush(outputs[i]) == 0 ? 0 : 1);
+        }
+    }
+
+    int ret = (int)workerCount;
+
+    for (long i = 0; i < workerCount; i++) {
+        if (pids[i] != -1) {
+            int status;
+
+            while (waitpid(pids[i], &status, 0) == -1) {
+                if (errno != EINTR) {
+                    perror("waitpid");
+                    return -1;
+                }
+            }
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ret = -1;
+            }
+        }
+
+        fflush(outputs[i]);
+    }
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// a worker writes one line per ELF file it parsed: <INDEX>\t<r|->[\t<NEEDED>]...
+static void scan_files_by_worker(int worker, int workerCount, FILE * output) {
+    for (size_t i = (size_t)worker; i < files.size; i += (size_t)workerCount) {
+        ElfInfo info = {0};
+
+        if (parse_elf_file(files.items[i], &info) != 0) {
+            continue;
+        }
+
+        fprintf(output, "%zu\t%c", i, info.hasRunpath ? 'r' : '-');
+
+        for (size_t j = 0; j < info.needed.size; j++) {
+            if (strpbrk(info.needed.items[j], "\t\n") == NULL) {
+                fprintf(output, "\t%s", info.needed.items[j]);
+            }
+
+            free(info.needed.items[j]);
+        }
+
+        free(info.needed.items);
+
+        fputc('\n', output);
+    }
+}
+
+static int scan(const char * installDir, char * deps[], int depCount) {
+    if (chdir(installDir) != 0) {
+        perror(installDir);
+        return 1;
+    }
+
+    dependencyDirs     = deps;
+    dependencyDirCount = depCount;
+
+    if (nftw(".", collect_file, 64, FTW_PHYS) != 0) {
+        perror(installDir);
+        return 1;
+    }
+
+    qsort(files.items, files.size, sizeof(char*), compare_string);
+
+    if (is_directory("lib") && nftw("./lib", collect_lib, 64, FTW_PHYS) != 0) {
+        perror("lib");
+        return 1;
+    }
+
+    qsort(libNames.items, libNames.size, sizeof(char*), compare_string);
+
+    /////////////////////////////////////////////////////////////////
+
+    FILE * outputs[MAX_WORKER_COUNT];
+
+    const int workerCount = fan_out(files.size, scan_files_by_worker, outputs);
+
+    if (workerCount < 0) {
+        fprintf(stderr, "failed to scan %s\n", installDir);
+        return 1;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    // the files are resolved in their sorted order, whichever worker parsed them.
+    ElfInfo * infos = (ElfInfo*)calloc(files.size + 1, sizeof(ElfInfo));
+    char *    found = (char*)calloc(files.size + 1, 1);
+
+    if (infos == NULL || found == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    char * line = NULL;
+
+    size_t lineCapacity = 0;
+
+    for (int i = 0; i < workerCount; i++) {
+        rewind(outputs[i]);
+
+        ssize_t n;
+
+        while ((n = getline(&line, &lineCapacity, outputs[i])) > 0) {
+            if (line[n - 1] == '\n') line[n - 1] = '\0';
+
+            char * p = strchr(line, '\t');
+
+            if (p == NULL) continue;
+
+            *p++ = '\0';
+
+            size_t index = (size_t)strtoull(line, NULL, 10);
+
+            if (index >= files.size) continue;
+
+            found[index] = 1;
+
+            infos[index].hasRunpath = p[0] == 'r';
+
+            for (char * q = strchr(p, '\t'); q != NULL; ) {
+                char * name = q + 1;
+
+                q = strchr(name, '\t');
+
+                if (q != NULL) *q = '\0';
+
+                strings_push(&infos[index].needed, strdup2(name));
+            }
+        }
+
+        fclose(outputs[i]);
+    }
+
+    free(line);
+
+    for (size_t i = 0; i < files.size; i++) {
+        if (found[i] && infos[i].hasRunpath) {
+            printf("remove-rpath\t%s\n", files.items[i]);
+        }
+    }
+
+    for (size_t i = 0; i < files.size; i++) {
+        if (found[i]) {
+            resolve(files.items[i], &infos[i], 1);
+        }
+    }
+
+    for (size_t i = 0; i < s1.size; i++) {
+        printf("S1\t%s\n", s1.items[i]);
+    }
+
+    for (size_t i = 0; i < s2.size; i++) {
+        printf("S2\t%s\n", s2.items[i]);
+    }
+
+    for (size_t i = 0; i < neededLibs.size; i++) {
+        printf("needed\t%s\n", neededLibs.items[i]);
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static const char * cwd;
+
+// the components of the absolute, lexically normalized form of <PATH>. the returned buffer holds them.
+static char * split_path(const char * path, Strings * components) {
+    char * buf = path[0] == '/' ? strdup2(path) : strdup3(cwd, "/", path);
+
+    for (char * p = buf; p != NULL; ) {
+        char * name = p;
+
+        p = strchr(p, '/');
+
+        if (p != NULL) *p++ = '\0';
+
+        if (name[0] == '\0' || strcmp(name, ".") == 0) continue;
+
+        if (strcmp(name, "..") == 0) {
+            if (components->size > 0) components->size--;
+        } else {
+            strings_push(components, name);
+        }
+    }
+
+    return buf;
+}
+
+// the DT_RUNPATH entry of <FILE> for finding the libraries in <DIR>, both are relative to the current directory or absolute.
+// the same as $ORIGIN/$(realpath -m --relative-to="${FILE%/*}" "$DIR") but neither symlinks are followed nor processes are forked.
+static char * origin_path_of(const char * file, const char * dir) {
+    Strings from = {0};
+    Strings to   = {0};
+
+    char * buf1 = split_path(file, &from);
+    char * buf2 = split_path(dir,  &to);
+
+    // the directory of <FILE>
+    if (from.size > 0) from.size--;
+
+    size_t common = 0;
+
+    while (common < from.size && common < to.size && strcmp(from.items[common], to.items[common]) == 0) {
+        common++;
+    }
+
+    size_t capacity = 8;
+
+    for (size_t i = common; i < from.size; i++) capacity += 3;
+    for (size_t i = common; i < to.size;   i++) capacity += strlen(to.items[i]) + 1;
+
+    char * s = (char*)malloc(capacity);
+
+    if (s == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    strcpy(s, "$ORIGIN");
+
+    for (size_t i = common; i < from.size; i++) strcat(s, "/..");
+
+    for (size_t i = common; i < to.size; i++) {
+        strcat(s, "/");
+        strcat(s, to.items[i]);
+    }
+
+    free(buf1);
+    free(buf2);
+    free(from.items);
+    free(to.items);
+
+    return s;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// returns 1 if any string other than the DT_RPATH/DT_RUNPATH one refers to [FROM, TO) of the dynamic string table.
+// the linkers merge a string into the tail of another, so a part of the runpath string might be a symbol name or a version name as well.
+// the section headers are needed for checking the symbols, it is considered shared without them.
+static int is_runpath_string_shared(const unsigned char * p, size_t size, const ElfInfo * info, uint64_t from, uint64_t to) {
+    const int is64 = info->is64;
+    const int be   = info->bigEndian;
+
+    const uint64_t dynEntSize = is64 ? 16 : 8;
+
+    for (uint64_t i = 0; i < info->dynCount; i++) {
+        if (i == info->runpathIndex) continue;
+
+        const unsigned char * d = p + info->dynOffset + i * dynEntSize;
+
+        const uint64_t tag = is64 ? read_uint(d, 8, be) : read_uint(d, 4, be);
+        const uint64_t val = is64 ? read_uint(d + 8, 8, be) : read_uint(d + 4, 4, be);
+
+        switch (tag) {
+            case ELF_DT_NEEDED:
+            case ELF_DT_SONAME:
+            case ELF_DT_RPATH:
+            case ELF_DT_RUNPATH:
+            case ELF_DT_CONFIG:
+            case ELF_DT_DEPAUDIT:
+            case ELF_DT_AUDIT:
+            case ELF_DT_AUXILIARY:
+            case ELF_DT_FILTER:
+                if (val >= from && val < to) return 1;
+        }
+    }
+
+    const uint64_t shoff     = is64 ? read_uint(p + 40, 8, be) : read_uint(p + 32, 4, be);
+    const uint64_t shentsize = is64 ? read_uint(p + 58, 2, be) : read_uint(p + 46, 2, be);
+    const uint64_t shnum     = is64 ? read_uint(p + 60, 2, be) : read_uint(p + 48, 2, be);
+
+    if (shoff == 0 || shnum == 0 || shentsize < (uint64_t)(is64 ? 64 : 40) || shoff > size || shnum > (size - shoff) / shentsize) {
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < shnum; i++) {
+        const unsigned char * sh = p + shoff + i * shentsize;
+
+        const uint64_t type   = read_uint(sh + 4, 4, be);
+        const uint64_t offset = is64 ? read_uint(sh + 24, 8, be) : read_uint(sh + 16, 4, be);
+        const uint64_t shsize = is64 ? read_uint(sh + 32, 8, be) : read_uint(sh + 20, 4, be);
+
+        if (type != ELF_SHT_DYNSYM && type != ELF_SHT_VERDEF && type != ELF_SHT_VERNEED) continue;
+
+        if (offset > size || shsize > size - offset) return 1;
+
+        const unsigned char * sec = p + offset;
+
+        if (type == ELF_SHT_DYNSYM) {
+            const uint64_t symEntSize = is64 ? 24 : 16;
+
+            for (uint64_t j = 0; j + symEntSize <= shsize; j += symEntSize) {
+                const uint64_t name = read_uint(sec + j, 4, be);
+
+                if (name >= from && name < to) return 1;
+            }
+        } else if (type == ELF_SHT_VERDEF) {
+            // Elf_Verdef: vd_aux at 12, vd_next at 16, vd_cnt at 6. Elf_Verdaux: vda_name at 0, vda_next at 4
+            for (uint64_t vd = 0; vd + 20 <= shsize; ) {
+                uint64_t vda = vd + read_uint(sec + vd + 12, 4, be);
+
+                for (uint64_t k = read_uint(sec + vd + 6, 2, be); k > 0 && vda + 8 <= shsize; k--) {
+                    const uint64_t name = read_uint(sec + vda, 4, be);
+
+                    if (name >= from && name < to) return 1;
+
+                    const uint64_t next = read_uint(sec + vda + 4, 4, be);
+
+                    if (next == 0) break;
+
+                    vda += next;
+                }
+
+                const uint64_t next = read_uint(sec + vd + 16, 4, be);
+
+                if (next == 0) break;
+
+                vd += next;
+            }
+        } else {
+            // Elf_Verneed: vn_cnt at 2, vn_file at 4, vn_aux at 8, vn_next at 12. Elf_Vernaux: vna_name at 8, vna_next at 12
+            for (uint64_t vn = 0; vn + 16 <= shsize; ) {
+                const uint64_t file = read_uint(sec + vn + 4, 4, be);
+
+                if (file >= from && file < to) return 1;
+
+                uint64_t vna = vn + read_uint(sec + vn + 8, 4, be);
+
+                for (uint64_t k = read_uint(sec + vn + 2, 2, be); k > 0 && vna + 16 <= shsize; k--) {
+                    const uint64_t name = read_uint(sec + vna + 8, 4, be);
+
+                    if (name >= from && name < to) return 1;
+
+                    const uint64_t next = read_uint(sec + vna + 12, 4, be);
+
+                    if (next == 0) break;
+
+                    vna += next;
+                }
+
+                const uint64_t next = read_uint(sec + vn + 12, 4, be);
+
+                if (next == 0) break;
+
+                vn += next;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// returns 1 if <ENTRY> is one of the colon separated entries of <RUNPATH>
+static int runpath_contains(const char * runpath, const char * entry) {
+    const size_t n = strlen(entry);
+
+    for (const char * p = runpath; p != NULL; ) {
+        const char * q = strchr(p, ':');
+
+        const size_t m = q == NULL ? strlen(p) : (size_t)(q - p);
+
+        if (m == n && strncmp(p, entry, n) == 0) {
+            return 1;
+        }
+
+        p = q == NULL ? NULL : q + 1;
+    }
+
+    return 0;
+}
+
+static int run_patchelf(const char * path, const char * runpath) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        if (runpath[0] == '\0') {
+            execlp("patchelf", "patchelf", "--remove-rpath", path, (char*)NULL);
+        } else {
+            execlp("patchelf", "patchelf", "--set-rpath", runpath, path, (char*)NULL);
+        }
+
+        perror("patchelf");
+        _exit(127);
+    }
+
+    int status;
+
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            return -1;
+        }
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+typedef enum {
+    EDIT_RESULT_ERROR,
+    EDIT_RESULT_UNCHANGED,
+    EDIT_RESULT_IN_PLACE,
+    EDIT_RESULT_REMOVED,
+    EDIT_RESULT_PATCHELF
+} EditResult;
+
+static const char * const editResultNames[] = { "error", "unchanged", "in-place", "removed", "patchelf" };
+
+// set the DT_RUNPATH of the mapped file to <RUNPATH>, an empty <RUNPATH> removes the DT_RPATH and DT_RUNPATH entries.
+// returns EDIT_RESULT_PATCHELF if it can not be done without growing the file.
+static EditResult set_runpath_in_place(unsigned char * p, size_t size, const ElfInfo * info, const char * runpath, const char * oldRunpath) {
+    const int is64 = info->is64;
+    const int be   = info->bigEndian;
+
+    const uint64_t dynEntSize = is64 ? 16 : 8;
+    const int      fieldSize  = is64 ? 8 : 4;
+
+    if (runpath[0] == '\0') {
+        if (info->runpathCount == 0) {
+            return EDIT_RESULT_UNCHANGED;
+        }
+
+        // the same as what patchelf --remove-rpath does, the later entries are moved down, the freed ones become DT_NULL.
+        uint64_t n = 0;
+
+        for (uint64_t i = 0; i < info->dynCount; i++) {
+            unsigned char * d = p + info->dynOffset + i * dynEntSize;
+
+            const uint64_t tag = read_uint(d, fieldSize, be);
+
+            if (tag == ELF_DT_RPATH || tag == ELF_DT_RUNPATH) continue;
+
+            if (n != i) {
+                memmove(p + info->dynOffset + n * dynEntSize, d, dynEntSize);
+            }
+
+            n++;
+        }
+
+        memset(p + info->dynOffset + n * dynEntSize, 0, (info->dynCount - n) * dynEntSize);
+
+        return EDIT_RESULT_REMOVED;
+    }
+
+    if (info->runpathCount != 1 || oldRunpath == NULL) {
+        return EDIT_RESULT_PATCHELF;
+    }
+
+    unsigned char * d = p + info->dynOffset + info->runpathIndex * dynEntSize;
+
+    const uint64_t tag = read_uint(d, fieldSize, be);
+    const uint64_t val = read_uint(d + fieldSize, fieldSize, be);
+
+    if (strcmp(runpath, oldRunpath) == 0) {
+        if (tag == ELF_DT_RUNPATH) {
+            return EDIT_RESULT_UNCHANGED;
+        }
+
+        write_uint(d, fieldSize, be, ELF_DT_RUNPATH);
+
+        return EDIT_RESULT_IN_PLACE;
+    }
+
+    const size_t oldLength = strlen(oldRunpath);
+    const size_t newLength = strlen(runpath);
+
+    if (newLength > oldLength || is_runpath_string_shared(p, size, info, val, val + oldLength)) {
+        return EDIT_RESULT_PATCHELF;
+    }
+
+    char * s = (char *)p + info->strtabOffset + val;
+
+    memcpy(s, runpath, newLength);
+    memset(s + newLength, 0, oldLength - newLength);
+
+    write_uint(d, fieldSize, be, ELF_DT_RUNPATH);
+
+    return EDIT_RESULT_IN_PLACE;
+}
+
+// <ENTRIES> are the DT_RUNPATH entries to be appended, an empty one clears the entries before it.
+static EditResult set_runpath(const char * path, const Strings * entries, char ** runpath) {
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return EDIT_RESULT_ERROR;
+    }
+
+    // some packages install their libraries read-only.
+    const int readOnly = (st.st_mode & S_IWUSR) == 0;
+
+    if (readOnly && chmod(path, st.st_mode | S_IWUSR) != 0) {
+        perror(path);
+        return EDIT_RESULT_ERROR;
+    }
+
+    EditResult result = EDIT_RESULT_ERROR;
+
+    unsigned char * p = MAP_FAILED;
+
+    int fd = open(path, O_RDWR);
+
+    if (fd == -1) {
+        perror(path);
+        goto finally;
+    }
+
+    p = (unsigned char *)mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        perror(path);
+        goto finally;
+    }
+
+    ElfInfo info = {0};
+
+    if (parse_elf(p, (size_t)st.st_size, &info) != 0) {
+        fprintf(stderr, "%s: not a dynamically linked ELF file.\n", path);
+        goto finally;
+    }
+
+    for (size_t i = 0; i < info.needed.size; i++) {
+        free(info.needed.items[i]);
+    }
+
+    free(info.needed.items);
+
+    const char * oldRunpath = NULL;
+
+    // the dynamic loader ignores DT_RPATH if DT_RUNPATH is present, the last one of them is the one in effect mostly.
+    if (info.runpathCount > 0 && info.strtabOffset != UINT64_MAX) {
+        const unsigned char * d = p + info.dynOffset + info.runpathIndex * (info.is64 ? 16 : 8);
+
+        const uint64_t val = info.is64 ? read_uint(d + 8, 8, info.bigEndian) : read_uint(d + 4, 4, info.bigEndian);
+
+        if (val < info.strtabSize && memchr(p + info.strtabOffset + val, '\0', info.strtabSize - val) != NULL) {
+            oldRunpath = (const char *)p + info.strtabOffset + val;
+        }
+    }
+
+    // the existing entries are kept as patchelf --add-rpath does, unless cleared.
+    size_t capacity = oldRunpath == NULL ? 1 : strlen(oldRunpath) + 1;
+
+    for (size_t i = 0; i < entries->size; i++) {
+        capacity += strlen(entries->items[i]) + 1;
+    }
+
+    char * s = (char*)calloc(capacity, 1);
+
+    if (s == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    if (oldRunpath != NULL) {
+        strcpy(s, oldRunpath);
+    }
+
+    for (size_t i = 0; i < entries->size; i++) {
+        const char * entry = entries->items[i];
+
+        if (entry[0] == '\0') {
+            s[0] = '\0';
+            continue;
+        }
+
+        if (s[0] != '\0' && runpath_contains(s, entry)) continue;
+
+        if (s[0] != '\0') strcat(s, ":");
+
+        strcat(s, entry);
+    }
+
+    *runpath = s;
+
+    result = set_runpath_in_place(p, (size_t)st.st_size, &info, s, info.runpathCount == 1 ? oldRunpath : NULL);
+
+    munmap(p, (size_t)st.st_size);
+
+    p = MAP_FAILED;
+
+    // the file is rewritten once, whatever the number of the entries is.
+    if (result == EDIT_RESULT_PATCHELF && run_patchelf(path, s) != 0) {
+        fprintf(stderr, "%s: patchelf failed.\n", path);
+        result = EDIT_RESULT_ERROR;
+    }
+
+finally:
+    if (p != MAP_FAILED) {
+        munmap(p, (size_t)st.st_size);
+    }
+
+    if (readOnly) {
+        chmod(path, st.st_mode);
+    }
+
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char * file;
+    char * entry;   // an empty one clears the entries before it
+    size_t order;
+} Edit;
+
+static int compare_edit(const void * a, const void * b) {
+    const Edit * x = (const Edit *)a;
+    const Edit * y = (const Edit *)b;
+
+    int r = strcmp(x->file, y->file);
+
+    if (r != 0) return r;
+
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static Edit * edits;
+static size_t editCount;
+
+// the edits of the i-th file are edits[editGroups[i]] ... edits[editGroups[i + 1] - 1]
+static size_t * editGroups;
+static size_t   editGroupCount;
+
+// a worker writes one line per file it edited: <GROUP-INDEX>\t<RESULT>\t<RUNPATH>
+static void set_runpath_by_worker(int worker, int workerCount, FILE * output) {
+    for (size_t i = (size_t)worker; i < editGroupCount; i += (size_t)workerCount) {
+        Strings entries = {0};
+
+        for (size_t j = editGroups[i]; j < editGroups[i + 1]; j++) {
+            strings_push(&entries, edits[j].entry);
+        }
+
+        char * runpath = NULL;
+
+        EditResult result = set_runpath(edits[editGroups[i]].file, &entries, &runpath);
+
+        fprintf(output, "%zu\t%s\t%s\n", i, editResultNames[result], runpath == NULL ? "" : runpath);
+
+        free(runpath);
+        free(entries.items);
+    }
+}
+
+static int set_runpaths(void) {
+    char * buf = getcwd(NULL, 0);
+
+    if (buf == NULL) {
+        perror("getcwd");
+        return 1;
+    }
+
+    cwd = buf;
+
+    char * line = NULL;
+
+    size_t lineCapacity = 0;
+    size_t editCapacity = 0;
+
+    ssize_t n;
+
+    while ((n = getline(&line, &lineCapacity, stdin)) > 0) {
+        if (line[n - 1] == '\n') line[--n] = '\0';
+
+        if (n == 0) continue;
+
+        char * p = strchr(line, '\t');
+
+        if (p == NULL || p == line || p[1] == '\0') {
+            fprintf(stderr, "invalid edit: %s\n", line);
+            return 1;
+        }
+
+        *p++ = '\0';
+
+        if (editCount == editCapacity) {
+            editCapacity = editCapacity == 0 ? 64 : editCapacity << 1;
+
+            edits = (Edit*)realloc(edits, editCapacity * sizeof(Edit));
+
+            if (edits == NULL) {
+                perror(NULL);
+                return 1;
+            }
+        }
+
+        edits[editCount].file  = strdup2(line);
+        edits[editCount].entry = strcmp(p, "-") == 0 ? strdup2("") : origin_path_of(line, p);
+        edits[editCount].order = editCount;
+
+        editCount++;
+    }
+
+    free(line);
+
+    if (ferror(stdin)) {
+        perror("stdin");
+        return 1;
+    }
+
+    if (editCount == 0) {
+        return 0;
+    }
+
+    // the edits of a file are applied together, in the given order.
+    qsort(edits, editCount, sizeof(Edit), compare_edit);
+
+    editGroups = (size_t*)malloc((editCount + 1) * sizeof(size_t));
+
+    if (editGroups == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (size_t i = 0; i < editCount; i++) {
+        if (i == 0 || strcmp(edits[i].file, edits[i - 1].file) != 0) {
+            editGroups[editGroupCount++] = i;
+        }
+    }
+
+    editGroups[editGroupCount] = editCount;
+
+    /////////////////////////////////////////////////////////////////
+
+    FILE * outputs[MAX_WORKER_COUNT];
+
+    const int workerCount = fan_out(editGroupCount, set_runpath_by_worker, outputs);
+
+    if (workerCount < 0) {
+        fprintf(stderr, "failed to set runpath.\n");
+        return 1;
+    }
+
+    char ** results = (char**)calloc(editGroupCount, sizeof(char*));
+
+    if (results == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    line = NULL;
+    lineCapacity = 0;
+
+    for (int i = 0; i < workerCount; i++) {
+        rewind(outputs[i]);
+
+        while ((n = getline(&line, &lineCapacity, outputs[i])) > 0) {
+            char * p = strchr(line, '\t');
+
+            if (p == NULL) continue;
+
+            *p++ = '\0';
+
+            size_t index = (size_t)strtoull(line, NULL, 10);
+
+            if (index < editGroupCount) {
+                results[index] = strdup2(p);
+            }
+        }
+
+        fclose(outputs[i]);
+    }
+
+    free(line);
+
+    int ret = 0;
+
+    for (size_t i = 0; i < editGroupCount; i++) {
+        const char * file = edits[editGroups[i]].file;
+
+        if (results[i] == NULL) {
+            fprintf(stderr, "%s: not edited.\n", file);
+            ret = 1;
+            continue;
+        }
+
+        if (starts_with(results[i], "error\t")) {
+            ret = 1;
+        }
+
+        printf("%s\t%s", file, results[i]);
+    }
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <scan|set-runpath> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    int ret;
+
+    if (strcmp(argv[1], "scan") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s scan <INSTALL-DIR> [DEPENDENCY-INSTALL-DIR]...\n", argv[0]);
+            return 1;
+        }
+
+        ret = scan(argv[2], argv + 3, argc - 3);
+    } else if (strcmp(argv[1], "set-runpath") == 0) {
+        ret = set_runpaths();
+    } else {
+        fprintf(stderr, "unrecognized action: %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
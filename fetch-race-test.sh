@@ -0,0 +1,93 @@
+#!/bin/sh
+
+# the mirrors of a download are ranked and raced against local HTTP stand-ins: a healthy one, a slow one which never answers and a dead one.
+# the functions under test are taken from ppkg as they are.
+
+set -ex
+
+PPKG="$(pwd)/ppkg"
+
+TEST_DIR="$(mktemp -d)"
+
+SERVER_PIDS=
+
+trap '[ -n "$SERVER_PIDS" ] && kill $SERVER_PIDS 2>/dev/null; rm -rf "$TEST_DIR"' EXIT
+
+for f in run __host_of_the_given_url __rank_the_given_urls __record_the_health_of_the_given_host __race_the_given_urls __fetch_with_curl
+do
+    eval "$(sed -n "/^ *$f() {/,/^}/p" "$PPKG")"
+done
+
+cd "$TEST_DIR"
+
+mkdir www
+
+printf 'hello\n' > www/hello.txt
+
+# start_server <healthy|slow> <PORT-FILE>
+start_server() {
+    python3 - "$1" "$2" <<'EOF' &
+import http.server, socket, sys, os
+
+if sys.argv[1] == 'healthy':
+    server = http.server.HTTPServer(('127.0.0.1', 0), http.server.SimpleHTTPRequestHandler)
+else:
+    server = socket.socket()
+    server.bind(('127.0.0.1', 0))
+    server.listen(16)
+
+port = server.server_address[1] if sys.argv[1] == 'healthy' else server.getsockname()[1]
+
+with open(sys.argv[2] + '.tmp', 'w') as f:
+    f.write('%d\n' % port)
+
+os.rename(sys.argv[2] + '.tmp', sys.argv[2])
+
+if sys.argv[1] == 'healthy':
+    os.chdir('www')
+    server.serve_forever()
+else:
+    connections = []
+    while True:
+        connections.append(server.accept())
+EOF
+    SERVER_PIDS="$SERVER_PIDS $!"
+
+    until [ -f "$2" ] ; do sleep 0.1 ; done
+}
+
+start_server healthy healthy.port
+start_server slow    slow.port
+
+# a port which was bound once then closed, nothing listens on it.
+DEAD_PORT="$(python3 -c 'import socket; s = socket.socket(); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1])')"
+
+HEALTHY_URL="http://127.0.0.1:$(cat healthy.port)/hello.txt"
+SLOW_URL="http://127.0.0.1:$(cat slow.port)/hello.txt"
+DEAD_URL="http://127.0.0.1:$DEAD_PORT/hello.txt"
+
+PPKG_HOME="$TEST_DIR/ppkg-home"
+
+mkdir "$PPKG_HOME"
+
+# the healthy one wins the race, its latency is recorded.
+[ "$(__race_the_given_urls "$SLOW_URL" "$DEAD_URL" "$HEALTHY_URL")" = "$HEALTHY_URL" ]
+
+cat "$PPKG_HOME/hosts.db"
+
+[ "$(awk -F'\t' -v h="127.0.0.1:$(cat healthy.port)" '$1 == h { print $2, $4 }' "$PPKG_HOME/hosts.db")" = '1 ok' ]
+
+# the slow one was cancelled, so it is not recorded.
+[ -z "$(awk -F'\t' -v h="127.0.0.1:$(cat slow.port)" '$1 == h' "$PPKG_HOME/hosts.db")" ]
+
+# the hosts which worked come first, then the unknown ones in the given order, then the failed ones.
+__record_the_health_of_the_given_host "127.0.0.1:$DEAD_PORT" failed
+
+[ "$(__rank_the_given_urls "$DEAD_URL" "$SLOW_URL" "$HEALTHY_URL" | tr '\n' ' ')" = "$HEALTHY_URL $SLOW_URL $DEAD_URL " ]
+
+# the download itself goes to the healthy one, its throughput is recorded.
+__fetch_with_curl hello.txt "$DEAD_URL" "$HEALTHY_URL"
+
+[ "$(cat hello.txt)" = hello ]
+
+[ "$(awk -F'\t' -v h="127.0.0.1:$(cat healthy.port)" '$1 == h { print $2, $4 }' "$PPKG_HOME/hosts.db")" = '2 ok' ]
@@ -0,0 +1,90 @@
+#!/bin/sh
+
+# the values printed by formula-index list -v are compared with the values read by yq from the formula files,
+# its --yaml output is read back by yq and its --json and --ndjson output by jq, so the quoting of both is checked.
+
+set -ex
+
+TEST_DIR="$(mktemp -d)"
+
+trap 'rm -rf "$TEST_DIR"' EXIT
+
+cc -std=c99 -Os -o "$TEST_DIR/formula-index" formula-index.c
+
+cd "$TEST_DIR"
+
+mkdir -p repos/test/formula
+
+printf 'url: https://example.com/test.git\n' > repos/test/.ppkg-formula-repo.yml
+
+cat > repos/test/formula/foo.yml <<'EOF'
+summary: a "quoted" summary with a \ backslash, a colon:and a # comment
+web-url: https://example.com/foo
+src-url: https://example.com/foo-1.2.3.tar.gz
+src-sha: 0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef
+license: MIT
+dep-pkg: bar
+install: |
+    configure --enable-shared
+    make install
+EOF
+
+cat > repos/test/formula/bar.yml <<'EOF'
+summary: '- a summary which looks like a list: or a mapping'
+git-url: https://example.com/bar.git
+version: 2.0.1
+src-url: https://example.com/bar-2.0.1.tar.gz
+src-sha: fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210
+ldflags: "-L/opt/lib\t-lbar"
+bsystem: make
+EOF
+
+export PPKG_FORMULA_REPO_ROOT="$TEST_DIR/repos"
+export TARGET_PLATFORM_NAME=linux
+
+unset PPKG_FORMULA_SEARCH_DIRS
+unset PPKG_PACKAGE_INSTALLED_ROOT
+
+[ "$(./formula-index list)" = "$(printf 'bar\nfoo\n')" ]
+
+./formula-index list -v --yaml   > list.yaml
+./formula-index list -v --json   > list.json
+./formula-index list -v --ndjson > list.ndjson
+
+cat list.yaml
+
+# check_json <PKGNAME> <KEY> <FORMULA-KEY>
+check_json() {
+    EXPECTED="$(yq -r ".\"$3\" // \"\"" "repos/test/formula/$1.yml")"
+
+    [ "$(jq -r ".[] | select(.pkgname == \"$1\") | .\"$2\" // \"\"" list.json)" = "$EXPECTED" ]
+    [ "$(jq -r "select(.pkgname == \"$1\") | .\"$2\" // \"\"" list.ndjson)" = "$EXPECTED" ]
+}
+
+# check <PKGNAME> <KEY> <FORMULA-KEY>
+check() {
+    check_json "$@"
+
+    [ "$(yq -r "select(.pkgname == \"$1\") | .\"$2\" // \"\"" list.yaml)" = "$EXPECTED" ]
+}
+
+for PKGNAME in foo bar
+do
+    for KEY in summary license git-url src-url src-sha dep-pkg ldflags
+    do
+        check "$PKGNAME" "$KEY" "$KEY"
+    done
+done
+
+# install is not printed as YAML.
+check_json foo install install
+
+check foo web-url web-url
+check bar version version
+check bar bsystem bsystem
+
+# web-url falls back to git-url.
+check bar web-url git-url
+
+# the version is taken from src-url if it is not given.
+[ "$(jq -r '.[] | select(.pkgname == "foo") | .version' list.json)" = 1.2.3 ]
@@ -0,0 +1,1493 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <regex.h>
+
+#include "formula.h"
+
+// formula-index build  <FORMULA-REPO-PATH>...
+// formula-index path   <PACKAGE-NAME>
+// formula-index exists <PACKAGE-NAME>
+// formula-index list   [-v [--yaml | --json | --ndjson]]
+// formula-index search [--regex | --token] [-v | --yaml | --json] <PATTERN>...
+// formula-index outdated [--json] [--target=<TARGET-PLATFORM-SPEC>] [PACKAGE-SPEC]... < installed.db
+//
+// build  : write <FORMULA-REPO-PATH>/.ppkg-formula-repo.idx
+// path   : print the formula file path of the given package, print nothing if it is not available.
+// exists : exit with 0 if the given package is available, otherwise exit with 1.
+// list   : print the names of all available packages for $TARGET_PLATFORM_NAME, sorted and deduplicated.
+//          -v : print the information of every package instead, as a multi-document YAML stream, a JSON array or newline-delimited JSON.
+// search : print the available packages whose pkgname, summary, license, web-url or git-url matches, the most relevant first.
+//          --regex : <PATTERN> is a POSIX basic regular expression, this is the default.
+//          --token : every <PATTERN> is split into lowercase alphanumeric tokens, a package matches if every token is a prefix of one of its words.
+// outdated : read the installed packages database from stdin, print the specs of the installed packages whose available version is greater than the installed version in the order of sort -V.
+//            --json : print a JSON array of {"spec", "pkgname", "old-version", "new-version"} instead.
+//            --target : only the packages installed for the given target are checked.
+//            if PACKAGE-SPEC is given, only the given packages are checked.
+//
+// path, exists, list, search and outdated use the index of every formula repository if it is fresh, otherwise fall back to scan the formula directories.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char * name;
+    char * platform;
+    char * v[FORMULA_INDEX_DOC_FIELDS]; // v[0] is NULL if the formula failed to load
+    int     versionFromDate;
+    int64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint8_t sha256[32];
+} Entry;
+
+typedef struct {
+    Entry * items;
+    size_t  size;
+    size_t  capacity;
+} Entries;
+
+typedef struct {
+    char ** items;
+    size_t  size;
+    size_t  capacity;
+} Strings;
+
+static void * grow(void * items, size_t * capacity, size_t itemSize) {
+    *capacity = *capacity == 0 ? 256 : *capacity << 1;
+
+    void * p = realloc(items, *capacity * itemSize);
+
+    if (p == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    return p;
+}
+
+static void strings_add(Strings * list, char * s) {
+    if (list->size == list->capacity) {
+        list->items = (char**)grow(list->items, &list->capacity, sizeof(char*));
+    }
+
+    list->items[list->size++] = s;
+}
+
+static int compare_entry(const void * a, const void * b) {
+    const Entry * x = (const Entry *)a;
+    const Entry * y = (const Entry *)b;
+    return formula_index_compare(x->name, x->platform, y->name, y->platform);
+}
+
+static int hex_to_bytes(const char hex[65], uint8_t bytes[32]) {
+    for (int i = 0; i < 32; i++) {
+        unsigned int x;
+
+        if (sscanf(hex + i * 2, "%2x", &x) != 1) {
+            return -1;
+        }
+
+        bytes[i] = (uint8_t)x;
+    }
+
+    return 0;
+}
+
+// list the *.yml regular files in the given directory, the .yml suffix is removed.
+static int list_formula_names(const char * dirPath, Strings * names) {
+    DIR * dir = opendir(dirPath);
+
+    if (dir == NULL) {
+        return -1;
+    }
+
+    for (;;) {
+        struct dirent * entry = readdir(dir);
+
+        if (entry == NULL) break;
+
+        if (entry->d_name[0] == '.') continue;
+
+        size_t n = strlen(entry->d_name);
+
+        if (n <= 4 || strcmp(entry->d_name + n - 4, ".yml") != 0) continue;
+
+        char * filepath = strdup3(dirPath, "/", entry->d_name);
+
+        int ok = is_regular_file(filepath);
+
+        free(filepath);
+
+        if (!ok) continue;
+
+        char * name = strdup2(entry->d_name);
+
+        name[n - 4] = '\0';
+
+        strings_add(names, name);
+    }
+
+    closedir(dir);
+
+    return 0;
+}
+
+// load the formula then keep the derived values of the formula mappings.
+// returns 0 on success, otherwise the formula is malformed and it will be reported when it is loaded by formula-loader.
+static int load_doc(char * v[FORMULA_INDEX_DOC_FIELDS], int * versionFromDate, const char * name, const char * filepath) {
+    Formula formula;
+
+    formulaQuiet = 1;
+
+    int ret = load_formula(&formula, name, filepath);
+
+    formulaQuiet = 0;
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    Mappings mappings = {0};
+
+    parse_yaml(filepath, &mappings);
+
+    const char * srcUrl = lookup(&mappings, "src-url");
+
+    // load_formula derives the version from the date only if it is neither given nor derivable from src-url
+    *versionFromDate = lookup(&mappings, "version")[0] == '\0' && formula.v[VERSION][0] != '\0' && (srcUrl[0] == '\0' || starts_with(srcUrl, "dir://") || starts_with(srcUrl, "file://"));
+
+    free_mappings(&mappings);
+
+    for (int i = 0; i < FORMULA_INDEX_DOC_FIELDS; i++) {
+        v[i] = formula.v[i];
+        formula.v[i] = NULL;
+    }
+
+    free_formula(&formula);
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// split the given string into lowercase alphanumeric tokens, the callback is called for every token.
+static void tokenize(const char * s, void (*callback)(const char * token, void * arg), void * arg) {
+    char token[256];
+
+    size_t n = 0;
+
+    for (;; s++) {
+        unsigned char c = (unsigned char)*s;
+
+        if (isalnum(c)) {
+            if (n < sizeof(token) - 1) {
+                token[n++] = (char)tolower(c);
+            }
+        } else {
+            if (n > 0) {
+                token[n] = '\0';
+                callback(token, arg);
+                n = 0;
+            }
+
+            if (c == '\0') break;
+        }
+    }
+}
+
+// the first column is the formula field, -1 for the package name
+static const int SEARCH_FIELDS[][2] = {
+    { -1,      SEARCH_FIELD_PKGNAME },
+    { SUMMARY, SEARCH_FIELD_SUMMARY },
+    { LICENSE, SEARCH_FIELD_LICENSE },
+    { WEB_URL, SEARCH_FIELD_WEB_URL },
+    { GIT_URL, SEARCH_FIELD_GIT_URL },
+};
+
+#define SEARCH_FIELD_COUNT 5
+
+// a match in pkgname is worth more than a match in summary, and so on.
+static int weight_of_fields(uint32_t fields) {
+    if (fields & SEARCH_FIELD_PKGNAME) return 16;
+    if (fields & SEARCH_FIELD_SUMMARY) return 4;
+    if (fields & SEARCH_FIELD_LICENSE) return 2;
+    return 1;
+}
+
+typedef struct {
+    char   * term;
+    uint32_t entry;
+    uint32_t fields;
+} Occurrence;
+
+typedef struct {
+    Occurrence * items;
+    size_t       size;
+    size_t       capacity;
+
+    uint32_t entry;
+    uint32_t field;
+} Occurrences;
+
+static void occurrences_add(const char * token, void * arg) {
+    Occurrences * list = (Occurrences *)arg;
+
+    if (list->size == list->capacity) {
+        list->items = (Occurrence*)grow(list->items, &list->capacity, sizeof(Occurrence));
+    }
+
+    Occurrence * o = &list->items[list->size++];
+
+    o->term   = strdup2(token);
+    o->entry  = list->entry;
+    o->fields = list->field;
+}
+
+static int compare_occurrence(const void * a, const void * b) {
+    const Occurrence * x = (const Occurrence *)a;
+    const Occurrence * y = (const Occurrence *)b;
+
+    int r = strcmp(x->term, y->term);
+
+    if (r != 0) return r;
+
+    return x->entry < y->entry ? -1 : (x->entry > y->entry ? 1 : 0);
+}
+
+/////////////////////////////////////////////////////////////////
+
+static uint32_t pool_add(StringBuffer * pool, const char * s) {
+    if (s == NULL || s[0] == '\0') {
+        return 0;
+    }
+
+    uint32_t offset = (uint32_t)pool->len;
+    sb_append_n(pool, s, strlen(s) + 1);
+    return offset;
+}
+
+static int index_formula(Entries * entries, const char * formulaDir, const char * platform, const char * name) {
+    StringBuffer sb = {0};
+
+    sb_append(&sb, formulaDir);
+    sb_append(&sb, "/");
+
+    if (platform[0] != '\0') {
+        sb_append(&sb, platform);
+        sb_append(&sb, "/");
+    }
+
+    sb_append(&sb, name);
+    sb_append(&sb, ".yml");
+
+    char * filepath = sb_take(&sb);
+
+    struct stat st;
+
+    if (stat(filepath, &st) != 0) {
+        perror(filepath);
+        return 1;
+    }
+
+    char hex[65];
+
+    if (sha256_of_file(filepath, hex) != 0) {
+        perror(filepath);
+        return 1;
+    }
+
+    Entry e;
+
+    memset(&e, 0, sizeof(Entry));
+
+    e.name      = strdup2(name);
+    e.platform  = strdup2(platform);
+    e.size      = (int64_t)st.st_size;
+    e.mtimeSec  = ST_MTIME_SEC(st);
+    e.mtimeNsec = ST_MTIME_NSEC(st);
+
+    hex_to_bytes(hex, e.sha256);
+
+    if (load_doc(e.v, &e.versionFromDate, name, filepath) != 0) {
+        e.v[0] = NULL;
+    } else if (e.versionFromDate) {
+        // the version derived from the date it is indexed is not the one that would be derived when it is loaded.
+        e.v[VERSION][0] = '\0';
+    }
+
+    free(filepath);
+
+    if (entries->size == entries->capacity) {
+        entries->items = (Entry*)grow(entries->items, &entries->capacity, sizeof(Entry));
+    }
+
+    entries->items[entries->size++] = e;
+
+    return 0;
+}
+
+static int build(const char * repoPath) {
+    char * formulaDir = strdup3(repoPath, "/formula", "");
+
+    Strings dirNames = {0};
+
+    strings_add(&dirNames, strdup2(""));
+
+    DIR * dir = opendir(formulaDir);
+
+    if (dir != NULL) {
+        for (;;) {
+            struct dirent * entry = readdir(dir);
+
+            if (entry == NULL) break;
+
+            if (entry->d_name[0] == '.') continue;
+
+            char * p = strdup3(formulaDir, "/", entry->d_name);
+
+            if (is_directory(p)) {
+                strings_add(&dirNames, strdup2(entry->d_name));
+            }
+
+            free(p);
+        }
+
+        closedir(dir);
+    }
+
+    qsort(dirNames.items + 1, dirNames.size - 1, sizeof(char*), compare_string);
+
+    /////////////////////////////////////////////////////////////////
+
+    // record the mtime of the directories before scanning them, so that any change made while scanning makes this index stale.
+
+    FormulaIndexDir * dirs = (FormulaIndexDir*)calloc(dirNames.size, sizeof(FormulaIndexDir));
+
+    if (dirs == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    StringBuffer pool = {0};
+
+    sb_append_n(&pool, "", 1);
+
+    for (size_t i = 0; i < dirNames.size; i++) {
+        char * p = strdup3(formulaDir, dirNames.items[i][0] == '\0' ? "" : "/", dirNames.items[i]);
+
+        struct stat st;
+
+        if (stat(p, &st) == 0) {
+            dirs[i].mtimeSec  = ST_MTIME_SEC(st);
+            dirs[i].mtimeNsec = ST_MTIME_NSEC(st);
+        } else {
+            dirs[i].mtimeSec  = -1;
+            dirs[i].mtimeNsec = 0;
+        }
+
+        dirs[i].path = pool_add(&pool, dirNames.items[i]);
+
+        free(p);
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    Entries entries = {0};
+
+    for (size_t i = 0; i < dirNames.size; i++) {
+        char * p = strdup3(formulaDir, dirNames.items[i][0] == '\0' ? "" : "/", dirNames.items[i]);
+
+        Strings names = {0};
+
+        list_formula_names(p, &names);
+
+        free(p);
+
+        for (size_t j = 0; j < names.size; j++) {
+            if (index_formula(&entries, formulaDir, dirNames.items[i], names.items[j]) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    qsort(entries.items, entries.size, sizeof(Entry), compare_entry);
+
+    /////////////////////////////////////////////////////////////////
+
+    FormulaIndexEntry * records = (FormulaIndexEntry*)calloc(entries.size + 1, sizeof(FormulaIndexEntry));
+    FormulaIndexDoc   * docs    = (FormulaIndexDoc*)  calloc(entries.size + 1, sizeof(FormulaIndexDoc));
+
+    if (records == NULL || docs == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    uint32_t docCount = 0;
+
+    Occurrences occurrences = {0};
+
+    for (size_t i = 0; i < entries.size; i++) {
+        Entry * e = &entries.items[i];
+
+        records[i].name      = pool_add(&pool, e->name);
+        records[i].platform  = pool_add(&pool, e->platform);
+        records[i].size      = e->size;
+        records[i].mtimeSec  = e->mtimeSec;
+        records[i].mtimeNsec = e->mtimeNsec;
+
+        memcpy(records[i].sha256, e->sha256, 32);
+
+        occurrences.entry = (uint32_t)i;
+
+        if (e->v[0] == NULL) {
+            records[i].doc = FORMULA_INDEX_NO_DOC;
+
+            occurrences.field = SEARCH_FIELD_PKGNAME;
+            tokenize(e->name, occurrences_add, &occurrences);
+            continue;
+        }
+
+        records[i].doc = docCount;
+        records[i].flags = e->versionFromDate ? FORMULA_INDEX_VERSION_FROM_DATE : 0;
+
+        for (int j = 0; j < FORMULA_INDEX_DOC_FIELDS; j++) {
+            docs[docCount].v[j] = pool_add(&pool, e->v[j]);
+        }
+
+        docCount++;
+
+        for (int j = 0; j < SEARCH_FIELD_COUNT; j++) {
+            occurrences.field = (uint32_t)SEARCH_FIELDS[j][1];
+            tokenize(SEARCH_FIELDS[j][0] == -1 ? e->name : e->v[SEARCH_FIELDS[j][0]], occurrences_add, &occurrences);
+        }
+    }
+
+    // merge the occurrences of the same term in the same entry, then group them by term.
+
+    qsort(occurrences.items, occurrences.size, sizeof(Occurrence), compare_occurrence);
+
+    FormulaIndexTerm    * terms    = (FormulaIndexTerm*)   calloc(occurrences.size + 1, sizeof(FormulaIndexTerm));
+    FormulaIndexPosting * postings = (FormulaIndexPosting*)calloc(occurrences.size + 1, sizeof(FormulaIndexPosting));
+
+    if (terms == NULL || postings == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    uint32_t termCount = 0;
+    uint32_t postingCount = 0;
+
+    for (size_t i = 0; i < occurrences.size; i++) {
+        Occurrence * o = &occurrences.items[i];
+
+        if (termCount == 0 || strcmp(o->term, occurrences.items[i - 1].term) != 0) {
+            terms[termCount].term = pool_add(&pool, o->term);
+            terms[termCount].postingStart = postingCount;
+            termCount++;
+        } else if (o->entry == postings[postingCount - 1].entry) {
+            postings[postingCount - 1].fields |= o->fields;
+            continue;
+        }
+
+        postings[postingCount].entry  = o->entry;
+        postings[postingCount].fields = o->fields;
+        postingCount++;
+
+        terms[termCount - 1].postingCount++;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    FormulaIndexHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FORMULA_INDEX_MAGIC, 8);
+
+    header.endian         = FORMULA_INDEX_ENDIAN;
+    header.entryCount     = (uint32_t)entries.size;
+    header.dirCount       = (uint32_t)dirNames.size;
+    header.docCount       = docCount;
+    header.termCount      = termCount;
+    header.postingCount   = postingCount;
+    header.stringPoolSize = (uint32_t)pool.len;
+
+    char * indexFilePath = strdup3(repoPath, "/", FORMULA_INDEX_FILENAME);
+
+    char tmpSuffix[32];
+
+    snprintf(tmpSuffix, sizeof(tmpSuffix), ".%d.tmp", (int)getpid());
+
+    char * tmpFilePath = strdup3(indexFilePath, tmpSuffix, "");
+
+    FILE * file = fopen(tmpFilePath, "wb");
+
+    if (file == NULL) {
+        perror(tmpFilePath);
+        return 1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1
+          && fwrite(dirs,     sizeof(FormulaIndexDir),     dirNames.size, file) == dirNames.size
+          && fwrite(records,  sizeof(FormulaIndexEntry),   entries.size,  file) == entries.size
+          && fwrite(docs,     sizeof(FormulaIndexDoc),     docCount,      file) == docCount
+          && fwrite(terms,    sizeof(FormulaIndexTerm),    termCount,     file) == termCount
+          && fwrite(postings, sizeof(FormulaIndexPosting), postingCount,  file) == postingCount
+          && fwrite(pool.buf, 1, pool.len, file) == pool.len;
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        perror(tmpFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    if (rename(tmpFilePath, indexFilePath) != 0) {
+        perror(indexFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    fprintf(stderr, "%zu formulas indexed in %s\n", entries.size, indexFilePath);
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// a formula repository is either served by its index or by scanning its formula directories.
+typedef struct {
+    char *       path;
+    int          indexed;
+    FormulaIndex idx;
+} Repo;
+
+static Repo * repos;
+static size_t reposCount;
+
+static const char * targetPlatformName = "";
+
+static void open_formula_repositories(void) {
+    const char * formulaRepoRoot = getenv("PPKG_FORMULA_REPO_ROOT");
+
+    const char * p = getenv("TARGET_PLATFORM_NAME");
+
+    if (p != NULL) {
+        targetPlatformName = p;
+    }
+
+    if (formulaRepoRoot == NULL || !is_directory(formulaRepoRoot)) {
+        return;
+    }
+
+    list_formula_repositories(formulaRepoRoot);
+
+    repos = (Repo*)calloc(formulaRepoNamesCount + 1, sizeof(Repo));
+
+    if (repos == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < formulaRepoNamesCount; i++) {
+        Repo * repo = &repos[reposCount++];
+
+        repo->path = strdup3(formulaRepoRoot, "/", formulaRepoNames[i]);
+        repo->indexed = formula_index_open(&repo->idx, repo->path) == 0;
+    }
+}
+
+// the names of all available packages for $TARGET_PLATFORM_NAME, sorted and deduplicated.
+static void list_available_package_names(Strings * result) {
+    Strings names = {0};
+
+    for (size_t i = 0; i < reposCount; i++) {
+        Repo * repo = &repos[i];
+
+        if (repo->indexed) {
+            const FormulaIndex * idx = &repo->idx;
+
+            for (uint32_t j = 0; j < idx->header->entryCount; j++) {
+                const char * platform = idx->strings + idx->entries[j].platform;
+
+                if (platform[0] == '\0' || strcmp(platform, targetPlatformName) == 0) {
+                    strings_add(&names, (char*)(idx->strings + idx->entries[j].name));
+                }
+            }
+        } else {
+            if (targetPlatformName[0] != '\0') {
+                char * p = strdup3(repo->path, "/formula/", targetPlatformName);
+                list_formula_names(p, &names);
+                free(p);
+            }
+
+            char * p = strdup3(repo->path, "/formula", "");
+            list_formula_names(p, &names);
+            free(p);
+        }
+    }
+
+    qsort(names.items, names.size, sizeof(char*), compare_string);
+
+    for (size_t i = 0; i < names.size; i++) {
+        if (i > 0 && strcmp(names.items[i], names.items[i - 1]) == 0) {
+            continue;
+        }
+
+        strings_add(result, names.items[i]);
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    const char * name;
+    const char * v[FORMULA_INDEX_DOC_FIELDS]; // v[0] is NULL if the formula failed to load
+
+    const Repo * repo;   // NULL if the formula is not served by an index
+    uint32_t     entry;
+
+    int loaded;          // v[] was loaded from the formula file and must be freed
+
+    int versionFromDate; // v[VERSION] is "" and must be derived from the date
+
+    int score;
+} Package;
+
+typedef struct {
+    Package * items;
+    size_t    size;
+} Packages;
+
+static const char * formulaSearchDirs = NULL;
+
+// resolve the given available package to the formula that would be used for it, the same way as path_of_formula does.
+static void resolve_package(Package * pkg, const char * name) {
+    memset(pkg, 0, sizeof(Package));
+
+    pkg->name = name;
+
+    if (formulaSearchDirs == NULL) {
+        formulaSearchDirs = getenv("PPKG_FORMULA_SEARCH_DIRS");
+
+        if (formulaSearchDirs == NULL) {
+            formulaSearchDirs = "";
+        }
+    }
+
+    char * filepath = NULL;
+
+    char dir[4096];
+
+    for (const char * p = formulaSearchDirs; (p = next_word(p, dir, sizeof(dir))) != NULL; ) {
+        char * x = strdup3(dir, "/", name);
+
+        filepath = strdup3(x, ".yml", "");
+
+        free(x);
+
+        if (is_regular_file(filepath)) break;
+
+        free(filepath);
+
+        filepath = NULL;
+    }
+
+    for (size_t j = 0; filepath == NULL && j < reposCount; j++) {
+        const Repo * repo = &repos[j];
+
+        if (repo->indexed) {
+            const FormulaIndexEntry * e = formula_index_lookup(&repo->idx, name, targetPlatformName);
+
+            if (e == NULL) continue;
+
+            if (!formula_index_entry_is_fresh(&repo->idx, e)) {
+                // the formula file has been modified since it was indexed, it is loaded as if the repository was not indexed.
+                filepath = formula_index_path_of(&repo->idx, e);
+                break;
+            }
+
+            pkg->repo  = repo;
+            pkg->entry = (uint32_t)(e - repo->idx.entries);
+
+            if (e->doc != FORMULA_INDEX_NO_DOC) {
+                for (int k = 0; k < FORMULA_INDEX_DOC_FIELDS; k++) {
+                    pkg->v[k] = repo->idx.strings + repo->idx.docs[e->doc].v[k];
+                }
+
+                pkg->versionFromDate = (e->flags & FORMULA_INDEX_VERSION_FROM_DATE) != 0;
+            }
+
+            return;
+        }
+
+        for (int k = 0; k < 2; k++) {
+            StringBuffer sb = {0};
+
+            sb_append(&sb, repo->path);
+            sb_append(&sb, "/formula/");
+
+            if (k == 0) {
+                sb_append(&sb, targetPlatformName);
+                sb_append(&sb, "/");
+            }
+
+            sb_append(&sb, name);
+            sb_append(&sb, ".yml");
+
+            if (exists(sb.buf)) {
+                filepath = sb_take(&sb);
+                break;
+            }
+
+            free(sb.buf);
+        }
+    }
+
+    if (filepath != NULL) {
+        char * v[FORMULA_INDEX_DOC_FIELDS];
+
+        int versionFromDate;
+
+        if (load_doc(v, &versionFromDate, name, filepath) == 0) {
+            for (int k = 0; k < FORMULA_INDEX_DOC_FIELDS; k++) {
+                pkg->v[k] = v[k];
+            }
+
+            pkg->loaded = 1;
+        }
+
+        free(filepath);
+    }
+}
+
+static void release_package(Package * pkg) {
+    if (pkg->loaded) {
+        for (int k = 0; k < FORMULA_INDEX_DOC_FIELDS; k++) {
+            free((char*)pkg->v[k]);
+        }
+
+        pkg->loaded = 0;
+    }
+}
+
+static void resolve_available_packages(Packages * packages) {
+    Strings names = {0};
+
+    list_available_package_names(&names);
+
+    packages->items = (Package*)calloc(names.size + 1, sizeof(Package));
+
+    if (packages->items == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < names.size; i++) {
+        resolve_package(&packages->items[packages->size++], names.items[i]);
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+
+// same as is_package_installed in ppkg
+static int is_package_installed(const char * packageName) {
+    const char * installedRoot = getenv("PPKG_PACKAGE_INSTALLED_ROOT");
+
+    if (installedRoot == NULL || installedRoot[0] == '\0') {
+        return 0;
+    }
+
+    static const char * const FILES[] = { "/.ppkg/MANIFEST.txt", "/.ppkg/RECEIPT.yml" };
+
+    char * p = strdup3(installedRoot, "/", packageName);
+
+    int ok = is_directory(p);
+
+    for (int i = 0; ok && i < 2; i++) {
+        char * x = strdup3(p, FILES[i], "");
+        ok = is_regular_file(x);
+        free(x);
+    }
+
+    free(p);
+
+    return ok;
+}
+
+// yq emits a scalar as it was written, the scalar needs quoting if it could not be read back as the same plain string.
+static int is_plain_yaml_scalar(const char * s) {
+    if (strchr("-?:,[]{}#&*!|>'\"%@` ", s[0]) != NULL) return 0;
+
+    size_t n = strlen(s);
+
+    if (s[n - 1] == ' ' || s[n - 1] == ':') return 0;
+
+    for (const char * p = s; *p != '\0'; p++) {
+        unsigned char c = (unsigned char)*p;
+
+        if (c < 0x20 || c == 0x7F) return 0;
+
+        if (c == ':' && p[1] == ' ') return 0;
+        if (c == ' ' && p[1] == '#') return 0;
+    }
+
+    return 1;
+}
+
+static void print_json_string(const char * s) {
+    putchar('"');
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+
+        switch (c) {
+            case '"':  fputs("\\\"", stdout); break;
+            case '\\': fputs("\\\\", stdout); break;
+            case '\b': fputs("\\b",  stdout); break;
+            case '\f': fputs("\\f",  stdout); break;
+            case '\n': fputs("\\n",  stdout); break;
+            case '\r': fputs("\\r",  stdout); break;
+            case '\t': fputs("\\t",  stdout); break;
+            default:
+                if (c < 0x20 || c == 0x7F) {
+                    printf("\\u%04x", c);
+                } else {
+                    putchar(c);
+                }
+        }
+    }
+
+    putchar('"');
+}
+
+static void print_yaml_mapping(const char * key, const char * value) {
+    if (value == NULL || value[0] == '\0') {
+        return;
+    }
+
+    printf("%s: ", key);
+
+    if (is_plain_yaml_scalar(value)) {
+        fputs(value, stdout);
+    } else {
+        print_json_string(value);
+    }
+
+    putchar('\n');
+}
+
+// the keys and their order are the same as __info_the_given_available_package_as_yaml
+static const int YAML_FIELDS[] = {
+    PKGTYPE, VERSION, LICENSE, SUMMARY, WEB_URL, GIT_URL, GIT_SHA, GIT_REF, GIT_NTH,
+    SRC_URL, SRC_URI, SRC_SHA, FIX_URL, FIX_URI, FIX_SHA, RES_URL, RES_URI, RES_SHA,
+    DEP_PKG, DEP_UPP, DEP_PYM, DEP_PLM, BSYSTEM, BINBSTD,
+    PPFLAGS, CCFLAGS, XXFLAGS, LDFLAGS, PARALLEL
+};
+
+// the keys and their order are the same as __info_the_given_available_package_as_json
+static const int JSON_FIELDS[] = {
+    PKGTYPE, VERSION, LICENSE, SUMMARY, WEB_URL, GIT_URL, GIT_SHA, GIT_REF, GIT_NTH,
+    SRC_URL, SRC_URI, SRC_SHA, FIX_URL, FIX_URI, FIX_SHA, RES_URL, RES_URI, RES_SHA,
+    PATCHES, RESLIST, DEP_PKG, DEP_UPP, DEP_PYM, DEP_PLM, BSYSTEM, BINBSTD,
+    CCFLAGS, XXFLAGS, PPFLAGS, LDFLAGS, PARALLEL, DEVELOPER,
+    ONSTART, ONREADY, ONFINAL, DO12345, DOPATCH, PREPARE, DOBUILD, DOTWEAK, CAVEATS
+};
+
+static const char * value_of(const Package * pkg, int field) {
+    static char * date = NULL;
+
+    const char * value = pkg->v[field];
+
+    if (field == VERSION && pkg->versionFromDate) {
+        if (date == NULL) {
+            date = today();
+        }
+
+        return date;
+    }
+
+    if (field == WEB_URL && value[0] == '\0') {
+        return pkg->v[GIT_URL];
+    }
+
+    return value;
+}
+
+// load the formula again to report why it failed to load, then exit.
+static void abort_malformed(const Package * pkg) {
+    char * filepath = path_of_formula(pkg->name);
+
+    Formula formula;
+
+    if (filepath == NULL || load_formula(&formula, pkg->name, filepath) == 0) {
+        fprintf(stderr, "package '%s' is not available.\n", pkg->name);
+    }
+
+    exit(1);
+}
+
+static void print_package_as_yaml(const Package * pkg) {
+    if (pkg->v[0] == NULL) {
+        abort_malformed(pkg);
+    }
+
+    print_yaml_mapping("pkgname", pkg->name);
+
+    for (size_t i = 0; i < sizeof(YAML_FIELDS) / sizeof(YAML_FIELDS[0]); i++) {
+        print_yaml_mapping(FIELDS[YAML_FIELDS[i]][0], value_of(pkg, YAML_FIELDS[i]));
+    }
+
+    print_yaml_mapping("installed", is_package_installed(pkg->name) ? "yes" : "no");
+}
+
+// the layout is the same as jq prints, compact is the same as jq -c prints.
+static void print_package_as_json(const Package * pkg, int compact) {
+    if (pkg->v[0] == NULL) {
+        abort_malformed(pkg);
+    }
+
+    fputs(compact ? "{\"pkgname\":" : "{\n  \"pkgname\": ", stdout);
+    print_json_string(pkg->name);
+
+    for (size_t i = 0; i < sizeof(JSON_FIELDS) / sizeof(JSON_FIELDS[0]); i++) {
+        const char * value = value_of(pkg, JSON_FIELDS[i]);
+
+        if (value[0] == '\0') continue;
+
+        printf(compact ? ",\"%s\":" : ",\n  \"%s\": ", FIELDS[JSON_FIELDS[i]][0]);
+        print_json_string(value);
+    }
+
+    fputs(compact ? "}\n" : "\n}\n", stdout);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// every package is resolved, printed then released one by one, so that the memory used does not grow with the number of packages.
+static int list(int argc, char * argv[]) {
+    int verbose = 0;
+
+    char outputType = 'y';
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[i], "--yaml") == 0) {
+            outputType = 'y';
+        } else if (strcmp(argv[i], "--json") == 0) {
+            outputType = 'j';
+        } else if (strcmp(argv[i], "--ndjson") == 0) {
+            outputType = 'n';
+        } else {
+            fprintf(stderr, "unrecognized argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    open_formula_repositories();
+
+    Strings names = {0};
+
+    list_available_package_names(&names);
+
+    if (!verbose) {
+        for (size_t i = 0; i < names.size; i++) {
+            puts(names.items[i]);
+        }
+
+        return 0;
+    }
+
+    if (names.size == 0) {
+        return 0;
+    }
+
+    if (outputType == 'j') {
+        puts("[");
+    }
+
+    for (size_t i = 0; i < names.size; i++) {
+        Package pkg;
+
+        resolve_package(&pkg, names.items[i]);
+
+        switch (outputType) {
+            case 'y':
+                if (i > 0) puts("---");
+                print_package_as_yaml(&pkg);
+                break;
+            case 'j':
+                if (i > 0) puts(",");
+                print_package_as_json(&pkg, 0);
+                break;
+            case 'n':
+                print_package_as_json(&pkg, 1);
+                break;
+        }
+
+        release_package(&pkg);
+    }
+
+    if (outputType == 'j') {
+        puts("]");
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    const char * query;
+    int          best;
+} TokenMatch;
+
+static void match_token(const char * token, void * arg) {
+    TokenMatch * m = (TokenMatch *)arg;
+
+    if (starts_with(token, m->query)) {
+        int x = strcmp(token, m->query) == 0 ? 2 : 1;
+
+        if (m->best < x) {
+            m->best = x;
+        }
+    }
+}
+
+// the score of the given query token in the given package, 0 if it does not match.
+// this is used for the packages that are not served by an index, and gives the same result as the inverted index.
+static int score_token_without_index(const Package * pkg, const char * query) {
+    int score = 0;
+
+    for (int i = 0; i < SEARCH_FIELD_COUNT; i++) {
+        const char * s = SEARCH_FIELDS[i][0] == -1 ? pkg->name : pkg->v[SEARCH_FIELDS[i][0]];
+
+        if (s == NULL) continue;
+
+        TokenMatch m = { query, 0 };
+
+        tokenize(s, match_token, &m);
+
+        int x = weight_of_fields((uint32_t)SEARCH_FIELDS[i][1]) * m.best;
+
+        if (score < x) {
+            score = x;
+        }
+    }
+
+    return score;
+}
+
+// the index of the first term that is not less than the given query token.
+static uint32_t lower_bound_of_term(const FormulaIndex * idx, const char * query) {
+    uint32_t lo = 0;
+    uint32_t hi = idx->header->termCount;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(idx->strings + idx->terms[mid].term, query) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static void collect_query_token(const char * token, void * arg) {
+    strings_add((Strings *)arg, strdup2(token));
+}
+
+static int search_by_token(Packages * packages, int argc, char * argv[]) {
+    Strings queries = {0};
+
+    for (int i = 0; i < argc; i++) {
+        tokenize(argv[i], collect_query_token, &queries);
+    }
+
+    if (queries.size == 0) {
+        fprintf(stderr, "no alphanumeric token found in the given pattern.\n");
+        return 1;
+    }
+
+    // scores[i][e] is the score of the entry e in the index of repos[i], -1 if some query token does not match.
+    // a query token contributes the highest score among the terms it is a prefix of.
+
+    int ** scores = (int**)calloc(reposCount + 1, sizeof(int*));
+    int *  best   = NULL;
+
+    if (scores == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (size_t i = 0; i < reposCount; i++) {
+        if (!repos[i].indexed) continue;
+
+        const FormulaIndex * idx = &repos[i].idx;
+
+        uint32_t entryCount = idx->header->entryCount;
+
+        scores[i] = (int*)calloc(entryCount + 1, sizeof(int));
+        best      = (int*)realloc(best, (entryCount + 1) * sizeof(int));
+
+        if (scores[i] == NULL || best == NULL) {
+            perror(NULL);
+            return 1;
+        }
+
+        for (size_t q = 0; q < queries.size; q++) {
+            const char * query = queries.items[q];
+
+            memset(best, 0, (entryCount + 1) * sizeof(int));
+
+            for (uint32_t t = lower_bound_of_term(idx, query); t < idx->header->termCount; t++) {
+                const char * term = idx->strings + idx->terms[t].term;
+
+                if (!starts_with(term, query)) break;
+
+                int exact = strcmp(term, query) == 0;
+
+                const FormulaIndexPosting * posting = idx->postings + idx->terms[t].postingStart;
+
+                for (uint32_t k = 0; k < idx->terms[t].postingCount; k++, posting++) {
+                    int x = weight_of_fields(posting->fields) * (1 + exact);
+
+                    if (best[posting->entry] < x) {
+                        best[posting->entry] = x;
+                    }
+                }
+            }
+
+            for (uint32_t e = 0; e < entryCount; e++) {
+                if (scores[i][e] < 0) continue;
+
+                scores[i][e] = best[e] == 0 ? -1 : scores[i][e] + best[e];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < packages->size; i++) {
+        Package * pkg = &packages->items[i];
+
+        if (pkg->repo != NULL) {
+            pkg->score = scores[pkg->repo - repos][pkg->entry];
+            continue;
+        }
+
+        pkg->score = 0;
+
+        for (size_t q = 0; q < queries.size; q++) {
+            int x = score_token_without_index(pkg, queries.items[q]);
+
+            if (x == 0) {
+                pkg->score = -1;
+                break;
+            }
+
+            pkg->score += x;
+        }
+    }
+
+    return 0;
+}
+
+static int search_by_regex(Packages * packages, int argc, char * argv[]) {
+    if (argc != 1) {
+        fprintf(stderr, "only one regular expression pattern can be given.\n");
+        return 1;
+    }
+
+    regex_t regex;
+
+    int ret = regcomp(&regex, argv[0], REG_NOSUB);
+
+    if (ret != 0) {
+        char buf[256];
+        regerror(ret, &regex, buf, sizeof(buf));
+        fprintf(stderr, "invalid regular expression pattern '%s': %s\n", argv[0], buf);
+        return 1;
+    }
+
+    for (size_t i = 0; i < packages->size; i++) {
+        Package * pkg = &packages->items[i];
+
+        pkg->score = -1;
+
+        for (int j = 0; j < SEARCH_FIELD_COUNT; j++) {
+            const char * s = SEARCH_FIELDS[j][0] == -1 ? pkg->name : pkg->v[SEARCH_FIELDS[j][0]];
+
+            if (s == NULL) continue;
+
+            if (regexec(&regex, s, 0, NULL, 0) == 0) {
+                if (pkg->score < 0) {
+                    pkg->score = 0;
+                }
+
+                pkg->score += weight_of_fields((uint32_t)SEARCH_FIELDS[j][1]);
+            }
+        }
+    }
+
+    regfree(&regex);
+
+    return 0;
+}
+
+// the most relevant first, then by name
+static int compare_package(const void * a, const void * b) {
+    const Package * x = (const Package *)a;
+    const Package * y = (const Package *)b;
+
+    if (x->score != y->score) {
+        return x->score > y->score ? -1 : 1;
+    }
+
+    return strcmp(x->name, y->name);
+}
+
+static int search(int argc, char * argv[]) {
+    int byToken = 0;
+
+    char outputType = 0;
+
+    int n = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--token") == 0) {
+            byToken = 1;
+        } else if (strcmp(argv[i], "--regex") == 0) {
+            byToken = 0;
+        } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--yaml") == 0) {
+            outputType = 'y';
+        } else if (strcmp(argv[i], "--json") == 0) {
+            outputType = 'j';
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "unrecognized argument: %s\n", argv[i]);
+            return 1;
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+
+    if (n == 0 || argv[0][0] == '\0') {
+        fprintf(stderr, "Usage: formula-index search [--regex | --token] [-v | --yaml | --json] <PATTERN>..., <PATTERN> is unspecified.\n");
+        return 1;
+    }
+
+    open_formula_repositories();
+
+    Packages packages = {0};
+
+    resolve_available_packages(&packages);
+
+    if ((byToken ? search_by_token : search_by_regex)(&packages, n, argv) != 0) {
+        return 1;
+    }
+
+    qsort(packages.items, packages.size, sizeof(Package), compare_package);
+
+    if (outputType == 'j') {
+        puts("[");
+    }
+
+    for (size_t i = 0; i < packages.size && packages.items[i].score >= 0; i++) {
+        const Package * pkg = &packages.items[i];
+
+        switch (outputType) {
+            case 'y':
+                if (i > 0) puts("---");
+                print_package_as_yaml(pkg);
+                break;
+            case 'j':
+                if (i > 0) puts(",");
+                print_package_as_json(pkg, 0);
+                break;
+            default:
+                puts(pkg->name);
+        }
+    }
+
+    if (outputType == 'j') {
+        puts("]");
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// the installed versions are joined against the available versions in one pass, every formula is resolved at most once.
+static int outdated(int argc, char * argv[]) {
+    int json = 0;
+
+    const char * target = NULL;
+
+    int specsCount = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (starts_with(argv[i], "--target=")) {
+            target = argv[i] + 9;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unrecognized argument: %s\n", argv[i]);
+            return 1;
+        } else {
+            argv[specsCount++] = argv[i];
+        }
+    }
+
+    open_formula_repositories();
+
+    size_t count = 0;
+
+    char * line = NULL;
+    size_t lineCapacity = 0;
+
+    for (;;) {
+        ssize_t n = getline(&line, &lineCapacity, stdin);
+
+        if (n < 0) break;
+
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        // <spec>\t<version>\t...
+        char * spec = line;
+
+        char * tab = strchr(spec, '\t');
+
+        if (tab == NULL) continue;
+
+        *tab = '\0';
+
+        char * installedVersion = tab + 1;
+
+        installedVersion[strcspn(installedVersion, "\t\n")] = '\0';
+
+        if (specsCount > 0) {
+            int wanted = 0;
+
+            for (int i = 0; i < specsCount; i++) {
+                if (strcmp(argv[i], spec) == 0) {
+                    wanted = 1;
+                    break;
+                }
+            }
+
+            if (!wanted) continue;
+        }
+
+        const char * slash = strrchr(spec, '/');
+
+        const char * name = slash == NULL ? spec : slash + 1;
+
+        if (target != NULL && (slash == NULL || strncmp(spec, target, (size_t)(slash - spec)) != 0 || target[slash - spec] != '\0')) continue;
+
+        Package pkg;
+
+        resolve_package(&pkg, name);
+
+        if (pkg.v[0] == NULL) {
+            // an installed package whose formula was removed can not be outdated
+            if (pkg.repo == NULL && path_of_formula(name) == NULL) continue;
+
+            abort_malformed(&pkg);
+        }
+
+        const char * availableVersion = value_of(&pkg, VERSION);
+
+        if (strcmp(availableVersion, installedVersion) != 0 && compare_version(availableVersion, installedVersion) > 0) {
+            if (json) {
+                fputs(count == 0 ? "[\n  {\n    \"spec\": " : ",\n  {\n    \"spec\": ", stdout);
+                print_json_string(spec);
+                fputs(",\n    \"pkgname\": ", stdout);
+                print_json_string(name);
+                fputs(",\n    \"old-version\": ", stdout);
+                print_json_string(installedVersion);
+                fputs(",\n    \"new-version\": ", stdout);
+                print_json_string(availableVersion);
+                fputs("\n  }", stdout);
+            } else {
+                puts(spec);
+            }
+
+            count++;
+        }
+
+        release_package(&pkg);
+    }
+
+    free(line);
+
+    if (ferror(stdin)) {
+        perror("stdin");
+        return 1;
+    }
+
+    if (json) {
+        puts(count == 0 ? "[]" : "\n]");
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <build|path|exists|list|search|outdated> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+
+    if (strcmp(argv[1], "build") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s build <FORMULA-REPO-PATH>..., <FORMULA-REPO-PATH> is unspecified.\n", argv[0]);
+            return 1;
+        }
+
+        for (int i = 2; i < argc; i++) {
+            if (build(argv[i]) != 0) {
+                return 1;
+            }
+        }
+    } else if (strcmp(argv[1], "path") == 0 || strcmp(argv[1], "exists") == 0) {
+        if (argc < 3 || argv[2][0] == '\0') {
+            fprintf(stderr, "Usage: %s %s <PACKAGE-NAME>, <PACKAGE-NAME> is unspecified.\n", argv[0], argv[1]);
+            return 1;
+        }
+
+        char * filepath = path_of_formula(argv[2]);
+
+        if (argv[1][0] == 'e') {
+            return filepath == NULL ? 1 : 0;
+        }
+
+        if (filepath != NULL) {
+            puts(filepath);
+        }
+    } else if (strcmp(argv[1], "list") == 0) {
+        ret = list(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "search") == 0) {
+        ret = search(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "outdated") == 0) {
+        ret = outdated(argc - 2, argv + 2);
+    } else {
+        fprintf(stderr, "unrecognized action: %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,1168 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "formula.h"
+
+// formula-loader load      <PACKAGE-NAME> [FORMULA-FILEPATH]
+// formula-loader closure   [--copy-to=<DIR>] <PACKAGE-NAME>...
+// formula-loader order     <PACKAGE-NAME>...
+// formula-loader graph     [--type=<box|dot|d2|svg>] <PACKAGE-NAME>...
+// formula-loader artifacts <PACKAGE-NAME>...
+//
+// load      : parse the given formula once, validate it, derive every PACKAGE_* variable exactly the same way as ppkg does, then print them as a shell-safe block to be eval'ed.
+// closure   : load the given packages and all of their recursive dependencies, copy their formulas to <DIR>/<PACKAGE-NAME>.yml, print PACKAGE_DEP_PKG_<PACKAGE-NAME-UPPERCASE-UNDERSCORE> for every one of them,
+//             then PACKAGE_ORDER_<PACKAGE-NAME-UPPERCASE-UNDERSCORE> for every one of them, which is what order would print for that package, space separated.
+// order     : load the given packages and all of their recursive dependencies, print them in a topological order, every package is printed after all of its dependencies.
+// graph     : load the given packages and all of their recursive dependencies, print their dependency graph as box-art (default), DOT, D2 or SVG. box-art and SVG are drawn with a layered layout, no external tool is involved.
+// artifacts : print every resource to be downloaded for the given packages (src, fix, res, patches, reslist) as <PACKAGE-NAME>|<SHA256>|<URL>|<URI>|<FILEPATH>, one per line, git repositories and local paths are not included.
+//
+// closure, order and graph load every formula exactly once, and fail with the full path if there is a circular dependency.
+
+/////////////////////////////////////////////////////////////////
+
+static void print_quoted(const char * s) {
+    putchar('\'');
+
+    for (; *s != '\0'; s++) {
+        if (*s == '\'') {
+            fputs("'\\''", stdout);
+        } else {
+            putchar(*s);
+        }
+    }
+
+    putchar('\'');
+}
+
+static void print_assignment(const char * name, const char * suffix, const char * value) {
+    if (value == NULL) {
+        printf("unset PACKAGE_%s%s\n", name, suffix);
+    } else {
+        printf("PACKAGE_%s%s=", name, suffix);
+        print_quoted(value);
+        putchar('\n');
+    }
+}
+
+static void print_formula(const Formula * f) {
+    printf("PACKAGE_NAME=");
+    print_quoted(f->name);
+    putchar('\n');
+
+    print_assignment("NAME_UPPERCASE_UNDERSCORE", "", f->nameUppercaseUnderscore);
+    print_assignment("FORMULA_FILEPATH", "", f->filepath);
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        print_assignment(FIELDS[i][1], "", f->v[i]);
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int load(int argc, char * argv[]) {
+    if (argc < 1 || argv[0][0] == '\0') {
+        fprintf(stderr, "Usage: formula-loader load <PACKAGE-NAME> [FORMULA-FILEPATH], <PACKAGE-NAME> is unspecified.\n");
+        return 1;
+    }
+
+    char * filepath;
+
+    if (argc > 1 && argv[1][0] != '\0') {
+        filepath = argv[1];
+    } else {
+        filepath = path_of_formula(argv[0]);
+
+        if (filepath == NULL) {
+            fprintf(stderr, "package '%s' is not available.\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Formula formula;
+
+    if (load_formula(&formula, argv[0], filepath) != 0) {
+        return 1;
+    }
+
+    print_formula(&formula);
+
+    return 0;
+}
+
+// the dependency graph of a closure, every formula is loaded exactly once.
+
+typedef struct {
+    char *  name;
+    char ** deps;
+    size_t  depsCount;
+    int     state;     // 0: not visited yet, 1: on the path being visited, 2: done
+} Node;
+
+typedef struct {
+    Node *   items;
+    size_t   size;
+    size_t   capacity;
+
+    size_t * buckets;  // open addressing hash table of (index + 1) into items, 0 for empty
+    size_t   bucketsCount;
+} Graph;
+
+static uint32_t hash_of(const char * s) {
+    uint32_t h = 2166136261u;
+
+    for (; *s != '\0'; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static void graph_rehash(Graph * g) {
+    free(g->buckets);
+
+    g->bucketsCount = g->bucketsCount == 0 ? 256 : g->bucketsCount << 1;
+
+    g->buckets = (size_t*)calloc(g->bucketsCount, sizeof(size_t));
+
+    if (g->buckets == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < g->size; i++) {
+        size_t j = hash_of(g->items[i].name) & (g->bucketsCount - 1);
+
+        while (g->buckets[j] != 0) {
+            j = (j + 1) & (g->bucketsCount - 1);
+        }
+
+        g->buckets[j] = i + 1;
+    }
+}
+
+static Node * graph_find(const Graph * g, const char * name) {
+    if (g->bucketsCount == 0) {
+        return NULL;
+    }
+
+    for (size_t j = hash_of(name) & (g->bucketsCount - 1); g->buckets[j] != 0; j = (j + 1) & (g->bucketsCount - 1)) {
+        Node * node = &g->items[g->buckets[j] - 1];
+
+        if (strcmp(node->name, name) == 0) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+static Node * graph_add(Graph * g, const char * name) {
+    if (g->size == g->capacity) {
+        g->capacity = g->capacity == 0 ? 64 : g->capacity << 1;
+
+        g->items = (Node*)realloc(g->items, g->capacity * sizeof(Node));
+
+        if (g->items == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    Node * node = &g->items[g->size++];
+
+    memset(node, 0, sizeof(Node));
+
+    node->name = strdup2(name);
+
+    // keep the load factor under 1/2
+    if (g->size * 2 > g->bucketsCount) {
+        graph_rehash(g);
+    } else {
+        size_t j = hash_of(name) & (g->bucketsCount - 1);
+
+        while (g->buckets[j] != 0) {
+            j = (j + 1) & (g->bucketsCount - 1);
+        }
+
+        g->buckets[j] = g->size;
+    }
+
+    return node;
+}
+
+// load the given packages and all of their recursive dependencies into the graph.
+// if copyTo is not NULL, the formulas are copied to <copyTo>/<PACKAGE-NAME>.yml
+// if print is not 0, PACKAGE_DEP_PKG_<PACKAGE-NAME-UPPERCASE-UNDERSCORE> is printed for every one of them.
+static int graph_load(Graph * g, int argc, char * argv[], const char * copyTo, int print) {
+    size_t stackCapacity = 64 + (size_t)argc;
+    size_t stackSize = 0;
+
+    char ** stack = (char**)malloc(stackCapacity * sizeof(char*));
+
+    if (stack == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (int j = argc - 1; j >= 0; j--) {
+        stack[stackSize++] = argv[j];
+    }
+
+    while (stackSize > 0) {
+        char * packageName = stack[--stackSize];
+
+        if (graph_find(g, packageName) != NULL) continue;
+
+        char * filepath = path_of_formula(packageName);
+
+        if (filepath == NULL) {
+            fprintf(stderr, "package '%s' is not available.\n", packageName);
+            return 1;
+        }
+
+        Formula formula;
+
+        if (load_formula(&formula, packageName, filepath) != 0) {
+            return 1;
+        }
+
+        if (copyTo != NULL) {
+            char * p = strdup3(copyTo, "/", packageName);
+            char * dest = strdup3(p, ".yml", "");
+
+            free(p);
+
+            if (!is_regular_file(dest) && copy_file(filepath, dest) != 0) {
+                return 1;
+            }
+
+            free(dest);
+        }
+
+        if (print) {
+            print_assignment("DEP_PKG_", formula.nameUppercaseUnderscore, formula.v[DEP_PKG]);
+        }
+
+        free(filepath);
+
+        Node * node = graph_add(g, packageName);
+
+        char word[1024];
+
+        for (const char * p = formula.v[DEP_PKG]; (p = next_word(p, word, sizeof(word))) != NULL; ) {
+            node->deps = (char**)realloc(node->deps, (node->depsCount + 1) * sizeof(char*));
+
+            if (node->deps == NULL) {
+                perror(NULL);
+                return 1;
+            }
+
+            node->deps[node->depsCount++] = strdup2(word);
+
+            if (stackSize == stackCapacity) {
+                stackCapacity <<= 1;
+                stack = (char**)realloc(stack, stackCapacity * sizeof(char*));
+
+                if (stack == NULL) {
+                    perror(NULL);
+                    return 1;
+                }
+            }
+
+            stack[stackSize++] = node->deps[node->depsCount - 1];
+        }
+
+        free_formula(&formula);
+    }
+
+    free(stack);
+
+    return 0;
+}
+
+// depth-first walk the graph from the given packages, every package is appended to sorted after all of its dependencies.
+// the order is stable: the dependencies are visited in the order they are declared in dep-pkg.
+// returns 1 and reports the full path if there is a circular dependency.
+static int graph_order(Graph * g, int argc, char * argv[], Node ** sorted) {
+    Node  ** path = (Node**)malloc((g->size + 1) * sizeof(Node*));
+    size_t * next = (size_t*)malloc((g->size + 1) * sizeof(size_t));
+
+    if (path == NULL || next == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        Node * root = graph_find(g, argv[i]);
+
+        if (root == NULL || root->state == 2) continue;
+
+        size_t depth = 0;
+
+        path[depth] = root;
+        next[depth] = 0;
+        depth++;
+
+        root->state = 1;
+
+        while (depth > 0) {
+            Node * node = path[depth - 1];
+
+            if (next[depth - 1] == node->depsCount) {
+                node->state = 2;
+
+                *sorted++ = node;
+
+                depth--;
+                continue;
+            }
+
+            Node * dep = graph_find(g, node->deps[next[depth - 1]++]);
+
+            if (dep->state == 2) continue;
+
+            if (dep->state == 1) {
+                size_t k = 0;
+
+                while (path[k] != dep) k++;
+
+                fprintf(stderr, "circular dependency detected: ");
+
+                for (; k < depth; k++) {
+                    fprintf(stderr, "%s -> ", path[k]->name);
+                }
+
+                fprintf(stderr, "%s\n", dep->name);
+
+                return 1;
+            }
+
+            dep->state = 1;
+
+            path[depth] = dep;
+            next[depth] = 0;
+            depth++;
+        }
+    }
+
+    free(path);
+    free(next);
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// a layered layout of the dependency graph:
+// every package is placed in a layer below all of the packages which depend on it,
+// an edge which spans several layers is carried through the layers in between by virtual vertices,
+// the order in every layer is improved by a few barycenter sweeps to reduce crossings.
+
+typedef struct {
+    Node * node;      // NULL for a virtual vertex
+    int    layer;
+    int    index;     // position in its layer
+    int    x;         // leftmost column
+    int    w;         // width in columns
+    int    track;     // the row of the channel below this vertex where its edges turn, -1 if it goes straight down
+    size_t out;       // the outgoing segment of a virtual vertex
+    double key;
+    int    degree;
+} Vertex;
+
+typedef struct {
+    size_t from;
+    size_t to;
+} Segment;
+
+typedef struct {
+    Vertex  * vertices;
+    size_t    verticesCount;
+    size_t    verticesCapacity;
+
+    Segment * segments;
+    size_t    segmentsCount;
+    size_t    segmentsCapacity;
+
+    size_t ** layers;      // vertex indexes of every layer, in drawing order
+    size_t *  layerSizes;
+    int       layersCount;
+
+    int *     top;         // the first row of every layer
+    int *     tracks;      // the number of tracks of the channel below every layer
+
+    int       width;
+    int       height;
+} Layout;
+
+#define LAYOUT_GAP 2
+
+static void * xrealloc(void * p, size_t size) {
+    p = realloc(p, size);
+
+    if (p == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    return p;
+}
+
+static size_t layout_add_vertex(Layout * l, Node * node, int layer) {
+    if (l->verticesCount == l->verticesCapacity) {
+        l->verticesCapacity = l->verticesCapacity == 0 ? 64 : l->verticesCapacity << 1;
+        l->vertices = (Vertex*)xrealloc(l->vertices, l->verticesCapacity * sizeof(Vertex));
+    }
+
+    Vertex * v = &l->vertices[l->verticesCount];
+
+    memset(v, 0, sizeof(Vertex));
+
+    v->node  = node;
+    v->layer = layer;
+    v->track = -1;
+    v->w     = node == NULL ? 1 : (int)strlen(node->name) + 4;
+
+    return l->verticesCount++;
+}
+
+static void layout_add_segment(Layout * l, size_t from, size_t to) {
+    if (l->segmentsCount == l->segmentsCapacity) {
+        l->segmentsCapacity = l->segmentsCapacity == 0 ? 64 : l->segmentsCapacity << 1;
+        l->segments = (Segment*)xrealloc(l->segments, l->segmentsCapacity * sizeof(Segment));
+    }
+
+    l->segments[l->segmentsCount].from = from;
+    l->segments[l->segmentsCount].to   = to;
+
+    l->vertices[from].out = l->segmentsCount++;
+}
+
+static int center_of(const Vertex * v) {
+    return v->x + v->w / 2;
+}
+
+// the key of every vertex of the given layer is the mean of the keys of its neighbours in the adjacent layer,
+// which is the layer above if byPredecessors is not 0, otherwise the layer below.
+// a vertex without such neighbours keeps its own key.
+static void layout_mean_of_neighbours(Layout * l, int layer, int byPredecessors, int byCenter) {
+    size_t   size = l->layerSizes[layer];
+    size_t * row  = l->layers[layer];
+
+    for (size_t i = 0; i < size; i++) {
+        l->vertices[row[i]].key = 0;
+        l->vertices[row[i]].degree = 0;
+    }
+
+    for (size_t i = 0; i < l->segmentsCount; i++) {
+        Vertex * from = &l->vertices[l->segments[i].from];
+        Vertex * to   = &l->vertices[l->segments[i].to];
+
+        if (!byPredecessors) {
+            Vertex * t = from; from = to; to = t;
+        }
+
+        if (to->layer != layer) continue;
+
+        to->key += byCenter ? center_of(from) : from->index;
+        to->degree++;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        Vertex * v = &l->vertices[row[i]];
+
+        if (v->degree == 0) {
+            v->key = byCenter ? center_of(v) : v->index;
+        } else {
+            v->key /= v->degree;
+        }
+    }
+}
+
+static void layout_sort_layer(Layout * l, int layer, int byPredecessors) {
+    size_t   size = l->layerSizes[layer];
+    size_t * row  = l->layers[layer];
+
+    layout_mean_of_neighbours(l, layer, byPredecessors, 0);
+
+    // insertion sort, stable
+    for (size_t i = 1; i < size; i++) {
+        size_t v = row[i];
+        size_t j = i;
+
+        for (; j > 0 && l->vertices[row[j - 1]].key > l->vertices[v].key; j--) {
+            row[j] = row[j - 1];
+        }
+
+        row[j] = v;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        l->vertices[row[i]].index = (int)i;
+    }
+}
+
+// every vertex is placed right under the mean of the centers of its neighbours, then pushed right to not overlap its left neighbour.
+static void layout_place_layer(Layout * l, int layer, int byPredecessors) {
+    size_t   size = l->layerSizes[layer];
+    size_t * row  = l->layers[layer];
+
+    layout_mean_of_neighbours(l, layer, byPredecessors, 1);
+
+    int right = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        Vertex * v = &l->vertices[row[i]];
+
+        int x = (int)(v->key < 0 ? v->key - 0.5 : v->key + 0.5) - v->w / 2;
+
+        if (i > 0 && x < right + LAYOUT_GAP) {
+            x = right + LAYOUT_GAP;
+        }
+
+        v->x  = x;
+        right = x + v->w;
+    }
+}
+
+// sorted is what graph_order gives, every package is after all of its dependencies.
+static void graph_layout(const Graph * g, Node ** sorted, Layout * l) {
+    memset(l, 0, sizeof(Layout));
+
+    int * layerOf = (int*)calloc(g->size + 1, sizeof(int));
+
+    if (layerOf == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    // walk backwards, so that every package is pushed below all of the packages which depend on it
+    for (size_t i = g->size; i-- > 0; ) {
+        Node * node = sorted[i];
+
+        int layer = layerOf[node - g->items];
+
+        for (size_t j = 0; j < node->depsCount; j++) {
+            size_t k = (size_t)(graph_find(g, node->deps[j]) - g->items);
+
+            if (layerOf[k] < layer + 1) {
+                layerOf[k] = layer + 1;
+            }
+        }
+    }
+
+    // the vertex of the i-th package is the i-th vertex
+    for (size_t i = 0; i < g->size; i++) {
+        layout_add_vertex(l, &g->items[i], layerOf[i]);
+
+        if (l->layersCount < layerOf[i] + 1) {
+            l->layersCount = layerOf[i] + 1;
+        }
+    }
+
+    for (size_t i = 0; i < g->size; i++) {
+        const Node * node = &g->items[i];
+
+        for (size_t j = 0; j < node->depsCount; j++) {
+            size_t k = 0;
+
+            while (k < j && strcmp(node->deps[k], node->deps[j]) != 0) k++;
+
+            // a dependency declared twice is drawn once
+            if (k < j) continue;
+
+            size_t to   = (size_t)(graph_find(g, node->deps[j]) - g->items);
+            size_t from = i;
+
+            for (int layer = layerOf[i] + 1; layer < layerOf[to]; layer++) {
+                size_t v = layout_add_vertex(l, NULL, layer);
+                layout_add_segment(l, from, v);
+                from = v;
+            }
+
+            layout_add_segment(l, from, to);
+        }
+    }
+
+    free(layerOf);
+
+    //////////////////////////////////////////////////
+
+    size_t n = (size_t)l->layersCount;
+
+    l->layers     = (size_t**)calloc(n, sizeof(size_t*));
+    l->layerSizes = (size_t*) calloc(n, sizeof(size_t));
+    l->top        = (int*)    calloc(n, sizeof(int));
+    l->tracks     = (int*)    calloc(n, sizeof(int));
+
+    if (l->layers == NULL || l->layerSizes == NULL || l->top == NULL || l->tracks == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < l->verticesCount; i++) {
+        Vertex * v = &l->vertices[i];
+
+        l->layers[v->layer] = (size_t*)xrealloc(l->layers[v->layer], (l->layerSizes[v->layer] + 1) * sizeof(size_t));
+        l->layers[v->layer][l->layerSizes[v->layer]] = i;
+
+        v->index = (int)l->layerSizes[v->layer]++;
+    }
+
+    for (int round = 0; round < 4; round++) {
+        for (int layer = 1; layer < l->layersCount; layer++) {
+            layout_sort_layer(l, layer, 1);
+        }
+
+        for (int layer = l->layersCount - 2; layer >= 0; layer--) {
+            layout_sort_layer(l, layer, 0);
+        }
+    }
+
+    for (int layer = 0; layer < l->layersCount; layer++) {
+        layout_place_layer(l, layer, 1);
+    }
+
+    for (int layer = l->layersCount - 2; layer >= 0; layer--) {
+        layout_place_layer(l, layer, 0);
+    }
+
+    int minX = 0;
+
+    for (size_t i = 0; i < l->verticesCount; i++) {
+        if (i == 0 || l->vertices[i].x < minX) {
+            minX = l->vertices[i].x;
+        }
+    }
+
+    for (size_t i = 0; i < l->verticesCount; i++) {
+        Vertex * v = &l->vertices[i];
+
+        v->x -= minX;
+
+        if (l->width < v->x + v->w) {
+            l->width = v->x + v->w;
+        }
+    }
+
+    //////////////////////////////////////////////////
+
+    // a vertex whose edges do not go straight down gets a track of its own in the channel below its layer
+    for (int layer = 0; layer < l->layersCount; layer++) {
+        for (size_t i = 0; i < l->layerSizes[layer]; i++) {
+            size_t   k = l->layers[layer][i];
+            Vertex * v = &l->vertices[k];
+
+            int count = 0;
+            int straight = 1;
+
+            for (size_t j = 0; j < l->segmentsCount; j++) {
+                if (l->segments[j].from != k) continue;
+
+                count++;
+
+                if (center_of(&l->vertices[l->segments[j].to]) != center_of(v)) {
+                    straight = 0;
+                }
+            }
+
+            if (count > 1 || (count == 1 && !straight)) {
+                v->track = l->tracks[layer]++;
+            }
+        }
+    }
+
+    // a layer is 3 rows high, the channel below it is one row for every track plus one row for the arrows
+    for (int layer = 1; layer < l->layersCount; layer++) {
+        l->top[layer] = l->top[layer - 1] + 3 + l->tracks[layer - 1] + 1;
+    }
+
+    l->height = l->top[l->layersCount - 1] + 3;
+}
+
+/////////////////////////////////////////////////////////////////
+
+#define CELL_UP    1
+#define CELL_DOWN  2
+#define CELL_LEFT  4
+#define CELL_RIGHT 8
+#define CELL_ARROW 16
+
+// indexed by CELL_UP | CELL_DOWN | CELL_LEFT | CELL_RIGHT
+static const char * const BOX_GLYPHS[16] = {
+    " ", "│", "│", "│", "─", "┘", "┐", "┤", "─", "└", "┌", "├", "─", "┴", "┬", "┼"
+};
+
+typedef struct {
+    unsigned char * cells;
+    char *          chars;
+    int             width;
+    int             height;
+} Canvas;
+
+// an axis-aligned line, every cell on it is connected to its neighbours on it
+static void canvas_line(Canvas * c, int x0, int y0, int x1, int y1) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+
+    if (x0 == x1) {
+        for (int y = y0; y <= y1; y++) {
+            if (y > y0) c->cells[y * c->width + x0] |= CELL_UP;
+            if (y < y1) c->cells[y * c->width + x0] |= CELL_DOWN;
+        }
+    } else {
+        for (int x = x0; x <= x1; x++) {
+            if (x > x0) c->cells[y0 * c->width + x] |= CELL_LEFT;
+            if (x < x1) c->cells[y0 * c->width + x] |= CELL_RIGHT;
+        }
+    }
+}
+
+static void print_box(const Layout * l) {
+    Canvas c = { NULL, NULL, l->width, l->height };
+
+    c.cells = (unsigned char*)calloc((size_t)(c.width * c.height) + 1, 1);
+    c.chars = (char*)         calloc((size_t)(c.width * c.height) + 1, 1);
+
+    if (c.cells == NULL || c.chars == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < l->verticesCount; i++) {
+        const Vertex * v = &l->vertices[i];
+
+        int top = l->top[v->layer];
+
+        if (v->node == NULL) {
+            canvas_line(&c, v->x, top, v->x, top + 2);
+        } else {
+            int right = v->x + v->w - 1;
+
+            canvas_line(&c, v->x,  top,     right, top);
+            canvas_line(&c, v->x,  top + 2, right, top + 2);
+            canvas_line(&c, v->x,  top,     v->x,  top + 2);
+            canvas_line(&c, right, top,     right, top + 2);
+
+            memcpy(&c.chars[(top + 1) * c.width + v->x + 2], v->node->name, strlen(v->node->name));
+        }
+    }
+
+    for (size_t i = 0; i < l->segmentsCount; i++) {
+        const Vertex * from = &l->vertices[l->segments[i].from];
+        const Vertex * to   = &l->vertices[l->segments[i].to];
+
+        int sx = center_of(from);
+        int tx = center_of(to);
+        int sy = l->top[from->layer] + 2;
+        int ey = to->node == NULL ? l->top[to->layer] : l->top[to->layer] - 1;
+
+        if (from->track < 0) {
+            canvas_line(&c, sx, sy, sx, ey);
+        } else {
+            int ty = l->top[from->layer] + 3 + from->track;
+
+            canvas_line(&c, sx, sy, sx, ty);
+            canvas_line(&c, sx, ty, tx, ty);
+            canvas_line(&c, tx, ty, tx, ey);
+        }
+
+        if (to->node != NULL) {
+            c.cells[ey * c.width + tx] |= CELL_ARROW;
+        }
+    }
+
+    for (int y = 0; y < c.height; y++) {
+        int end = c.width;
+
+        while (end > 0 && c.cells[y * c.width + end - 1] == 0 && c.chars[y * c.width + end - 1] == 0) end--;
+
+        for (int x = 0; x < end; x++) {
+            unsigned char cell = c.cells[y * c.width + x];
+            char          ch   = c.chars[y * c.width + x];
+
+            if (ch != 0) {
+                putchar(ch);
+            } else if (cell & CELL_ARROW) {
+                fputs("▼", stdout);
+            } else {
+                fputs(BOX_GLYPHS[cell & 15], stdout);
+            }
+        }
+
+        putchar('\n');
+    }
+
+    free(c.cells);
+    free(c.chars);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// one column is 8px wide, one row is 16px high, a line runs through the middle of its cells
+#define SVG_X(x) ((x) * 8 + 4)
+#define SVG_Y(y) ((y) * 16 + 8)
+
+static void print_xml_escaped(const char * s) {
+    for (; *s != '\0'; s++) {
+        switch (*s) {
+            case '&': fputs("&amp;", stdout); break;
+            case '<': fputs("&lt;",  stdout); break;
+            case '>': fputs("&gt;",  stdout); break;
+            case '"': fputs("&quot;", stdout); break;
+            default:  putchar(*s);
+        }
+    }
+}
+
+static void print_svg(const Layout * l) {
+    int width  = l->width  * 8;
+    int height = l->height * 16;
+
+    printf("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\" font-family=\"monospace\" font-size=\"13\">\n", width, height, width, height);
+    printf("<defs><marker id=\"arrow\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" markerWidth=\"8\" markerHeight=\"8\" orient=\"auto\"><path d=\"M 0 0 L 10 5 L 0 10 z\"/></marker></defs>\n");
+    printf("<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+    printf("<g fill=\"none\" stroke=\"black\">\n");
+
+    // an edge is drawn as one path from its package through the virtual vertices to its dependency
+    for (size_t i = 0; i < l->segmentsCount; i++) {
+        const Vertex * from = &l->vertices[l->segments[i].from];
+
+        if (from->node == NULL) continue;
+
+        printf("<path d=\"M %d %d", SVG_X(center_of(from)), SVG_Y(l->top[from->layer] + 2));
+
+        for (size_t j = i; ; j = l->vertices[l->segments[j].to].out) {
+            const Vertex * f = &l->vertices[l->segments[j].from];
+            const Vertex * t = &l->vertices[l->segments[j].to];
+
+            if (f->track >= 0) {
+                printf(" V %d H %d", SVG_Y(l->top[f->layer] + 3 + f->track), SVG_X(center_of(t)));
+            }
+
+            if (t->node != NULL) {
+                printf(" V %d\" marker-end=\"url(#arrow)\"/>\n", SVG_Y(l->top[t->layer]));
+                break;
+            }
+
+            printf(" V %d", SVG_Y(l->top[t->layer] + 2));
+        }
+    }
+
+    printf("</g>\n");
+
+    for (size_t i = 0; i < l->verticesCount; i++) {
+        const Vertex * v = &l->vertices[i];
+
+        if (v->node == NULL) continue;
+
+        int top = l->top[v->layer];
+
+        printf("<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" rx=\"4\" fill=\"white\" stroke=\"black\"/>\n", SVG_X(v->x), SVG_Y(top), (v->w - 1) * 8, 2 * 16);
+        printf("<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" dominant-baseline=\"central\">", v->x * 8 + v->w * 4, SVG_Y(top + 1));
+        print_xml_escaped(v->node->name);
+        printf("</text>\n");
+    }
+
+    printf("</svg>\n");
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int closure(int argc, char * argv[]) {
+    const char * copyTo = NULL;
+
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (starts_with(argv[i], "--copy-to=")) {
+            copyTo = argv[i] + 10;
+        } else {
+            break;
+        }
+    }
+
+    if (i == argc) {
+        fprintf(stderr, "Usage: formula-loader closure [--copy-to=<DIR>] <PACKAGE-NAME>..., <PACKAGE-NAME> is unspecified.\n");
+        return 1;
+    }
+
+    Graph graph = {0};
+
+    if (graph_load(&graph, argc - i, argv + i, copyTo, 1) != 0) {
+        return 1;
+    }
+
+    Node ** sorted = (Node**)calloc(graph.size + 1, sizeof(Node*));
+
+    if (sorted == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    if (graph_order(&graph, argc - i, argv + i, sorted) != 0) {
+        return 1;
+    }
+
+    // the order of every package is taken from the same graph, so that no formula is loaded again for it.
+    for (size_t j = 0; j < graph.size; j++) {
+        for (size_t k = 0; k < graph.size; k++) {
+            graph.items[k].state = 0;
+        }
+
+        memset(sorted, 0, (graph.size + 1) * sizeof(Node*));
+
+        char * name = graph.items[j].name;
+
+        if (graph_order(&graph, 1, &name, sorted) != 0) {
+            return 1;
+        }
+
+        StringBuffer sb = {0};
+
+        for (size_t k = 0; sorted[k] != NULL; k++) {
+            if (k > 0) sb_append_c(&sb, ' ');
+            sb_append(&sb, sorted[k]->name);
+        }
+
+        char * nameUppercaseUnderscore = uppercase_underscore(name);
+
+        print_assignment("ORDER_", nameUppercaseUnderscore, sb.buf == NULL ? "" : sb.buf);
+
+        free(nameUppercaseUnderscore);
+        free(sb.buf);
+    }
+
+    return 0;
+}
+
+static int order(int argc, char * argv[]) {
+    if (argc == 0) {
+        fprintf(stderr, "Usage: formula-loader order <PACKAGE-NAME>..., <PACKAGE-NAME> is unspecified.\n");
+        return 1;
+    }
+
+    Graph graph = {0};
+
+    if (graph_load(&graph, argc, argv, NULL, 0) != 0) {
+        return 1;
+    }
+
+    Node ** sorted = (Node**)calloc(graph.size + 1, sizeof(Node*));
+
+    if (sorted == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    if (graph_order(&graph, argc, argv, sorted) != 0) {
+        return 1;
+    }
+
+    for (size_t i = 0; sorted[i] != NULL; i++) {
+        puts(sorted[i]->name);
+    }
+
+    return 0;
+}
+
+static void print_artifact(const char * packageName, const char * sha, const char * url, const char * uri, const char * filepath) {
+    printf("%s|%s|%s|%s|%s\n", packageName, sha, url, uri == NULL ? "" : uri, filepath);
+}
+
+static int artifacts(int argc, char * argv[]) {
+    if (argc == 0) {
+        fprintf(stderr, "Usage: formula-loader artifacts <PACKAGE-NAME>..., <PACKAGE-NAME> is unspecified.\n");
+        return 1;
+    }
+
+    const char * downloadsDir = getenv("PPKG_DOWNLOADS_DIR");
+
+    if (downloadsDir == NULL) {
+        downloadsDir = "";
+    }
+
+    for (int i = 0; i < argc; i++) {
+        char * filepath = path_of_formula(argv[i]);
+
+        if (filepath == NULL) {
+            fprintf(stderr, "package '%s' is not available.\n", argv[i]);
+            return 1;
+        }
+
+        Formula formula;
+
+        if (load_formula(&formula, argv[i], filepath) != 0) {
+            return 1;
+        }
+
+        free(filepath);
+
+        const char * const * v = (const char * const *)formula.v;
+
+        // a git repository is cloned into the working directory of the build, dir:// and file:// are local.
+        if (v[SRC_URL][0] != '\0' && !starts_with(v[SRC_URL], "dir://") && !starts_with(v[SRC_URL], "file://")) {
+            print_artifact(argv[i], v[SRC_SHA], v[SRC_URL], v[SRC_URI], v[SRC_FILEPATH]);
+        }
+
+        if (v[FIX_URL][0] != '\0') {
+            print_artifact(argv[i], v[FIX_SHA], v[FIX_URL], v[FIX_URI], v[FIX_FILEPATH]);
+        }
+
+        if (v[RES_URL][0] != '\0') {
+            print_artifact(argv[i], v[RES_SHA], v[RES_URL], v[RES_URI], v[RES_FILEPATH]);
+        }
+
+        // <SHA256>|<URL>|[URI]|...
+        for (int k = 0; k < 2; k++) {
+            const char * list = k == 0 ? v[PATCHES] : v[RESLIST];
+
+            char line[4096];
+
+            for (const char * p = list; (p = next_word(p, line, sizeof(line))) != NULL; ) {
+                char * url = strchr(line, '|');
+
+                if (url == NULL) continue;
+
+                *url++ = '\0';
+
+                char * uri = strchr(url, '|');
+
+                if (uri != NULL) {
+                    *uri++ = '\0';
+
+                    char * end = strchr(uri, '|');
+
+                    if (end != NULL) *end = '\0';
+                }
+
+                char * filetype = filetype_from_url(url);
+                char * filename = strdup3(line, filetype, "");
+                char * path     = strdup3(downloadsDir, "/", filename);
+
+                print_artifact(argv[i], line, url, uri, path);
+
+                free(filetype);
+                free(filename);
+                free(path);
+            }
+        }
+
+        free_formula(&formula);
+    }
+
+    return 0;
+}
+
+static int graph(int argc, char * argv[]) {
+    const char * type = "box";
+
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (starts_with(argv[i], "--type=")) {
+            type = argv[i] + 7;
+        } else {
+            break;
+        }
+    }
+
+    if (strcmp(type, "box") != 0 && strcmp(type, "dot") != 0 && strcmp(type, "d2") != 0 && strcmp(type, "svg") != 0) {
+        fprintf(stderr, "Usage: formula-loader graph [--type=<box|dot|d2|svg>] <PACKAGE-NAME>..., unsupported type: %s\n", type);
+        return 1;
+    }
+
+    if (i == argc) {
+        fprintf(stderr, "Usage: formula-loader graph [--type=<box|dot|d2|svg>] <PACKAGE-NAME>..., <PACKAGE-NAME> is unspecified.\n");
+        return 1;
+    }
+
+    Graph graph = {0};
+
+    if (graph_load(&graph, argc - i, argv + i, NULL, 0) != 0) {
+        return 1;
+    }
+
+    Node ** sorted = (Node**)calloc(graph.size + 1, sizeof(Node*));
+
+    if (sorted == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    if (graph_order(&graph, argc - i, argv + i, sorted) != 0) {
+        return 1;
+    }
+
+    if (strcmp(type, "dot") == 0) {
+        printf("digraph G {\n");
+
+        for (size_t j = 0; j < graph.size; j++) {
+            if (graph.items[j].depsCount == 0) continue;
+
+            printf("    \"%s\" -> { ", graph.items[j].name);
+
+            for (size_t k = 0; k < graph.items[j].depsCount; k++) {
+                printf("\"%s\" ", graph.items[j].deps[k]);
+            }
+
+            printf("}\n");
+        }
+
+        printf("}\n");
+        return 0;
+    }
+
+    if (strcmp(type, "d2") == 0) {
+        for (size_t j = 0; j < graph.size; j++) {
+            for (size_t k = 0; k < graph.items[j].depsCount; k++) {
+                printf("%s -> %s\n", graph.items[j].name, graph.items[j].deps[k]);
+            }
+        }
+
+        return 0;
+    }
+
+    Layout layout;
+
+    graph_layout(&graph, sorted, &layout);
+
+    if (strcmp(type, "svg") == 0) {
+        print_svg(&layout);
+    } else {
+        print_box(&layout);
+    }
+
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <load|closure|order|graph|artifacts> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    int ret;
+
+    if (strcmp(argv[1], "load") == 0) {
+        ret = load(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "closure") == 0) {
+        ret = closure(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "order") == 0) {
+        ret = order(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "graph") == 0) {
+        ret = graph(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "artifacts") == 0) {
+        ret = artifacts(argc - 2, argv + 2);
+    } else {
+        fprintf(stderr, "unrecognized action: %s\n", argv[1]);
+        return 1;
+    }
+
+    if (ret == 0 && (fflush(stdout) != 0 || ferror(stdout))) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,1790 @@
+#ifndef PPKG_FORMULA_H
+#define PPKG_FORMULA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "sha256.h"
+#include "util.h"
+
+// shared by formula-loader.c, formula-index.c and installed-db.c, the generic helpers are in util.h
+//
+// environment variables read by the functions in this file:
+// PPKG_FORMULA_SEARCH_DIRS
+// PPKG_FORMULA_REPO_ROOT
+// PPKG_DOWNLOADS_DIR
+// TARGET_PLATFORM_NAME
+// TIMESTAMP_UNIX
+
+/////////////////////////////////////////////////////////////////
+
+// a formula is a flat YAML mapping whose values are all scalars.
+// the value of every key is what `yq '.<KEY> | select(. != null)'` would print, with the trailing newlines removed.
+
+// set it to 1 to suppress the messages of malformed formulas
+static int formulaQuiet = 0;
+
+#define FORMULA_ERROR(...) do { if (!formulaQuiet) { fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } } while (0)
+
+typedef struct {
+    char * key;
+    char * value;
+} Mapping;
+
+typedef struct {
+    Mapping * items;
+    size_t    size;
+    size_t    capacity;
+    char *    buf;      // the file content, every key points into it
+} Mappings;
+
+typedef struct {
+    char ** lines;
+    size_t  count;
+    char *  buf;    // the file content, every line points into it
+} Lines;
+
+static int read_lines(const char * filepath, Lines * lines) {
+    FILE * file = fopen(filepath, "r");
+
+    if (file == NULL) {
+        perror(filepath);
+        return 1;
+    }
+
+    StringBuffer content = {0};
+
+    char buf[4096];
+
+    for (;;) {
+        size_t n = fread(buf, 1, sizeof(buf), file);
+
+        if (n > 0) {
+            sb_append_n(&content, buf, n);
+        }
+
+        if (n < sizeof(buf)) {
+            if (ferror(file)) {
+                perror(filepath);
+                fclose(file);
+                free(content.buf);
+                return 1;
+            }
+            break;
+        }
+    }
+
+    fclose(file);
+
+    char * p = sb_take(&content);
+
+    lines->buf = p;
+
+    size_t count = 1;
+
+    for (char * q = p; *q != '\0'; q++) {
+        if (*q == '\n') count++;
+    }
+
+    lines->lines = (char**)calloc(count + 1, sizeof(char*));
+
+    if (lines->lines == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    lines->count = 0;
+
+    for (;;) {
+        char * q = strchr(p, '\n');
+
+        if (q != NULL) {
+            *q = '\0';
+        }
+
+        size_t n = strlen(p);
+
+        if (n > 0 && p[n - 1] == '\r') {
+            p[n - 1] = '\0';
+        }
+
+        if (q == NULL) {
+            if (p[0] != '\0') {
+                lines->lines[lines->count++] = p;
+            }
+            break;
+        }
+
+        lines->lines[lines->count++] = p;
+
+        p = q + 1;
+    }
+
+    return 0;
+}
+
+static size_t indent_of(const char * line) {
+    size_t i = 0;
+    while (line[i] == ' ') i++;
+    return i;
+}
+
+static void rtrim(StringBuffer * sb) {
+    while (sb->len > 0 && (sb->buf[sb->len - 1] == ' ' || sb->buf[sb->len - 1] == '\t')) {
+        sb->buf[--sb->len] = '\0';
+    }
+}
+
+static void chomp(char * s) {
+    size_t n = strlen(s);
+    while (n > 0 && s[n - 1] == '\n') s[--n] = '\0';
+}
+
+// fold the continuation lines of a multi-line flow scalar, YAML spec 6.5 Line Folding
+static void fold_line(StringBuffer * sb, const char * line, int * emptyLines) {
+    while (*line == ' ' || *line == '\t') line++;
+
+    if (*line == '\0') {
+        (*emptyLines)++;
+        return;
+    }
+
+    if (sb->len > 0) {
+        if (*emptyLines == 0) {
+            sb_append_c(sb, ' ');
+        } else {
+            for (int i = 0; i < *emptyLines; i++) {
+                sb_append_c(sb, '\n');
+            }
+        }
+    }
+
+    *emptyLines = 0;
+
+    sb_append(sb, line);
+}
+
+static int parse_yaml(const char * filepath, Mappings * mappings) {
+    Lines lines = {0};
+
+    if (read_lines(filepath, &lines) != 0) {
+        return 1;
+    }
+
+    mappings->size = 0;
+
+    for (size_t i = 0; i < lines.count; i++) {
+        char * line = lines.lines[i];
+
+        if (is_blank(line)) {
+            continue;
+        }
+
+        if (line[indent_of(line)] == '#') {
+            continue;
+        }
+
+        if (strcmp(line, "---") == 0 || starts_with(line, "--- ") || strcmp(line, "...") == 0) {
+            continue;
+        }
+
+        if (line[0] == ' ' || line[0] == '\t') {
+            FORMULA_ERROR("%s:%zu: unexpected indentation.", filepath, i + 1);
+            return 1;
+        }
+
+        /////////////////////////////////////////////////////////////////
+
+        char * colon = NULL;
+
+        for (char * p = line; *p != '\0'; p++) {
+            if (*p == ':' && (p[1] == ' ' || p[1] == '\t' || p[1] == '\0')) {
+                colon = p;
+                break;
+            }
+
+            if (*p == ' ' || *p == '\t' || *p == '#') {
+                break;
+            }
+        }
+
+        if (colon == NULL || colon == line) {
+            FORMULA_ERROR("%s:%zu: not a 'key: value' mapping.", filepath, i + 1);
+            return 1;
+        }
+
+        *colon = '\0';
+
+        char * key = line;
+
+        for (size_t j = 0; j < mappings->size; j++) {
+            if (strcmp(mappings->items[j].key, key) == 0) {
+                FORMULA_ERROR("%s:%zu: mapping key \"%s\" already defined.", filepath, i + 1, key);
+                return 1;
+            }
+        }
+
+        char * rest = colon + 1;
+
+        while (*rest == ' ' || *rest == '\t') rest++;
+
+        /////////////////////////////////////////////////////////////////
+
+        StringBuffer sb = {0};
+
+        int isNull = 0;
+
+        if (rest[0] == '|' || rest[0] == '>') {
+            int literal = rest[0] == '|';
+
+            size_t blockIndent = 0;
+
+            for (char * p = rest + 1; *p != '\0' && *p != ' ' && *p != '\t'; p++) {
+                if (*p >= '1' && *p <= '9') {
+                    blockIndent = (size_t)(*p - '0');
+                } else if (*p != '-' && *p != '+') {
+                    FORMULA_ERROR("%s:%zu: invalid block scalar header.", filepath, i + 1);
+                    return 1;
+                }
+            }
+
+            int emptyLines = 0;
+            int moreIndented = 0;
+
+            size_t j = i + 1;
+
+            for (; j < lines.count; j++) {
+                char * next = lines.lines[j];
+
+                size_t n = indent_of(next);
+
+                if (next[n] == '\0') {
+                    emptyLines++;
+                    continue;
+                }
+
+                if (blockIndent == 0) {
+                    if (n == 0) break;
+                    blockIndent = n;
+                } else if (n < blockIndent) {
+                    break;
+                }
+
+                const char * content = next + blockIndent;
+
+                if (literal) {
+                    if (sb.len > 0 || emptyLines > 0) {
+                        for (int k = (sb.len > 0 ? 0 : 1); k <= emptyLines; k++) {
+                            sb_append_c(&sb, '\n');
+                        }
+                    }
+                } else {
+                    int indented = content[0] == ' ' || content[0] == '\t';
+
+                    if (sb.len > 0) {
+                        if (emptyLines == 0 && !indented && !moreIndented) {
+                            sb_append_c(&sb, ' ');
+                        } else {
+                            for (int k = (indented || moreIndented) ? 0 : 1; k <= emptyLines; k++) {
+                                sb_append_c(&sb, '\n');
+                            }
+                        }
+                    }
+
+                    moreIndented = indented;
+                }
+
+                emptyLines = 0;
+
+                sb_append(&sb, content);
+            }
+
+            i = j - 1;
+        } else if (rest[0] == '"' || rest[0] == '\'') {
+            char quote = rest[0];
+
+            char * p = rest + 1;
+
+            int closed = 0;
+
+            size_t j = i;
+
+            int emptyLines = 0;
+
+            StringBuffer lineBuf = {0};
+
+            for (;;) {
+                for (; *p != '\0'; p++) {
+                    if (*p == quote) {
+                        if (quote == '\'' && p[1] == '\'') {
+                            sb_append_c(&lineBuf, '\'');
+                            p++;
+                            continue;
+                        }
+
+                        closed = 1;
+                        p++;
+                        break;
+                    }
+
+                    if (quote == '"' && *p == '\\') {
+                        p++;
+
+                        switch (*p) {
+                            case 'n':  sb_append_c(&lineBuf, '\n'); break;
+                            case 't':  sb_append_c(&lineBuf, '\t'); break;
+                            case 'r':  sb_append_c(&lineBuf, '\r'); break;
+                            case '0':  break;
+                            case '\0': p--; break;
+                            default:   sb_append_c(&lineBuf, *p);
+                        }
+
+                        continue;
+                    }
+
+                    sb_append_c(&lineBuf, *p);
+                }
+
+                if (closed) {
+                    if (j == i) {
+                        sb_append(&sb, lineBuf.buf == NULL ? "" : lineBuf.buf);
+                    } else {
+                        fold_line(&sb, lineBuf.buf == NULL ? "" : lineBuf.buf, &emptyLines);
+                    }
+                    break;
+                }
+
+                if (j == i) {
+                    rtrim(&lineBuf);
+                    sb_append(&sb, lineBuf.buf == NULL ? "" : lineBuf.buf);
+                } else {
+                    rtrim(&lineBuf);
+                    fold_line(&sb, lineBuf.buf == NULL ? "" : lineBuf.buf, &emptyLines);
+                }
+
+                lineBuf.len = 0;
+
+                if (lineBuf.buf != NULL) {
+                    lineBuf.buf[0] = '\0';
+                }
+
+                j++;
+
+                if (j >= lines.count) {
+                    FORMULA_ERROR("%s:%zu: unterminated quoted scalar.", filepath, i + 1);
+                    return 1;
+                }
+
+                p = lines.lines[j];
+            }
+
+            free(lineBuf.buf);
+
+            while (*p == ' ' || *p == '\t') p++;
+
+            if (*p != '\0' && *p != '#') {
+                FORMULA_ERROR("%s:%zu: unexpected characters after quoted scalar.", filepath, j + 1);
+                return 1;
+            }
+
+            i = j;
+        } else {
+            // plain scalar, might be continued on the following more indented lines.
+
+            char * p = rest;
+
+            for (; *p != '\0'; p++) {
+                if (*p == '#' && (p == rest || p[-1] == ' ' || p[-1] == '\t')) {
+                    break;
+                }
+            }
+
+            sb_append_n(&sb, rest, (size_t)(p - rest));
+            rtrim(&sb);
+
+            int emptyLines = 0;
+
+            size_t j = i + 1;
+            size_t k = i;
+
+            for (; j < lines.count; j++) {
+                char * next = lines.lines[j];
+
+                size_t n = indent_of(next);
+
+                if (next[n] == '\0') {
+                    emptyLines++;
+                    continue;
+                }
+
+                if (n == 0) break;
+
+                if (next[n] == '#') {
+                    k = j;
+                    continue;
+                }
+
+                StringBuffer lineBuf = {0};
+
+                char * q = next + n;
+
+                for (p = q; *p != '\0'; p++) {
+                    if (*p == '#' && (p[-1] == ' ' || p[-1] == '\t')) {
+                        break;
+                    }
+                }
+
+                sb_append_n(&lineBuf, q, (size_t)(p - q));
+                rtrim(&lineBuf);
+
+                fold_line(&sb, lineBuf.buf, &emptyLines);
+
+                free(lineBuf.buf);
+
+                k = j;
+            }
+
+            i = k;
+
+            if (sb.len == 0 || strcmp(sb.buf, "~") == 0 || strcmp(sb.buf, "null") == 0 || strcmp(sb.buf, "Null") == 0 || strcmp(sb.buf, "NULL") == 0) {
+                isNull = 1;
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////
+
+        if (mappings->size == mappings->capacity) {
+            size_t capacity = mappings->capacity == 0 ? 64 : mappings->capacity << 1;
+
+            Mapping * p = (Mapping*)realloc(mappings->items, capacity * sizeof(Mapping));
+
+            if (p == NULL) {
+                perror(NULL);
+                return 1;
+            }
+
+            mappings->items = p;
+            mappings->capacity = capacity;
+        }
+
+        char * value = sb_take(&sb);
+
+        if (isNull) {
+            value[0] = '\0';
+        } else {
+            chomp(value);
+        }
+
+        mappings->items[mappings->size].key   = key;
+        mappings->items[mappings->size].value = value;
+        mappings->size++;
+    }
+
+    free(lines.lines);
+
+    mappings->buf = lines.buf;
+
+    return 0;
+}
+
+static void free_mappings(Mappings * mappings) {
+    for (size_t i = 0; i < mappings->size; i++) {
+        free(mappings->items[i].value);
+    }
+
+    free(mappings->items);
+    free(mappings->buf);
+
+    memset(mappings, 0, sizeof(Mappings));
+}
+
+static const char * lookup(const Mappings * mappings, const char * key) {
+    for (size_t i = 0; i < mappings->size; i++) {
+        if (strcmp(mappings->items[i].key, key) == 0) {
+            return mappings->items[i].value;
+        }
+    }
+    return "";
+}
+
+/////////////////////////////////////////////////////////////////
+
+enum {
+    PKGTYPE, SUMMARY, LICENSE, VERSION, WEB_URL,
+    GIT_URL, GIT_SHA, GIT_REF, GIT_NTH,
+    SRC_URL, SRC_URI, SRC_SHA,
+    FIX_URL, FIX_URI, FIX_SHA, FIX_OPT,
+    RES_URL, RES_URI, RES_SHA,
+    DEP_PKG, DEP_UPP, DEP_PYM, DEP_PLM,
+    BSYSTEM, BSCRIPT, BINBSTD,
+    CCFLAGS, XXFLAGS, PPFLAGS, LDFLAGS,
+    ONSTART, ONREADY, ONFINAL,
+    DO12345, DOPATCH, PREPARE, DOBUILD, DOTWEAK,
+    PATCHES, RESLIST, CAVEATS, PARALLEL, DEVELOPER,
+
+    VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH, VERSION_TWEAK,
+    SRC_FILENAME, SRC_FILETYPE, SRC_FILEPATH,
+    FIX_FILENAME, FIX_FILETYPE, FIX_FILEPATH,
+    RES_FILENAME, RES_FILETYPE, RES_FILEPATH,
+    NEED_CURL, NEED_BTAR,
+    BSYSTEM_MASTER,
+    USE_BSYSTEM_WAF, USE_BSYSTEM_GO, USE_BSYSTEM_RAKE, USE_BSYSTEM_NINJA,
+    USE_BSYSTEM_GMAKE, USE_BSYSTEM_CMAKE, USE_BSYSTEM_XMAKE, USE_BSYSTEM_MESON,
+    USE_BSYSTEM_CARGO, USE_BSYSTEM_AUTOGENSH, USE_BSYSTEM_AUTOTOOLS, USE_BSYSTEM_CONFIGURE,
+
+    FIELD_COUNT
+};
+
+// the first column is the mapping key in formula, the second column is the shell variable name without PACKAGE_ prefix
+static const char * const FIELDS[FIELD_COUNT][2] = {
+    { "pkgtype",   "PKGTYPE" },
+    { "summary",   "SUMMARY" },
+    { "license",   "LICENSE" },
+    { "version",   "VERSION" },
+    { "web-url",   "WEB_URL" },
+    { "git-url",   "GIT_URL" },
+    { "git-sha",   "GIT_SHA" },
+    { "git-ref",   "GIT_REF" },
+    { "git-nth",   "GIT_NTH" },
+    { "src-url",   "SRC_URL" },
+    { "src-uri",   "SRC_URI" },
+    { "src-sha",   "SRC_SHA" },
+    { "fix-url",   "FIX_URL" },
+    { "fix-uri",   "FIX_URI" },
+    { "fix-sha",   "FIX_SHA" },
+    { "fix-opt",   "FIX_OPT" },
+    { "res-url",   "RES_URL" },
+    { "res-uri",   "RES_URI" },
+    { "res-sha",   "RES_SHA" },
+    { "dep-pkg",   "DEP_PKG" },
+    { "dep-upp",   "DEP_UPP" },
+    { "dep-pym",   "DEP_PYM" },
+    { "dep-plm",   "DEP_PLM" },
+    { "bsystem",   "BSYSTEM" },
+    { "bscript",   "BSCRIPT" },
+    { "binbstd",   "BINBSTD" },
+    { "ccflags",   "CCFLAGS" },
+    { "xxflags",   "XXFLAGS" },
+    { "ppflags",   "PPFLAGS" },
+    { "ldflags",   "LDFLAGS" },
+    { "onstart",   "ONSTART" },
+    { "onready",   "ONREADY" },
+    { "onfinal",   "ONFINAL" },
+    { "do12345",   "DO12345" },
+    { "dopatch",   "DOPATCH" },
+    { "prepare",   "PREPARE" },
+    { "install",   "DOBUILD" },
+    { "dotweak",   "DOTWEAK" },
+    { "patches",   "PATCHES" },
+    { "reslist",   "RESLIST" },
+    { "caveats",   "CAVEATS" },
+    { "parallel",  "PARALLEL" },
+    { "developer", "DEVELOPER" },
+
+    { NULL, "VERSION_MAJOR" },
+    { NULL, "VERSION_MINOR" },
+    { NULL, "VERSION_PATCH" },
+    { NULL, "VERSION_TWEAK" },
+    { NULL, "SRC_FILENAME" },
+    { NULL, "SRC_FILETYPE" },
+    { NULL, "SRC_FILEPATH" },
+    { NULL, "FIX_FILENAME" },
+    { NULL, "FIX_FILETYPE" },
+    { NULL, "FIX_FILEPATH" },
+    { NULL, "RES_FILENAME" },
+    { NULL, "RES_FILETYPE" },
+    { NULL, "RES_FILEPATH" },
+    { NULL, "NEED_CURL" },
+    { NULL, "NEED_BTAR" },
+    { NULL, "BSYSTEM_MASTER" },
+    { NULL, "USE_BSYSTEM_WAF" },
+    { NULL, "USE_BSYSTEM_GO" },
+    { NULL, "USE_BSYSTEM_RAKE" },
+    { NULL, "USE_BSYSTEM_NINJA" },
+    { NULL, "USE_BSYSTEM_GMAKE" },
+    { NULL, "USE_BSYSTEM_CMAKE" },
+    { NULL, "USE_BSYSTEM_XMAKE" },
+    { NULL, "USE_BSYSTEM_MESON" },
+    { NULL, "USE_BSYSTEM_CARGO" },
+    { NULL, "USE_BSYSTEM_AUTOGENSH" },
+    { NULL, "USE_BSYSTEM_AUTOTOOLS" },
+    { NULL, "USE_BSYSTEM_CONFIGURE" },
+};
+
+typedef struct {
+    char * name;
+    char * nameUppercaseUnderscore;
+    char * filepath;
+    char * v[FIELD_COUNT];
+} Formula;
+
+/////////////////////////////////////////////////////////////////
+
+static char * uppercase_underscore(const char * s) {
+    char * p = strdup2(s);
+
+    for (char * q = p; *q != '\0'; q++) {
+        switch (*q) {
+            case '@':
+            case '+':
+            case ',':
+            case '-':
+            case '.': *q = '_'; break;
+            default:  *q = (char)toupper((unsigned char)*q);
+        }
+    }
+
+    return p;
+}
+
+// same as filetype_from_url() in ppkg
+static char * filetype_from_url(const char * url) {
+    size_t n = strcspn(url, "?");
+
+    const char * fname = url;
+
+    for (size_t i = 0; i < n; i++) {
+        if (url[i] == '/') fname = url + i + 1;
+    }
+
+    char * s = (char*)calloc(n + 2, 1);
+
+    if (s == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    memcpy(s, fname, n - (size_t)(fname - url));
+
+    static const char * const table[][2] = {
+        { ".tar.gz",  ".tgz"  }, { ".tgz",  ".tgz"  },
+        { ".tar.lz",  ".tlz"  }, { ".tlz",  ".tlz"  },
+        { ".tar.xz",  ".txz"  }, { ".txz",  ".txz"  },
+        { ".tar.bz2", ".tbz2" }, { ".tbz2", ".tbz2" },
+    };
+
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if (ends_with(s, table[i][0])) {
+            strcpy(s, table[i][1]);
+            return s;
+        }
+    }
+
+    char * dot = strrchr(s, '.');
+
+    if (dot == NULL) {
+        s[0] = '\0';
+    } else {
+        memmove(s, dot, strlen(dot) + 1);
+    }
+
+    return s;
+}
+
+static int is_archive_filetype(const char * filetype) {
+    static const char * const archives[] = { ".zip", ".txz", ".tgz", ".tlz", ".tbz2", ".crate" };
+
+    for (size_t i = 0; i < sizeof(archives) / sizeof(archives[0]); i++) {
+        if (strcmp(filetype, archives[i]) == 0) return 1;
+    }
+
+    return 0;
+}
+
+// basename(1)
+static char * basename2(const char * path) {
+    char * s = strdup2(path);
+
+    size_t n = strlen(s);
+
+    while (n > 1 && s[n - 1] == '/') s[--n] = '\0';
+
+    char * slash = strrchr(s, '/');
+
+    if (slash != NULL && slash[1] != '\0') {
+        memmove(s, slash + 1, strlen(slash + 1) + 1);
+    }
+
+    return s;
+}
+
+static void remove_suffix(char * s, const char * suffix) {
+    if (ends_with(s, suffix)) {
+        s[strlen(s) - strlen(suffix)] = '\0';
+    }
+}
+
+static void remove_first(char * s, const char * needle) {
+    char * p = strstr(s, needle);
+
+    if (p != NULL) {
+        size_t n = strlen(needle);
+        memmove(p, p + n, strlen(p + n) + 1);
+    }
+}
+
+// same as the version guessing pipeline used in __load_formula_of_the_given_package
+static char * version_from_url(const char * url) {
+    char * s = basename2(url);
+
+    for (char * p = s; *p != '\0'; p++) {
+        if (*p == '_' || *p == '@') *p = '-';
+    }
+
+    static const char * const suffixes[] = { ".tar.gz", ".tar.lz", ".tar.xz" };
+
+    for (size_t i = 0; i < 3; i++) {
+        if (ends_with(s, suffixes[i])) {
+            remove_suffix(s, suffixes[i]);
+            break;
+        }
+    }
+
+    remove_suffix(s, ".tar.bz2");
+
+    static const char * const suffixes2[] = { ".tgz", ".tlz", ".txz" };
+
+    for (size_t i = 0; i < 3; i++) {
+        if (ends_with(s, suffixes2[i])) {
+            remove_suffix(s, suffixes2[i]);
+            break;
+        }
+    }
+
+    remove_suffix(s, ".zip");
+    remove_first(s, "-stable");
+    remove_first(s, "-source");
+
+    if (ends_with(s, "-src")) {
+        remove_suffix(s, "-src");
+    } else {
+        remove_suffix(s, ".src");
+    }
+
+    remove_first(s, ".orig");
+
+    char * dash = strrchr(s, '-');
+
+    if (dash != NULL) {
+        memmove(s, dash + 1, strlen(dash + 1) + 1);
+    }
+
+    return s;
+}
+
+// cut -d. -f<N>
+static char * version_field(const char * version, int n) {
+    if (strchr(version, '.') == NULL) {
+        return strdup2(version);
+    }
+
+    const char * p = version;
+
+    for (int i = 1; i < n; i++) {
+        p = strchr(p, '.');
+
+        if (p == NULL) {
+            return strdup2("");
+        }
+
+        p++;
+    }
+
+    size_t len = strcspn(p, ".");
+
+    char * s = strdup2(p);
+    s[len] = '\0';
+    return s;
+}
+
+// the weight of the character at the given position, the same as filevercmp of gnulib.
+static int version_char_order(const char * s, size_t pos, size_t len) {
+    if (pos == len) return -1;
+
+    unsigned char c = (unsigned char)s[pos];
+
+    if (isdigit(c)) return 0;
+    if (isalpha(c)) return c;
+    if (c == '~')   return -2;
+
+    return c + 256;
+}
+
+static int version_revcmp(const char * a, size_t aLen, const char * b, size_t bLen) {
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < aLen || j < bLen) {
+        int firstDiff = 0;
+
+        while ((i < aLen && !isdigit((unsigned char)a[i])) || (j < bLen && !isdigit((unsigned char)b[j]))) {
+            int x = version_char_order(a, i, aLen);
+            int y = version_char_order(b, j, bLen);
+
+            if (x != y) return x - y;
+
+            i++;
+            j++;
+        }
+
+        while (i < aLen && a[i] == '0') i++;
+        while (j < bLen && b[j] == '0') j++;
+
+        while (i < aLen && j < bLen && isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            if (firstDiff == 0) firstDiff = a[i] - b[j];
+            i++;
+            j++;
+        }
+
+        if (i < aLen && isdigit((unsigned char)a[i])) return 1;
+        if (j < bLen && isdigit((unsigned char)b[j])) return -1;
+        if (firstDiff != 0) return firstDiff;
+    }
+
+    return 0;
+}
+
+// the length of s without its longest suffix matching (\.[A-Za-z~][A-Za-z0-9~]*)*$
+static size_t version_prefix_length(const char * s, size_t len) {
+    size_t prefixLen = 0;
+
+    for (size_t i = 0; ; ) {
+        while (i + 1 < len && s[i] == '.' && (isalpha((unsigned char)s[i + 1]) || s[i + 1] == '~')) {
+            for (i += 2; i < len && (isalnum((unsigned char)s[i]) || s[i] == '~'); i++) ;
+        }
+
+        if (i >= len) return prefixLen;
+
+        prefixLen = ++i;
+    }
+}
+
+// compare two versions in the order of sort -V, returns a negative integer, zero or a positive integer as a is less than, equal to or greater than b.
+static inline int compare_version(const char * a, const char * b) {
+    int ret;
+
+    size_t aLen = strlen(a);
+    size_t bLen = strlen(b);
+
+    if (aLen == 0 || bLen == 0) {
+        ret = (aLen != 0) - (bLen != 0);
+    } else if (a[0] == '.' || b[0] == '.') {
+        if (a[0] != '.') {
+            ret = 1;
+        } else if (b[0] != '.') {
+            ret = -1;
+        } else if (aLen == 1 || bLen == 1) {
+            ret = (aLen != 1) - (bLen != 1);
+        } else if (strcmp(a, "..") == 0 || strcmp(b, "..") == 0) {
+            ret = (strcmp(a, "..") != 0) - (strcmp(b, "..") != 0);
+        } else {
+            ret = 0;
+        }
+    } else {
+        ret = 0;
+    }
+
+    if (ret == 0 && aLen != 0 && bLen != 0) {
+        size_t aPrefixLen = version_prefix_length(a, aLen);
+        size_t bPrefixLen = version_prefix_length(b, bLen);
+
+        ret = version_revcmp(a, aPrefixLen, b, bPrefixLen);
+
+        if (ret == 0 && (aPrefixLen != aLen || bPrefixLen != bLen)) {
+            ret = version_revcmp(a, aLen, b, bLen);
+        }
+    }
+
+    // sort falls back to compare bytes if the versions are equivalent
+    return ret != 0 ? ret : strcmp(a, b);
+}
+
+static char * today(void) {
+    time_t t;
+
+    const char * ts = getenv("TIMESTAMP_UNIX");
+
+    if (ts != NULL && ts[0] != '\0') {
+        t = (time_t)strtoll(ts, NULL, 10);
+    } else {
+        t = time(NULL);
+    }
+
+    struct tm tm;
+
+    if (gmtime_r(&t, &tm) == NULL) {
+        perror(NULL);
+        exit(1);
+    }
+
+    char buf[32];
+
+    strftime(buf, sizeof(buf), "%Y.%m.%d", &tm);
+
+    return strdup2(buf);
+}
+
+static int is_ifs(char c) {
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+// iterate over the words of s which are separated by IFS
+static const char * next_word(const char * s, char * buf, size_t bufSize) {
+    while (is_ifs(*s)) s++;
+
+    if (*s == '\0') return NULL;
+
+    size_t n = 0;
+
+    while (*s != '\0' && !is_ifs(*s)) {
+        if (n + 1 < bufSize) buf[n++] = *s;
+        s++;
+    }
+
+    buf[n] = '\0';
+
+    return s;
+}
+
+static void append_word(char ** list, const char * word) {
+    char * p = strdup3(*list, " ", word);
+    free(*list);
+    *list = p;
+}
+
+/////////////////////////////////////////////////////////////////
+
+#define FAIL(...) do { FORMULA_ERROR(__VA_ARGS__); return 1; } while (0)
+
+static inline int load_formula(Formula * f, const char * name, const char * filepath) {
+    memset(f, 0, sizeof(Formula));
+
+    f->name = strdup2(name);
+    f->nameUppercaseUnderscore = uppercase_underscore(name);
+    f->filepath = strdup2(filepath);
+
+    Mappings mappings = {0};
+
+    if (parse_yaml(filepath, &mappings) != 0) {
+        return 1;
+    }
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        if (FIELDS[i][0] != NULL) {
+            f->v[i] = strdup2(lookup(&mappings, FIELDS[i][0]));
+        }
+    }
+
+    free_mappings(&mappings);
+
+    char ** v = f->v;
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[SUMMARY][0] == '\0') {
+        FAIL("summary mapping not found in %s", filepath);
+    }
+
+    if (v[FIX_URL][0] != '\0' && v[PATCHES][0] != '\0') {
+        FAIL("fix-url and patches mapping shouldn't be used together in %s", filepath);
+    }
+
+    if (v[RES_URL][0] != '\0' && v[RESLIST][0] != '\0') {
+        FAIL("res-url and reslist mapping shouldn't be used together in %s", filepath);
+    }
+
+    if (v[GIT_NTH][0] != '\0' && !is_integer(v[GIT_NTH])) {
+        FAIL("the value of git-nth mapping should be an integer.");
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    const char * downloadsDir = getenv("PPKG_DOWNLOADS_DIR");
+
+    if (downloadsDir == NULL) {
+        downloadsDir = "";
+    }
+
+    if (v[SRC_URL][0] != '\0') {
+        if (starts_with(v[SRC_URL], "dir://")) {
+            v[SRC_FILETYPE] = strdup2(".dir");
+            v[SRC_FILEPATH] = strdup2(v[SRC_URL] + 6);
+
+            if (v[VERSION][0] == '\0') {
+                v[VERSION] = today();
+            }
+        } else if (starts_with(v[SRC_URL], "file://")) {
+            v[SRC_FILEPATH] = strdup2(v[SRC_URL] + 7);
+            v[SRC_FILENAME] = basename2(v[SRC_FILEPATH]);
+            v[SRC_FILETYPE] = filetype_from_url(v[SRC_FILENAME]);
+
+            if (v[VERSION][0] == '\0') {
+                v[VERSION] = today();
+            }
+        } else {
+            v[SRC_FILETYPE] = filetype_from_url(v[SRC_URL]);
+            v[SRC_FILENAME] = strdup3(v[SRC_SHA], v[SRC_FILETYPE], "");
+            v[SRC_FILEPATH] = strdup3(downloadsDir, "/", v[SRC_FILENAME]);
+
+            if (v[SRC_SHA][0] == '\0') {
+                FAIL("src-sha mapping not found in %s", filepath);
+            }
+
+            if (v[GIT_URL][0] == '\0') {
+                const char * url = v[SRC_URL];
+
+                if (starts_with(url, "https://github.com/")) {
+                    const char * p = strstr(url + 19, "/releases/");
+
+                    if (p == NULL) {
+                        p = strstr(url + 19, "/archive/");
+                    }
+
+                    // https://github.com/*/*/releases/* requires at least two path components before
+                    if (p != NULL && memchr(url + 19, '/', (size_t)(p - url - 19)) != NULL) {
+                        v[GIT_URL] = strdup2(url);
+                        v[GIT_URL][p - url] = '\0';
+                    }
+                } else if (starts_with(url, "https://gitlab.com/")) {
+                    const char * p = strstr(url + 19, "/-/archive/");
+
+                    if (p != NULL && memchr(url + 19, '/', (size_t)(p - url - 19)) != NULL) {
+                        v[GIT_URL] = strdup2(url);
+                        v[GIT_URL][p - url] = '\0';
+                    }
+                }
+            }
+
+            if (v[VERSION][0] == '\0') {
+                v[VERSION] = version_from_url(v[SRC_URL]);
+
+                if (v[VERSION][0] == '\0') {
+                    FAIL("version mapping not found in %s", filepath);
+                }
+
+                if (v[VERSION][0] == 'v') {
+                    memmove(v[VERSION], v[VERSION] + 1, strlen(v[VERSION]));
+                }
+            }
+
+            v[NEED_CURL] = strdup2("1");
+
+            if (is_archive_filetype(v[SRC_FILETYPE])) {
+                v[NEED_BTAR] = strdup2("1");
+            }
+        }
+    } else if (v[GIT_URL][0] != '\0') {
+        v[SRC_FILETYPE] = strdup2(".git");
+
+        if (v[VERSION][0] == '\0') {
+            v[VERSION] = today();
+        }
+
+        append_word(&v[DEP_UPP], "git");
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[WEB_URL][0] == '\0' && v[GIT_URL][0] == '\0') {
+        FAIL("neither web-url nor git-url mapping was found in %s", filepath);
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    // fix-url and res-url check the filetype of src-url to decide whether bsdtar is needed, this is what ppkg always did.
+
+    if (v[FIX_URL][0] != '\0') {
+        if (v[FIX_SHA][0] == '\0') {
+            FAIL("fix-sha mapping not found in %s", filepath);
+        }
+
+        v[FIX_FILETYPE] = filetype_from_url(v[FIX_URL]);
+        v[FIX_FILENAME] = strdup3(v[FIX_SHA], v[FIX_FILETYPE], "");
+        v[FIX_FILEPATH] = strdup3(downloadsDir, "/", v[FIX_FILENAME]);
+
+        v[NEED_CURL] = strdup2("1");
+
+        if (v[SRC_FILETYPE] != NULL && is_archive_filetype(v[SRC_FILETYPE])) {
+            v[NEED_BTAR] = strdup2("1");
+        }
+    }
+
+    if (v[RES_URL][0] != '\0') {
+        if (v[RES_SHA][0] == '\0') {
+            FAIL("res-sha mapping not found in %s", filepath);
+        }
+
+        v[RES_FILETYPE] = filetype_from_url(v[RES_URL]);
+        v[RES_FILENAME] = strdup3(v[RES_SHA], v[RES_FILETYPE], "");
+        v[RES_FILEPATH] = strdup3(downloadsDir, "/", v[RES_FILENAME]);
+
+        v[NEED_CURL] = strdup2("1");
+
+        if (v[SRC_FILETYPE] != NULL && is_archive_filetype(v[SRC_FILETYPE])) {
+            v[NEED_BTAR] = strdup2("1");
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    for (int k = 0; k < 2; k++) {
+        const char * list = k == 0 ? v[PATCHES] : v[RESLIST];
+
+        char line[4096];
+
+        for (const char * p = list; (p = next_word(p, line, sizeof(line))) != NULL; ) {
+            char * bar = strchr(line, '|');
+
+            char * url;
+
+            if (bar == NULL) {
+                url = line;
+            } else {
+                *bar = '\0';
+                url = bar + 1;
+
+                char * bar2 = strchr(url, '|');
+
+                if (bar2 != NULL) *bar2 = '\0';
+            }
+
+            if (strlen(line) != 64) {
+                if (bar != NULL) *bar = '|';
+                FAIL("not a sha256sum in line: %s in file: %s", line, filepath);
+            }
+
+            char * filetype = filetype_from_url(url);
+
+            v[NEED_CURL] = strdup2("1");
+
+            if (is_archive_filetype(filetype)) {
+                v[NEED_BTAR] = strdup2("1");
+            }
+
+            free(filetype);
+        }
+    }
+
+    if (v[NEED_CURL] != NULL) append_word(&v[DEP_UPP], "curl");
+    if (v[NEED_BTAR] != NULL) append_word(&v[DEP_UPP], "bsdtar");
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[VERSION][0] != '\0') {
+        v[VERSION_MAJOR] = version_field(v[VERSION], 1);
+        v[VERSION_MINOR] = version_field(v[VERSION], 2);
+        v[VERSION_PATCH] = version_field(v[VERSION], 3);
+        v[VERSION_TWEAK] = version_field(v[VERSION], 4);
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[BSYSTEM][0] == '\0') {
+        if (v[DOBUILD][0] == '\0') {
+            FAIL("neither bsystem nor install mapping was found in %s", filepath);
+        }
+
+        static const char * const table[][2] = {
+            { "configure", "configure" },
+            { "cmakew",    "cmake"     },
+            { "xmakew",    "xmake"     },
+            { "mesonw",    "meson"     },
+            { "gmakew",    "gmake"     },
+            { "cargow",    "cargo"     },
+            { "go",        "go"        },
+            { "gow",       "go"        },
+            { "waf",       "waf"       },
+        };
+
+        const char * found = NULL;
+
+        for (const char * line = v[DOBUILD]; found == NULL && line != NULL; ) {
+            const char * eol = strchr(line, '\n');
+
+            size_t n = eol == NULL ? strlen(line) : (size_t)(eol - line);
+
+            size_t i = 0;
+
+            while (i < n && isspace((unsigned char)line[i])) i++;
+
+            size_t m = i;
+
+            while (m < n && line[m] != ' ') m++;
+
+            char firstWord[1024];
+
+            if (m - i >= sizeof(firstWord)) m = i + sizeof(firstWord) - 1;
+
+            memcpy(firstWord, line + i, m - i);
+            firstWord[m - i] = '\0';
+
+            char word[1024];
+
+            for (const char * p = firstWord; found == NULL && (p = next_word(p, word, sizeof(word))) != NULL; ) {
+                for (size_t j = 0; j < sizeof(table) / sizeof(table[0]); j++) {
+                    if (strcmp(word, table[j][0]) == 0) {
+                        found = table[j][1];
+                        break;
+                    }
+                }
+            }
+
+            line = eol == NULL ? NULL : eol + 1;
+        }
+
+        if (found != NULL) {
+            free(v[BSYSTEM]);
+            v[BSYSTEM] = strdup2(found);
+        }
+    }
+
+    v[BSYSTEM_MASTER] = strdup2(v[BSYSTEM]);
+    v[BSYSTEM_MASTER][strcspn(v[BSYSTEM_MASTER], " ")] = '\0';
+
+    /////////////////////////////////////////////////////////////////
+
+    {
+        char word[1024];
+
+        for (const char * p = v[BSYSTEM]; (p = next_word(p, word, sizeof(word))) != NULL; ) {
+            int a = -1;
+            int b = -1;
+
+                 if (strcmp(word, "autogen")     == 0) { a = USE_BSYSTEM_AUTOGENSH; b = USE_BSYSTEM_GMAKE; }
+            else if (strcmp(word, "autotools")   == 0) { a = USE_BSYSTEM_AUTOTOOLS; b = USE_BSYSTEM_GMAKE; }
+            else if (strcmp(word, "configure")   == 0) { a = USE_BSYSTEM_CONFIGURE; b = USE_BSYSTEM_GMAKE; }
+            else if (strcmp(word, "cmake+gmake") == 0) { a = USE_BSYSTEM_CMAKE;     b = USE_BSYSTEM_GMAKE; }
+            else if (strcmp(word, "cmake+ninja") == 0) { a = USE_BSYSTEM_CMAKE;     b = USE_BSYSTEM_NINJA; }
+            else if (strcmp(word, "cmake")       == 0) { a = USE_BSYSTEM_CMAKE;     b = USE_BSYSTEM_NINJA; }
+            else if (strcmp(word, "xmake")       == 0) { a = USE_BSYSTEM_XMAKE;     }
+            else if (strcmp(word, "meson")       == 0) { a = USE_BSYSTEM_MESON;     b = USE_BSYSTEM_NINJA; }
+            else if (strcmp(word, "ninja")       == 0) { a = USE_BSYSTEM_NINJA;     }
+            else if (strcmp(word, "gmake")       == 0) { a = USE_BSYSTEM_GMAKE;     }
+            else if (strcmp(word, "rake")        == 0) { a = USE_BSYSTEM_RAKE;      }
+            else if (strcmp(word, "cargo")       == 0) { a = USE_BSYSTEM_CARGO;     }
+            else if (strcmp(word, "go")          == 0) { a = USE_BSYSTEM_GO;        }
+            else if (strcmp(word, "waf")         == 0) { a = USE_BSYSTEM_WAF;       }
+
+            if (a != -1 && v[a] == NULL) v[a] = strdup2("1");
+            if (b != -1 && v[b] == NULL) v[b] = strdup2("1");
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[DOBUILD][0] == '\0') {
+        const char * m = v[BSYSTEM_MASTER];
+        const char * s = NULL;
+
+             if (strcmp(m, "autogen")   == 0) s = "configure";
+        else if (strcmp(m, "autotools") == 0) s = "configure";
+        else if (strcmp(m, "configure") == 0) s = "configure";
+        else if (starts_with(m, "cmake"))     s = "cmakew";
+        else if (strcmp(m, "xmake")     == 0) s = "xmakew";
+        else if (strcmp(m, "meson")     == 0) s = "mesonw";
+        else if (strcmp(m, "ninja")     == 0) s = "ninjaw clean && ninjaw && ninjaw install";
+        else if (strcmp(m, "gmake")     == 0) s = "gmakew clean && gmakew && gmakew install";
+        else if (strcmp(m, "cargo")     == 0) s = "cargow install";
+        else if (strcmp(m, "go")        == 0) s = "gow";
+        else if (strcmp(m, "waf")       == 0) s = "waf";
+
+        if (s != NULL) {
+            free(v[DOBUILD]);
+            v[DOBUILD] = strdup2(s);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[FIX_URL][0] != '\0' || v[PATCHES][0] != '\0') {
+        append_word(&v[DEP_UPP], "patch");
+    }
+
+    if (v[DEP_PYM][0] != '\0') append_word(&v[DEP_UPP], "python3");
+    if (v[DEP_PLM][0] != '\0') append_word(&v[DEP_UPP], "perl gmake");
+
+    if (v[USE_BSYSTEM_AUTOGENSH] != NULL) append_word(&v[DEP_UPP], "gmake gm4 perl autoconf automake");
+    if (v[USE_BSYSTEM_AUTOTOOLS] != NULL) append_word(&v[DEP_UPP], "gmake gm4 perl autoconf automake");
+    if (v[USE_BSYSTEM_CONFIGURE] != NULL) append_word(&v[DEP_UPP], "gmake");
+    if (v[USE_BSYSTEM_MESON]     != NULL) append_word(&v[DEP_UPP], "python3");
+    if (v[USE_BSYSTEM_MESON]     != NULL) append_word(&v[DEP_PYM], "meson");
+    if (v[USE_BSYSTEM_CMAKE]     != NULL) append_word(&v[DEP_UPP], "cmake");
+    if (v[USE_BSYSTEM_GMAKE]     != NULL) append_word(&v[DEP_UPP], "gmake");
+    if (v[USE_BSYSTEM_XMAKE]     != NULL) append_word(&v[DEP_UPP], "xmake");
+    if (v[USE_BSYSTEM_NINJA]     != NULL) append_word(&v[DEP_UPP], "ninja");
+    if (v[USE_BSYSTEM_RAKE]      != NULL) append_word(&v[DEP_UPP], "ruby");
+    if (v[USE_BSYSTEM_GO]        != NULL) append_word(&v[DEP_UPP], "golang");
+    if (v[USE_BSYSTEM_WAF]       != NULL) append_word(&v[DEP_UPP], "python3");
+
+    /////////////////////////////////////////////////////////////////
+
+    if (v[USE_BSYSTEM_WAF] != NULL || v[USE_BSYSTEM_GO] != NULL || v[USE_BSYSTEM_CARGO] != NULL || v[USE_BSYSTEM_XMAKE] != NULL) {
+        free(v[BINBSTD]);
+        v[BINBSTD] = strdup2("1");
+    }
+
+    if (v[BINBSTD][0] == '\0') {
+        free(v[BINBSTD]);
+        v[BINBSTD] = strdup2(strcmp(v[BSYSTEM_MASTER], "gmake") == 0 ? "1" : "0");
+    }
+
+    if (v[PARALLEL][0] == '\0') {
+        free(v[PARALLEL]);
+        v[PARALLEL] = strdup2("1");
+    }
+
+    if (v[DEP_UPP][0] == ' ') {
+        memmove(v[DEP_UPP], v[DEP_UPP] + 1, strlen(v[DEP_UPP]));
+    }
+
+    if (v[PKGTYPE][0] == '\0') {
+        free(v[PKGTYPE]);
+        v[PKGTYPE] = strdup2((starts_with(name, "lib") || ends_with(name, "lib") || starts_with(name, "xorg-lib")) ? "lib" : "exe");
+    }
+
+    return 0;
+}
+
+static inline void free_formula(Formula * f) {
+    free(f->name);
+    free(f->nameUppercaseUnderscore);
+    free(f->filepath);
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        free(f->v[i]);
+    }
+
+    memset(f, 0, sizeof(Formula));
+}
+
+/////////////////////////////////////////////////////////////////
+
+static char ** formulaRepoNames;
+static size_t  formulaRepoNamesCount;
+
+// same as `cd "$PPKG_FORMULA_REPO_ROOT" && ls` filtered by .ppkg-formula-repo.yml
+static void list_formula_repositories(const char * formulaRepoRoot) {
+    if (formulaRepoNames != NULL) {
+        return;
+    }
+
+    formulaRepoNames = (char**)calloc(1, sizeof(char*));
+
+    DIR * dir = opendir(formulaRepoRoot);
+
+    if (dir == NULL) {
+        return;
+    }
+
+    size_t capacity = 0;
+
+    for (;;) {
+        struct dirent * entry = readdir(dir);
+
+        if (entry == NULL) break;
+
+        if (entry->d_name[0] == '.') continue;
+
+        char * p = strdup3(formulaRepoRoot, "/", entry->d_name);
+        char * q = strdup3(p, "/.ppkg-formula-repo.yml", "");
+
+        int ok = is_regular_file(q);
+
+        free(p);
+        free(q);
+
+        if (!ok) continue;
+
+        if (formulaRepoNamesCount + 1 >= capacity) {
+            capacity = capacity == 0 ? 8 : capacity << 1;
+
+            char ** x = (char**)realloc(formulaRepoNames, (capacity + 1) * sizeof(char*));
+
+            if (x == NULL) {
+                perror(NULL);
+                exit(1);
+            }
+
+            formulaRepoNames = x;
+        }
+
+        formulaRepoNames[formulaRepoNamesCount++] = strdup2(entry->d_name);
+    }
+
+    closedir(dir);
+
+    qsort(formulaRepoNames, formulaRepoNamesCount, sizeof(char*), compare_string);
+}
+
+/////////////////////////////////////////////////////////////////
+
+// every formula repository has an index file written by `formula-index build` when it is synced.
+//
+// layout (native byte order, the index is only read on the machine that wrote it):
+//
+// FormulaIndexHeader
+// FormulaIndexDir     [dirCount]     mtime of the directories the index was built from, used to detect staleness
+// FormulaIndexEntry   [entryCount]   sorted by (name, platform), with the size and mtime of the formula file, used to detect a formula edited in place
+// FormulaIndexDoc     [docCount]     the derived values of the formula mappings, the same as formula-loader would print
+// FormulaIndexTerm    [termCount]    sorted by term, the lowercase alphanumeric tokens of the searchable fields
+// FormulaIndexPosting [postingCount] the entries a term occurs in, grouped by term, sorted by entry
+// string pool                        '\0' terminated strings, the other sections refer to them by offset
+
+#define FORMULA_INDEX_FILENAME ".ppkg-formula-repo.idx"
+#define FORMULA_INDEX_MAGIC    "PPKGIDX2"
+#define FORMULA_INDEX_ENDIAN   0x01020304
+
+// the formula mappings, both raw and derived, are the fields before VERSION_MAJOR
+#define FORMULA_INDEX_DOC_FIELDS VERSION_MAJOR
+
+#define FORMULA_INDEX_NO_DOC   0xFFFFFFFF
+
+#define FORMULA_INDEX_VERSION_FROM_DATE 0x01
+
+// the fields that are tokenized into the inverted index
+#define SEARCH_FIELD_PKGNAME 0x01
+#define SEARCH_FIELD_SUMMARY 0x02
+#define SEARCH_FIELD_LICENSE 0x04
+#define SEARCH_FIELD_WEB_URL 0x08
+#define SEARCH_FIELD_GIT_URL 0x10
+
+typedef struct {
+    char     magic[8];
+    uint32_t endian;
+    uint32_t entryCount;
+    uint32_t dirCount;
+    uint32_t docCount;
+    uint32_t termCount;
+    uint32_t postingCount;
+    uint32_t stringPoolSize;
+    uint32_t reserved;
+} FormulaIndexHeader;
+
+typedef struct {
+    uint32_t path;      // relative to the formula directory, "" for the formula directory itself
+    uint32_t reserved;
+    int64_t  mtimeSec;  // -1 if the directory did not exist
+    int64_t  mtimeNsec;
+} FormulaIndexDir;
+
+typedef struct {
+    uint32_t name;
+    uint32_t platform;  // "" for formula/<name>.yml, otherwise formula/<platform>/<name>.yml
+    uint32_t doc;       // FORMULA_INDEX_NO_DOC if the formula failed to load
+    uint32_t flags;     // FORMULA_INDEX_VERSION_FROM_DATE
+    int64_t  size;
+    int64_t  mtimeSec;
+    int64_t  mtimeNsec;
+    uint8_t  sha256[32];
+} FormulaIndexEntry;
+
+typedef struct {
+    uint32_t v[FORMULA_INDEX_DOC_FIELDS]; // v[VERSION] is "" if the version is derived from the date it is loaded
+} FormulaIndexDoc;
+
+typedef struct {
+    uint32_t term;
+    uint32_t postingStart;
+    uint32_t postingCount;
+    uint32_t reserved;
+} FormulaIndexTerm;
+
+typedef struct {
+    uint32_t entry;
+    uint32_t fields;    // SEARCH_FIELD_* bits
+} FormulaIndexPosting;
+
+typedef struct {
+    const char * repoPath;
+
+    void * data;
+    size_t size;
+
+    const FormulaIndexHeader  * header;
+    const FormulaIndexDir     * dirs;
+    const FormulaIndexEntry   * entries;
+    const FormulaIndexDoc     * docs;
+    const FormulaIndexTerm    * terms;
+    const FormulaIndexPosting * postings;
+    const char                * strings;
+} FormulaIndex;
+
+
+static void formula_index_close(FormulaIndex * idx) {
+    if (idx->data != NULL) {
+        munmap(idx->data, idx->size);
+        idx->data = NULL;
+    }
+}
+
+// returns 0 if the index of the given formula repository exists, is well-formed and is not stale.
+static int formula_index_open(FormulaIndex * idx, const char * repoPath) {
+    memset(idx, 0, sizeof(FormulaIndex));
+
+    idx->repoPath = repoPath;
+
+    char * indexFilePath = strdup3(repoPath, "/", FORMULA_INDEX_FILENAME);
+
+    int fd = open(indexFilePath, O_RDONLY);
+
+    free(indexFilePath);
+
+    if (fd == -1) {
+        return 1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FormulaIndexHeader)) {
+        close(fd);
+        return 1;
+    }
+
+    void * data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return 1;
+    }
+
+    idx->data = data;
+    idx->size = (size_t)st.st_size;
+
+    const FormulaIndexHeader * header = (const FormulaIndexHeader *)data;
+
+    size_t expectedSize = sizeof(FormulaIndexHeader)
+                        + (size_t)header->dirCount     * sizeof(FormulaIndexDir)
+                        + (size_t)header->entryCount   * sizeof(FormulaIndexEntry)
+                        + (size_t)header->docCount     * sizeof(FormulaIndexDoc)
+                        + (size_t)header->termCount    * sizeof(FormulaIndexTerm)
+                        + (size_t)header->postingCount * sizeof(FormulaIndexPosting)
+                        + header->stringPoolSize;
+
+    if (memcmp(header->magic, FORMULA_INDEX_MAGIC, 8) != 0 || header->endian != FORMULA_INDEX_ENDIAN || expectedSize != idx->size || header->stringPoolSize == 0) {
+        formula_index_close(idx);
+        return 1;
+    }
+
+    idx->header   = header;
+    idx->dirs     = (const FormulaIndexDir *)(header + 1);
+    idx->entries  = (const FormulaIndexEntry *)(idx->dirs + header->dirCount);
+    idx->docs     = (const FormulaIndexDoc *)(idx->entries + header->entryCount);
+    idx->terms    = (const FormulaIndexTerm *)(idx->docs + header->docCount);
+    idx->postings = (const FormulaIndexPosting *)(idx->terms + header->termCount);
+    idx->strings  = (const char *)(idx->postings + header->postingCount);
+
+    if (idx->strings[header->stringPoolSize - 1] != '\0') {
+        formula_index_close(idx);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < header->dirCount; i++) {
+        StringBuffer sb = {0};
+
+        sb_append(&sb, repoPath);
+        sb_append(&sb, "/formula/");
+        sb_append(&sb, idx->strings + idx->dirs[i].path);
+
+        int fresh;
+
+        if (stat(sb.buf, &st) == 0) {
+            fresh = ST_MTIME_SEC(st) == idx->dirs[i].mtimeSec && ST_MTIME_NSEC(st) == idx->dirs[i].mtimeNsec;
+        } else {
+            fresh = idx->dirs[i].mtimeSec == -1;
+        }
+
+        free(sb.buf);
+
+        if (!fresh) {
+            formula_index_close(idx);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int formula_index_compare(const char * name1, const char * platform1, const char * name2, const char * platform2) {
+    int r = strcmp(name1, name2);
+    return r == 0 ? strcmp(platform1, platform2) : r;
+}
+
+// binary search, returns NULL if not found
+static const FormulaIndexEntry * formula_index_find(const FormulaIndex * idx, const char * name, const char * platform) {
+    size_t lo = 0;
+    size_t hi = idx->header->entryCount;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        const FormulaIndexEntry * e = &idx->entries[mid];
+
+        int r = formula_index_compare(idx->strings + e->name, idx->strings + e->platform, name, platform);
+
+        if (r == 0) {
+            return e;
+        }
+
+        if (r < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+// the entry that would be used for the given target platform, platform-specific formula takes precedence over generic formula.
+static const FormulaIndexEntry * formula_index_lookup(const FormulaIndex * idx, const char * name, const char * targetPlatformName) {
+    const FormulaIndexEntry * e = NULL;
+
+    if (targetPlatformName[0] != '\0') {
+        e = formula_index_find(idx, name, targetPlatformName);
+    }
+
+    if (e == NULL) {
+        e = formula_index_find(idx, name, "");
+    }
+
+    return e;
+}
+
+static char * formula_index_path_of(const FormulaIndex * idx, const FormulaIndexEntry * e) {
+    StringBuffer sb = {0};
+
+    sb_append(&sb, idx->repoPath);
+    sb_append(&sb, "/formula/");
+
+    if (idx->strings[e->platform] != '\0') {
+        sb_append(&sb, idx->strings + e->platform);
+        sb_append(&sb, "/");
+    }
+
+    sb_append(&sb, idx->strings + e->name);
+    sb_append(&sb, ".yml");
+
+    return sb_take(&sb);
+}
+
+// editing a formula in place changes the mtime of the formula file but not the one of its directory,
+// so the derived values of an entry are used only if the size and mtime of its formula file are the same as when it was indexed.
+static inline int formula_index_entry_is_fresh(const FormulaIndex * idx, const FormulaIndexEntry * e) {
+    char * filepath = formula_index_path_of(idx, e);
+
+    struct stat st;
+
+    int fresh = stat(filepath, &st) == 0
+             && (int64_t)st.st_size == e->size
+             && ST_MTIME_SEC(st)    == e->mtimeSec
+             && ST_MTIME_NSEC(st)   == e->mtimeNsec;
+
+    free(filepath);
+
+    return fresh;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// same as __path_of_formula_of_the_given_package in ppkg
+// the index of every formula repository is used if it is fresh, otherwise fall back to check the file system.
+static inline char * path_of_formula(const char * packageName) {
+    const char * searchDirs = getenv("PPKG_FORMULA_SEARCH_DIRS");
+
+    if (searchDirs != NULL) {
+        char dir[4096];
+
+        for (const char * p = searchDirs; (p = next_word(p, dir, sizeof(dir))) != NULL; ) {
+            char * path = strdup3(dir, "/", packageName);
+            char * filepath = strdup3(path, ".yml", "");
+
+            free(path);
+
+            if (is_regular_file(filepath)) {
+                return filepath;
+            }
+
+            free(filepath);
+        }
+    }
+
+    const char * formulaRepoRoot = getenv("PPKG_FORMULA_REPO_ROOT");
+
+    if (formulaRepoRoot == NULL || !is_directory(formulaRepoRoot)) {
+        return NULL;
+    }
+
+    const char * targetPlatformName = getenv("TARGET_PLATFORM_NAME");
+
+    if (targetPlatformName == NULL) {
+        targetPlatformName = "";
+    }
+
+    list_formula_repositories(formulaRepoRoot);
+
+    for (size_t i = 0; i < formulaRepoNamesCount; i++) {
+        char * repoPath = strdup3(formulaRepoRoot, "/", formulaRepoNames[i]);
+
+        FormulaIndex idx;
+
+        if (formula_index_open(&idx, repoPath) == 0) {
+            const FormulaIndexEntry * e = formula_index_lookup(&idx, packageName, targetPlatformName);
+
+            char * filepath = e == NULL ? NULL : formula_index_path_of(&idx, e);
+
+            formula_index_close(&idx);
+            free(repoPath);
+
+            if (filepath != NULL) {
+                return filepath;
+            }
+
+            continue;
+        }
+
+        StringBuffer sb = {0};
+
+        sb_append(&sb, repoPath);
+        sb_append(&sb, "/formula/");
+        sb_append(&sb, targetPlatformName);
+        sb_append(&sb, "/");
+        sb_append(&sb, packageName);
+        sb_append(&sb, ".yml");
+
+        if (exists(sb.buf)) {
+            free(repoPath);
+            return sb_take(&sb);
+        }
+
+        sb.len = 0;
+
+        sb_append(&sb, repoPath);
+        sb_append(&sb, "/formula/");
+        sb_append(&sb, packageName);
+        sb_append(&sb, ".yml");
+
+        free(repoPath);
+
+        if (exists(sb.buf)) {
+            return sb_take(&sb);
+        }
+
+        free(sb.buf);
+    }
+
+    return NULL;
+}
+
+#endif
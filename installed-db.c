@@ -0,0 +1,608 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+
+#include "formula.h"
+
+// installed-db rebuild
+// installed-db record       <PACKAGE-SPEC>
+// installed-db forget       <PACKAGE-SPEC>
+// installed-db symlinked    <PACKAGE-SPEC> <yes|no>
+// installed-db list         [--symlinked]
+// installed-db dump
+// installed-db is-installed <PACKAGE-SPEC>
+// installed-db is-symlinked <PACKAGE-SPEC>
+// installed-db get          <PACKAGE-SPEC> <spec|version|install-sha|builtat|manifest-sha256|symlinked|dep-pkg>
+//
+// the database of the installed packages is the file $PPKG_HOME/installed.db, one line per installed package, sorted by package spec:
+//
+// <spec>\t<version>\t<install-sha>\t<builtat>\t<manifest-sha256>\t<symlinked>\t<dep-pkg>
+//
+// rebuild   : recover the database from $PPKG_PACKAGE_INSTALLED_ROOT/<TARGET-PLATFORM-SPEC>/<PACKAGE-NAME> and their .ppkg directories.
+// record    : add or replace the record of the given package after it is installed.
+// forget    : remove the record of the given package after it is uninstalled.
+// symlinked : mark the given package as symlinked or not.
+// dump      : print the database as is.
+//
+// every modification is made under an exclusive lock of $PPKG_HOME/installed.db.lock, the new database is written to a temporary file then renamed.
+// the database is rebuilt automatically if it does not exist.
+
+/////////////////////////////////////////////////////////////////
+
+enum {
+    COLUMN_SPEC,
+    COLUMN_VERSION,
+    COLUMN_INSTALL_SHA,
+    COLUMN_BUILTAT,
+    COLUMN_MANIFEST_SHA256,
+    COLUMN_SYMLINKED,
+    COLUMN_DEP_PKG,
+    COLUMN_COUNT
+};
+
+static const char * const COLUMNS[COLUMN_COUNT] = {
+    "spec", "version", "install-sha", "builtat", "manifest-sha256", "symlinked", "dep-pkg"
+};
+
+static const char * const DB_HEADER = "# ppkg installed packages database, regenerate it with: ppkg db rebuild\n";
+
+typedef struct {
+    char * v[COLUMN_COUNT];
+} Record;
+
+typedef struct {
+    Record * items;
+    size_t   size;
+    size_t   capacity;
+} Records;
+
+static const char * installedRoot;
+static const char * symlinkedRoot;
+
+static char * dbFilePath;
+static char * lockFilePath;
+
+/////////////////////////////////////////////////////////////////
+
+static Record * records_add(Records * records) {
+    if (records->size == records->capacity) {
+        size_t capacity = records->capacity == 0 ? 64 : records->capacity << 1;
+
+        Record * p = (Record*)realloc(records->items, capacity * sizeof(Record));
+
+        if (p == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+
+        records->items = p;
+        records->capacity = capacity;
+    }
+
+    Record * r = &records->items[records->size++];
+
+    memset(r, 0, sizeof(Record));
+
+    return r;
+}
+
+static Record * records_find(const Records * records, const char * spec) {
+    for (size_t i = 0; i < records->size; i++) {
+        if (strcmp(records->items[i].v[COLUMN_SPEC], spec) == 0) {
+            return &records->items[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_record(const void * a, const void * b) {
+    return strcmp(((const Record *)a)->v[COLUMN_SPEC], ((const Record *)b)->v[COLUMN_SPEC]);
+}
+
+// a value must not break a line into columns or lines
+static char * sanitize(const char * s) {
+    char * p = strdup2(s);
+
+    for (char * q = p; *q != '\0'; q++) {
+        if (*q == '\t' || *q == '\n' || *q == '\r') {
+            *q = ' ';
+        }
+    }
+
+    return p;
+}
+
+// returns 0 on success, returns -1 if the database does not exist, returns 1 on error.
+static int db_read(Records * records) {
+    FILE * file = fopen(dbFilePath, "r");
+
+    if (file == NULL) {
+        if (errno == ENOENT) {
+            return -1;
+        }
+
+        perror(dbFilePath);
+        return 1;
+    }
+
+    char * line = NULL;
+    size_t lineCapacity = 0;
+
+    for (;;) {
+        ssize_t n = getline(&line, &lineCapacity, file);
+
+        if (n < 0) break;
+
+        if (n > 0 && line[n - 1] == '\n') {
+            line[--n] = '\0';
+        }
+
+        if (n == 0 || line[0] == '#') continue;
+
+        Record * r = records_add(records);
+
+        char * p = line;
+
+        for (int i = 0; i < COLUMN_COUNT; i++) {
+            char * tab = i == COLUMN_COUNT - 1 ? NULL : strchr(p, '\t');
+
+            if (tab != NULL) {
+                *tab = '\0';
+            }
+
+            r->v[i] = strdup2(p);
+
+            p = tab == NULL ? p + strlen(p) : tab + 1;
+        }
+    }
+
+    free(line);
+
+    int failed = ferror(file);
+
+    fclose(file);
+
+    if (failed) {
+        perror(dbFilePath);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int db_write(Records * records) {
+    qsort(records->items, records->size, sizeof(Record), compare_record);
+
+    char tmpSuffix[32];
+
+    snprintf(tmpSuffix, sizeof(tmpSuffix), ".%d.tmp", (int)getpid());
+
+    char * tmpFilePath = strdup3(dbFilePath, tmpSuffix, "");
+
+    FILE * file = fopen(tmpFilePath, "w");
+
+    if (file == NULL) {
+        perror(tmpFilePath);
+        return 1;
+    }
+
+    fputs(DB_HEADER, file);
+
+    for (size_t i = 0; i < records->size; i++) {
+        for (int j = 0; j < COLUMN_COUNT; j++) {
+            if (j > 0) fputc('\t', file);
+            fputs(records->items[i].v[j], file);
+        }
+
+        fputc('\n', file);
+    }
+
+    int ok = fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        perror(tmpFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    if (rename(tmpFilePath, dbFilePath) != 0) {
+        perror(dbFilePath);
+        unlink(tmpFilePath);
+        return 1;
+    }
+
+    free(tmpFilePath);
+
+    return 0;
+}
+
+static int lockFD = -1;
+
+static int db_lock(void) {
+    lockFD = open(lockFilePath, O_RDWR | O_CREAT, 0644);
+
+    if (lockFD == -1) {
+        perror(lockFilePath);
+        return 1;
+    }
+
+    struct flock lock;
+
+    memset(&lock, 0, sizeof(lock));
+
+    lock.l_type   = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+
+    while (fcntl(lockFD, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR) {
+            perror(lockFilePath);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void db_unlock(void) {
+    if (lockFD != -1) {
+        close(lockFD);
+        lockFD = -1;
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+
+// read the record of the given package from its installed directory.
+// returns 0 on success, returns 10 if it is not installed, returns 1 on error.
+static int load_record(Record * r, const char * spec, int quiet) {
+    char * linkPath = strdup3(installedRoot, "/", spec);
+
+    struct stat st;
+
+    if (lstat(linkPath, &st) != 0 || !S_ISLNK(st.st_mode)) {
+        if (!quiet) fprintf(stderr, "package '%s' is not installed.\n", spec);
+        free(linkPath);
+        return 10;
+    }
+
+    char target[4096];
+
+    ssize_t n = readlink(linkPath, target, sizeof(target) - 1);
+
+    if (n < 0) {
+        perror(linkPath);
+        free(linkPath);
+        return 1;
+    }
+
+    target[n] = '\0';
+
+    char * manifestFilePath = strdup3(linkPath, "/.ppkg/", "MANIFEST.txt");
+    char * receiptFilePath  = strdup3(linkPath, "/.ppkg/", "RECEIPT.yml");
+
+    free(linkPath);
+
+    if (!is_regular_file(manifestFilePath) || !is_regular_file(receiptFilePath)) {
+        if (!quiet) fprintf(stderr, "package '%s' is not installed completely.\n", spec);
+        free(manifestFilePath);
+        free(receiptFilePath);
+        return 10;
+    }
+
+    char manifestSha256[65];
+
+    if (sha256_of_file(manifestFilePath, manifestSha256) != 0) {
+        perror(manifestFilePath);
+        return 1;
+    }
+
+    Mappings receipt = {0};
+
+    if (parse_yaml(receiptFilePath, &receipt) != 0) {
+        return 1;
+    }
+
+    char * registryFilePath = strdup3(symlinkedRoot, "/.registry/", spec);
+
+    r->v[COLUMN_SPEC]            = strdup2(spec);
+    r->v[COLUMN_VERSION]         = sanitize(lookup(&receipt, "version"));
+    r->v[COLUMN_INSTALL_SHA]     = sanitize(basename2(target));
+    r->v[COLUMN_BUILTAT]         = sanitize(lookup(&receipt, "builtat"));
+    r->v[COLUMN_MANIFEST_SHA256] = strdup2(manifestSha256);
+    r->v[COLUMN_SYMLINKED]       = strdup2(is_regular_file(registryFilePath) ? "yes" : "no");
+    r->v[COLUMN_DEP_PKG]         = sanitize(lookup(&receipt, "dep-pkg"));
+
+    free_mappings(&receipt);
+    free(registryFilePath);
+    free(manifestFilePath);
+    free(receiptFilePath);
+
+    return 0;
+}
+
+static int scan_installed_packages(Records * records) {
+    DIR * dir = opendir(installedRoot);
+
+    if (dir == NULL) {
+        return errno == ENOENT ? 0 : (perror(installedRoot), 1);
+    }
+
+    for (;;) {
+        struct dirent * targetEntry = readdir(dir);
+
+        if (targetEntry == NULL) break;
+
+        if (targetEntry->d_name[0] == '.') continue;
+
+        char * targetDirPath = strdup3(installedRoot, "/", targetEntry->d_name);
+
+        DIR * targetDir = opendir(targetDirPath);
+
+        free(targetDirPath);
+
+        if (targetDir == NULL) continue;
+
+        for (;;) {
+            struct dirent * entry = readdir(targetDir);
+
+            if (entry == NULL) break;
+
+            if (entry->d_name[0] == '.') continue;
+
+            char * spec = strdup3(targetEntry->d_name, "/", entry->d_name);
+
+            Record r;
+
+            memset(&r, 0, sizeof(Record));
+
+            int ret = load_record(&r, spec, 1);
+
+            free(spec);
+
+            if (ret == 10) continue;
+
+            if (ret != 0) {
+                closedir(targetDir);
+                closedir(dir);
+                return ret;
+            }
+
+            *records_add(records) = r;
+        }
+
+        closedir(targetDir);
+    }
+
+    closedir(dir);
+
+    return 0;
+}
+
+static int rebuild(void) {
+    if (db_lock() != 0) {
+        return 1;
+    }
+
+    Records records = {0};
+
+    int ret = scan_installed_packages(&records);
+
+    if (ret == 0) {
+        ret = db_write(&records);
+    }
+
+    db_unlock();
+
+    return ret;
+}
+
+// read the database, rebuild it first if it does not exist.
+static int db_open(Records * records) {
+    int ret = db_read(records);
+
+    if (ret != -1) {
+        return ret;
+    }
+
+    if (rebuild() != 0) {
+        return 1;
+    }
+
+    return db_read(records) == 0 ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// modify the record of the given package under the lock.
+// action : 'r' record, 'f' forget, 'y' symlinked, 'n' not symlinked
+static int modify(const char * spec, char action) {
+    Record record;
+
+    if (action == 'r') {
+        int ret = load_record(&record, spec, 0);
+
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    if (db_lock() != 0) {
+        return 1;
+    }
+
+    Records records = {0};
+
+    int ret = db_read(&records);
+
+    if (ret == -1) {
+        ret = scan_installed_packages(&records);
+    }
+
+    if (ret != 0) {
+        db_unlock();
+        return 1;
+    }
+
+    Record * r = records_find(&records, spec);
+
+    switch (action) {
+        case 'r':
+            if (r == NULL) {
+                r = records_add(&records);
+            }
+
+            *r = record;
+            break;
+        case 'f':
+            if (r != NULL) {
+                *r = records.items[--records.size];
+            }
+            break;
+        default:
+            if (r == NULL) {
+                fprintf(stderr, "package '%s' is not installed.\n", spec);
+                db_unlock();
+                return 10;
+            }
+
+            r->v[COLUMN_SYMLINKED] = (char*)(action == 'y' ? "yes" : "no");
+    }
+
+    ret = db_write(&records);
+
+    db_unlock();
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <rebuild|record|forget|symlinked|list|dump|is-installed|is-symlinked|get> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    const char * ppkgHome = getenv("PPKG_HOME");
+
+    installedRoot = getenv("PPKG_PACKAGE_INSTALLED_ROOT");
+    symlinkedRoot = getenv("PPKG_PACKAGE_SYMLINKED_ROOT");
+
+    if (ppkgHome == NULL || ppkgHome[0] == '\0' || installedRoot == NULL || installedRoot[0] == '\0' || symlinkedRoot == NULL || symlinkedRoot[0] == '\0') {
+        fprintf(stderr, "PPKG_HOME, PPKG_PACKAGE_INSTALLED_ROOT and PPKG_PACKAGE_SYMLINKED_ROOT environment variables must be set.\n");
+        return 1;
+    }
+
+    dbFilePath   = strdup3(ppkgHome, "/", "installed.db");
+    lockFilePath = strdup3(ppkgHome, "/", "installed.db.lock");
+
+    const char * action = argv[1];
+
+    if (strcmp(action, "rebuild") == 0) {
+        return rebuild();
+    }
+
+    if (strcmp(action, "record") == 0 || strcmp(action, "forget") == 0) {
+        if (argc != 3 || argv[2][0] == '\0') {
+            fprintf(stderr, "Usage: %s %s <PACKAGE-SPEC>\n", argv[0], action);
+            return 1;
+        }
+
+        return modify(argv[2], action[0]);
+    }
+
+    if (strcmp(action, "symlinked") == 0) {
+        if (argc != 4 || argv[2][0] == '\0' || (strcmp(argv[3], "yes") != 0 && strcmp(argv[3], "no") != 0)) {
+            fprintf(stderr, "Usage: %s symlinked <PACKAGE-SPEC> <yes|no>\n", argv[0]);
+            return 1;
+        }
+
+        return modify(argv[2], argv[3][0]);
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    Records records = {0};
+
+    if (db_open(&records) != 0) {
+        return 1;
+    }
+
+    int ret = 0;
+
+    if (strcmp(action, "list") == 0) {
+        int symlinkedOnly = argc > 2 && strcmp(argv[2], "--symlinked") == 0;
+
+        for (size_t i = 0; i < records.size; i++) {
+            if (symlinkedOnly && strcmp(records.items[i].v[COLUMN_SYMLINKED], "yes") != 0) continue;
+            puts(records.items[i].v[COLUMN_SPEC]);
+        }
+    } else if (strcmp(action, "dump") == 0) {
+        for (size_t i = 0; i < records.size; i++) {
+            for (int j = 0; j < COLUMN_COUNT; j++) {
+                if (j > 0) putchar('\t');
+                fputs(records.items[i].v[j], stdout);
+            }
+
+            putchar('\n');
+        }
+    } else if (strcmp(action, "is-installed") == 0 || strcmp(action, "is-symlinked") == 0) {
+        if (argc != 3 || argv[2][0] == '\0') {
+            fprintf(stderr, "Usage: %s %s <PACKAGE-SPEC>\n", argv[0], action);
+            return 1;
+        }
+
+        Record * r = records_find(&records, argv[2]);
+
+        if (r == NULL) {
+            return 10;
+        }
+
+        if (action[3] == 's' && strcmp(r->v[COLUMN_SYMLINKED], "yes") != 0) {
+            return 1;
+        }
+    } else if (strcmp(action, "get") == 0) {
+        if (argc != 4 || argv[2][0] == '\0') {
+            fprintf(stderr, "Usage: %s get <PACKAGE-SPEC> <KEY>\n", argv[0]);
+            return 1;
+        }
+
+        Record * r = records_find(&records, argv[2]);
+
+        if (r == NULL) {
+            fprintf(stderr, "package '%s' is not installed.\n", argv[2]);
+            return 10;
+        }
+
+        int column = -1;
+
+        for (int i = 0; i < COLUMN_COUNT; i++) {
+            if (strcmp(COLUMNS[i], argv[3]) == 0) {
+                column = i;
+                break;
+            }
+        }
+
+        if (column == -1) {
+            fprintf(stderr, "unrecognized key: %s\n", argv[3]);
+            return 1;
+        }
+
+        puts(r->v[column]);
+    } else {
+        fprintf(stderr, "unrecognized action: %s\n", action);
+        return 1;
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
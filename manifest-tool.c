@@ -0,0 +1,1265 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "sha256.h"
+#include "util.h"
+
+// manifest-tool generate  [--jobs=<N>] [--stamps=<FILE>] <INSTALL-DIR>
+// manifest-tool verify    [--jobs=<N>] [--deep] [--json] [--cache=<FILE>] <INSTALLED-ROOT> <PACKAGE-SPEC>...
+// manifest-tool benchmark [--jobs=<N>] <DIR>
+//
+// generate  : write the MANIFEST.txt of <INSTALL-DIR> to stdout. the directories directly under <INSTALL-DIR> except .ppkg are walked,
+//             every file of them is listed before its children, the children are sorted by name. one line per file:
+//
+//             <TYPE>|<SHA256>|<PATH>
+//
+//             <TYPE> is the same as find -printf '%y' but D for a symlink to a directory, <PATH> is relative to <INSTALL-DIR>.
+//             <SHA256> is the sha256sum of the content of a regular file or of the target of a symlink, 64 zeros for a directory.
+//             it is empty if the file can not be read, e.g. a dangling symlink, a fifo, a socket or a device.
+//             a path of a directory ends with /
+//
+//             --stamps : also write <SIZE>\t<MTIME-SEC>\t<MTIME-NSEC>\t<PATH> to <FILE> for every line of MANIFEST.txt, in the same order.
+//                        the size and mtime are of the hashed file, 0 for the others.
+//
+// verify    : compare the files of <INSTALLED-ROOT>/<PACKAGE-SPEC> with its .ppkg/MANIFEST.txt, print the following lines then a summary:
+//
+//             missing  <PACKAGE-SPEC> <PATH>  it is in MANIFEST.txt but does not exist.
+//             modified <PACKAGE-SPEC> <PATH>  its type or content differs from MANIFEST.txt
+//             extra    <PACKAGE-SPEC> <PATH>  it exists but is not in MANIFEST.txt
+//
+//             the packages are reported in the given order, the paths of each kind are sorted.
+//             a file whose size and mtime are the same as in .ppkg/MANIFEST-STAMPS.txt is not read, the others are hashed.
+//             --deep  : hash every file regardless of its stamp and the cache.
+//             --json  : print one JSON object {"packages":[{"spec","ok","files","hashed","missing","modified","extra"}],"files","hashed","missing","modified","extra"} instead.
+//             --cache : remember the sha256sum of the hashed files in <FILE> by their device, inode, size and mtime,
+//                       so that a file which has been touched but not modified is hashed only once.
+//             exit 10 if any file is missing, modified or extra.
+//
+// benchmark : hash every regular file under <DIR> with every SHA-256 implementation the cpu supports, report the throughput of each.
+//             the files are read from the page cache once they have been read, run it twice to measure the hashing rather than the disk.
+//
+// the files are hashed by <N> worker processes, one per online cpu by default. the workers take the files from a shared counter,
+// the largest first, so that a few large files do not keep one worker busy while the others are idle.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char ** items;
+    size_t  size;
+    size_t  capacity;
+} Strings;
+
+static void strings_push(Strings * strings, char * s) {
+    if (strings->size == strings->capacity) {
+        strings->capacity = strings->capacity == 0 ? 64 : strings->capacity << 1;
+
+        strings->items = (char**)realloc(strings->items, strings->capacity * sizeof(char*));
+
+        if (strings->items == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    strings->items[strings->size++] = s;
+}
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char    type;
+    char *  path;
+    int     hash;   // 1 if its content is hashed
+
+    // the stat of the file whose content is hashed, i.e. the target of a symlink
+    int64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    int64_t dev;
+    int64_t ino;
+} Entry;
+
+typedef struct {
+    Entry * items;
+    size_t  size;
+    size_t  capacity;
+} Entries;
+
+static Entry * entries_add(Entries * entries) {
+    if (entries->size == entries->capacity) {
+        entries->capacity = entries->capacity == 0 ? 1024 : entries->capacity << 1;
+
+        entries->items = (Entry*)realloc(entries->items, entries->capacity * sizeof(Entry));
+
+        if (entries->items == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    Entry * e = &entries->items[entries->size++];
+
+    memset(e, 0, sizeof(Entry));
+
+    return e;
+}
+
+// the same as find -printf '%y'
+static char type_of(mode_t mode) {
+    if (S_ISREG(mode))  return 'f';
+    if (S_ISDIR(mode))  return 'd';
+    if (S_ISLNK(mode))  return 'l';
+    if (S_ISFIFO(mode)) return 'p';
+    if (S_ISSOCK(mode)) return 's';
+    if (S_ISCHR(mode))  return 'c';
+    if (S_ISBLK(mode))  return 'b';
+    return 'U';
+}
+
+// the sorted names of the entries of <DIR>, except . and ..
+static int list_dir(const char * dir, Strings * names) {
+    DIR * d = opendir(dir);
+
+    if (d == NULL) {
+        perror(dir);
+        return -1;
+    }
+
+    struct dirent * ent;
+
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+        strings_push(names, strdup2(ent->d_name));
+    }
+
+    closedir(d);
+
+    qsort(names->items, names->size, sizeof(char*), compare_string);
+
+    return 0;
+}
+
+static void stamp_entry(Entry * e, const struct stat * st) {
+    e->hash      = 1;
+    e->size      = (int64_t)st->st_size;
+    e->mtimeSec  = ST_MTIME_SEC(*st);
+    e->mtimeNsec = ST_MTIME_NSEC(*st);
+    e->dev       = (int64_t)st->st_dev;
+    e->ino       = (int64_t)st->st_ino;
+}
+
+// the same as find <PATH>, but in a deterministic order.
+static int walk(char * path, Entries * entries) {
+    struct stat st;
+
+    if (lstat(path, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+
+    Entry * e = entries_add(entries);
+
+    e->type = type_of(st.st_mode);
+    e->path = path;
+
+    if (S_ISREG(st.st_mode)) {
+        stamp_entry(e, &st);
+    } else if (S_ISLNK(st.st_mode)) {
+        struct stat target;
+
+        if (stat(path, &target) == 0) {
+            if (S_ISDIR(target.st_mode)) {
+                e->type = 'D';
+            } else if (S_ISREG(target.st_mode)) {
+                stamp_entry(e, &target);
+            }
+        }
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        return 0;
+    }
+
+    Strings names = {0};
+
+    if (list_dir(path, &names) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < names.size; i++) {
+        int ret = walk(strdup3(path, "/", names.items[i]), entries);
+
+        free(names.items[i]);
+
+        if (ret != 0) {
+            return -1;
+        }
+    }
+
+    free(names.items);
+
+    return 0;
+}
+
+// walk the directories directly under <INSTALL-DIR> except .ppkg, the paths are prefixed with <PREFIX>/ unless <PREFIX> is NULL.
+static int walk_install_dir(const char * prefix, Entries * entries) {
+    Strings names = {0};
+
+    if (list_dir(prefix == NULL ? "." : prefix, &names) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < names.size; i++) {
+        if (strcmp(names.items[i], ".ppkg") == 0) continue;
+
+        char * path = prefix == NULL ? strdup2(names.items[i]) : strdup3(prefix, "/", names.items[i]);
+
+        struct stat st;
+
+        if (lstat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        if (walk(path, entries) != 0) {
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < names.size; i++) {
+        free(names.items[i]);
+    }
+
+    free(names.items);
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+#define MAX_WORKER_COUNT 64
+
+typedef struct {
+    uint8_t digest[32];
+    int     status;     // 0: not hashed, 1: hashed, -1: failed
+} Result;
+
+static Entries   entries;
+static size_t *  jobs;      // the indexes of the entries to be hashed, the largest first
+static size_t    jobCount;
+static size_t *  counter;   // the next job to take, shared by the workers
+static Result *  results;   // shared by the workers, one per entry
+
+static int compare_job(const void * a, const void * b) {
+    const Entry * x = &entries.items[*(const size_t *)a];
+    const Entry * y = &entries.items[*(const size_t *)b];
+
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+
+    return strcmp(x->path, y->path);
+}
+
+static int hash_file(const char * path, uint8_t digest[32]) {
+    static uint8_t * buf;
+
+    const size_t bufSize = 1 << 20;
+
+    if (buf == NULL) {
+        buf = (uint8_t*)malloc(bufSize);
+
+        if (buf == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+#if defined (POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    SHA256 ctx;
+
+    sha256_init(&ctx);
+
+    for (;;) {
+        ssize_t n = read(fd, buf, bufSize);
+
+        if (n == 0) break;
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+
+            close(fd);
+            return -1;
+        }
+
+        sha256_update(&ctx, buf, (size_t)n);
+    }
+
+    close(fd);
+
+    sha256_final(&ctx, digest);
+
+    return 0;
+}
+
+static void hash_by_worker(void) {
+    for (;;) {
+        const size_t k = __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+
+        if (k >= jobCount) break;
+
+        const size_t i = jobs[k];
+
+        results[i].status = hash_file(entries.items[i].path, results[i].digest) == 0 ? 1 : -1;
+    }
+}
+
+// hash the entries in <WORKER-COUNT> processes, returns the number of the workers actually used, -1 on error.
+static int hash_entries(int workerCount) {
+    if (jobs == NULL) {
+        jobs = (size_t*)malloc((entries.size + 1) * sizeof(size_t));
+
+        if (jobs == NULL) {
+            perror(NULL);
+            return -1;
+        }
+
+        for (size_t i = 0; i < entries.size; i++) {
+            if (entries.items[i].hash) {
+                jobs[jobCount++] = i;
+            }
+        }
+
+        qsort(jobs, jobCount, sizeof(size_t), compare_job);
+
+        // MAP_ANON is not in POSIX, a shared mapping of an unlinked temporary file does the same.
+        const size_t mapSize = sizeof(size_t) + (entries.size + 1) * sizeof(Result);
+
+        FILE * file = tmpfile();
+
+        if (file == NULL || ftruncate(fileno(file), (off_t)mapSize) != 0) {
+            perror("tmpfile");
+            return -1;
+        }
+
+        void * p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+
+        fclose(file);
+
+        if (p == MAP_FAILED) {
+            perror("mmap");
+            return -1;
+        }
+
+        counter = (size_t*)p;
+        results = (Result*)((char*)p + sizeof(size_t));
+    }
+
+    *counter = 0;
+
+    memset(results, 0, entries.size * sizeof(Result));
+
+    // forking is not worth it for a few files.
+    if ((size_t)workerCount > jobCount / 16 + 1) {
+        workerCount = (int)(jobCount / 16 + 1);
+    }
+
+    if (workerCount == 1) {
+        hash_by_worker();
+        return 1;
+    }
+
+    fflush(stdout);
+
+    pid_t pids[MAX_WORKER_COUNT];
+
+    int ret = workerCount;
+
+    for (int i = 0; i < workerCount; i++) {
+        pids[i] = fork();
+
+        if (pids[i] == -1) {
+            perror("fork");
+            workerCount = i;
+            ret = -1;
+            break;
+        }
+
+        if (pids[i] == 0) {
+            hash_by_worker();
+            _exit(0);
+        }
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        int status;
+
+        while (waitpid(pids[i], &status, 0) == -1) {
+            if (errno != EINTR) {
+                perror("waitpid");
+                return -1;
+            }
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int parse_jobs(const char * arg, int * workerCount) {
+    if (!is_integer(arg) || atoi(arg) <= 0) {
+        return -1;
+    }
+
+    *workerCount = atoi(arg) > MAX_WORKER_COUNT ? MAX_WORKER_COUNT : atoi(arg);
+
+    return 0;
+}
+
+static int default_worker_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n < 1) return 1;
+
+    return n > MAX_WORKER_COUNT ? MAX_WORKER_COUNT : (int)n;
+}
+
+static int generate(const char * installDir, const char * stampsFilePath, int workerCount) {
+    FILE * stampsFile = NULL;
+
+    if (stampsFilePath != NULL) {
+        stampsFile = fopen(stampsFilePath, "w");
+
+        if (stampsFile == NULL) {
+            perror(stampsFilePath);
+            return 1;
+        }
+    }
+
+    if (chdir(installDir) != 0) {
+        perror(installDir);
+        return 1;
+    }
+
+    if (walk_install_dir(NULL, &entries) != 0) {
+        return 1;
+    }
+
+    if (hash_entries(workerCount) < 0) {
+        fprintf(stderr, "failed to hash the files of %s\n", installDir);
+        return 1;
+    }
+
+    for (size_t i = 0; i < entries.size; i++) {
+        const Entry * e = &entries.items[i];
+
+        char hex[65] = "";
+
+        const int isDir = e->type == 'd' || e->type == 'D';
+
+        if (stampsFile != NULL) {
+            fprintf(stampsFile, "%lld\t%lld\t%lld\t%s%s\n", (long long)e->size, (long long)e->mtimeSec, (long long)e->mtimeNsec, e->path, isDir ? "/" : "");
+        }
+
+        if (isDir) {
+            printf("%c|0000000000000000000000000000000000000000000000000000000000000000|%s/\n", e->type, e->path);
+            continue;
+        }
+
+        if (results[i].status == 1) {
+            sha256_to_hex(results[i].digest, hex);
+        } else if (results[i].status == -1) {
+            fprintf(stderr, "%s: can not be read, its sha256sum is left empty.\n", e->path);
+        }
+
+        printf("%c|%s|%s\n", e->type, hex, e->path);
+    }
+
+    if (stampsFile != NULL && fclose(stampsFile) != 0) {
+        perror(stampsFilePath);
+        return 1;
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+// the sha256sum of a file whose device, inode, size and mtime are the same as when it was hashed is taken from the cache:
+//
+// <DEV>\t<INO>\t<SIZE>\t<MTIME-SEC>\t<MTIME-NSEC>\t<SHA256>
+typedef struct {
+    int64_t dev;
+    int64_t ino;
+    int64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    char    sha256[65];
+} CacheEntry;
+
+typedef struct {
+    CacheEntry * items;
+    size_t       size;
+    size_t       capacity;
+} Cache;
+
+static CacheEntry * cache_add(Cache * cache) {
+    if (cache->size == cache->capacity) {
+        cache->capacity = cache->capacity == 0 ? 1024 : cache->capacity << 1;
+
+        cache->items = (CacheEntry*)realloc(cache->items, cache->capacity * sizeof(CacheEntry));
+
+        if (cache->items == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    return &cache->items[cache->size++];
+}
+
+static int compare_cache_entry(const void * a, const void * b) {
+    const CacheEntry * x = (const CacheEntry *)a;
+    const CacheEntry * y = (const CacheEntry *)b;
+
+    if (x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+    if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+
+    return 0;
+}
+
+// a missing cache is an empty one.
+static int cache_read(const char * filepath, Cache * cache) {
+    FILE * file = fopen(filepath, "r");
+
+    if (file == NULL) {
+        if (errno == ENOENT) return 0;
+
+        perror(filepath);
+        return -1;
+    }
+
+    char line[256];
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        CacheEntry e;
+
+        long long dev, ino, size, sec, nsec;
+
+        if (sscanf(line, "%lld\t%lld\t%lld\t%lld\t%lld\t%64s", &dev, &ino, &size, &sec, &nsec, e.sha256) != 6 || strlen(e.sha256) != 64) continue;
+
+        e.dev       = dev;
+        e.ino       = ino;
+        e.size      = size;
+        e.mtimeSec  = sec;
+        e.mtimeNsec = nsec;
+
+        *cache_add(cache) = e;
+    }
+
+    fclose(file);
+
+    qsort(cache->items, cache->size, sizeof(CacheEntry), compare_cache_entry);
+
+    return 0;
+}
+
+static const CacheEntry * cache_find(const Cache * cache, const Entry * e) {
+    CacheEntry key;
+
+    key.dev = e->dev;
+    key.ino = e->ino;
+
+    const CacheEntry * c = (const CacheEntry *)bsearch(&key, cache->items, cache->size, sizeof(CacheEntry), compare_cache_entry);
+
+    if (c == NULL || c->size != e->size || c->mtimeSec != e->mtimeSec || c->mtimeNsec != e->mtimeNsec) {
+        return NULL;
+    }
+
+    return c;
+}
+
+// the new entries are preferred to the old ones of the same file, the cache is written to a temporary file then renamed.
+static int cache_write(const char * filepath, Cache * cache, size_t oldSize) {
+    // a stable merge, the old entries are sorted already.
+    Cache merged = {0};
+
+    qsort(cache->items + oldSize, cache->size - oldSize, sizeof(CacheEntry), compare_cache_entry);
+
+    size_t i = 0;
+    size_t j = oldSize;
+
+    while (i < oldSize || j < cache->size) {
+        int r;
+
+        if (i == oldSize) {
+            r = 1;
+        } else if (j == cache->size) {
+            r = -1;
+        } else {
+            r = compare_cache_entry(&cache->items[i], &cache->items[j]);
+        }
+
+        if (r < 0) {
+            *cache_add(&merged) = cache->items[i++];
+        } else {
+            if (r == 0) i++;
+
+            // the last one of the same file wins
+            while (j + 1 < cache->size && compare_cache_entry(&cache->items[j], &cache->items[j + 1]) == 0) j++;
+
+            *cache_add(&merged) = cache->items[j++];
+        }
+    }
+
+    char tmpFilePath[4096];
+
+    snprintf(tmpFilePath, sizeof(tmpFilePath), "%s.%d.tmp", filepath, (int)getpid());
+
+    FILE * file = fopen(tmpFilePath, "w");
+
+    if (file == NULL) {
+        perror(tmpFilePath);
+        return -1;
+    }
+
+    for (size_t k = 0; k < merged.size; k++) {
+        const CacheEntry * e = &merged.items[k];
+
+        fprintf(file, "%lld\t%lld\t%lld\t%lld\t%lld\t%s\n", (long long)e->dev, (long long)e->ino, (long long)e->size, (long long)e->mtimeSec, (long long)e->mtimeNsec, e->sha256);
+    }
+
+    free(merged.items);
+
+    if (fclose(file) != 0 || rename(tmpFilePath, filepath) != 0) {
+        perror(filepath);
+        unlink(tmpFilePath);
+        return -1;
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    const char * spec;
+    char *       dir;
+
+    size_t  begin;      // its entries are entries.items[begin] ... entries.items[end - 1]
+    size_t  end;
+
+    size_t  files;      // the number of the lines of its MANIFEST.txt
+    size_t  hashed;
+
+    Strings missing;
+    Strings modified;
+    Strings extra;
+
+    int     failed;     // 1 if it could not be verified at all
+} Package;
+
+// a file whose content is compared after it is hashed.
+typedef struct {
+    size_t package;
+    size_t entry;
+    char * path;
+    char   sha256[65];
+} Check;
+
+static Package * packages;
+
+static Check * checks;
+static size_t  checkCount;
+static size_t  checkCapacity;
+
+static size_t * sortedEntries;  // the entries of a package sorted by path
+
+static int compare_entry_index(const void * a, const void * b) {
+    return strcmp(entries.items[*(const size_t *)a].path, entries.items[*(const size_t *)b].path);
+}
+
+static int compare_path_to_entry_index(const void * key, const void * b) {
+    return strcmp((const char *)key, entries.items[*(const size_t *)b].path);
+}
+
+static void add_check(size_t package, size_t entry, const char * path, const char * sha256) {
+    if (checkCount == checkCapacity) {
+        checkCapacity = checkCapacity == 0 ? 1024 : checkCapacity << 1;
+
+        checks = (Check*)realloc(checks, checkCapacity * sizeof(Check));
+
+        if (checks == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    Check * c = &checks[checkCount++];
+
+    c->package = package;
+    c->entry   = entry;
+    c->path    = strdup2(path);
+
+    memcpy(c->sha256, sha256, 65);
+}
+
+// compare the files of the package with its MANIFEST.txt, the files which need to be hashed are added to the checks.
+static int verify_package(size_t index, int deep, const Cache * cache, char * seen) {
+    Package * pkg = &packages[index];
+
+    char * manifestFilePath = strdup3(pkg->dir, "/", ".ppkg/MANIFEST.txt");
+    char * stampsFilePath   = strdup3(pkg->dir, "/", ".ppkg/MANIFEST-STAMPS.txt");
+
+    FILE * manifestFile = fopen(manifestFilePath, "r");
+
+    if (manifestFile == NULL) {
+        perror(manifestFilePath);
+        return -1;
+    }
+
+    // the packages installed before the stamps were introduced have none, their files are always hashed.
+    FILE * stampsFile = deep ? NULL : fopen(stampsFilePath, "r");
+
+    size_t prefixLength = strlen(pkg->dir) + 1;
+
+    char * line      = NULL;
+    char * stampLine = NULL;
+
+    size_t lineCapacity      = 0;
+    size_t stampLineCapacity = 0;
+
+    StringBuffer path = {0};
+
+    ssize_t n;
+
+    while ((n = getline(&line, &lineCapacity, manifestFile)) > 0) {
+        if (line[n - 1] == '\n') line[--n] = '\0';
+
+        // <TYPE>|<SHA256>|<PATH>
+        char * sha256 = strchr(line, '|');
+        char * p      = sha256 == NULL ? NULL : strchr(sha256 + 1, '|');
+
+        if (p == NULL || sha256 != line + 1) {
+            fprintf(stderr, "%s: invalid line: %s\n", manifestFilePath, line);
+            continue;
+        }
+
+        *sha256++ = '\0';
+        *p++      = '\0';
+
+        const char type = line[0];
+
+        pkg->files++;
+
+        // the stamp of the same line, if any.
+        int64_t stamp[3] = {0};
+
+        int stamped = 0;
+
+        if (stampsFile != NULL) {
+            ssize_t m = getline(&stampLine, &stampLineCapacity, stampsFile);
+
+            if (m > 0) {
+                if (stampLine[m - 1] == '\n') stampLine[m - 1] = '\0';
+
+                long long size, sec, nsec;
+
+                int offset = 0;
+
+                if (sscanf(stampLine, "%lld\t%lld\t%lld\t%n", &size, &sec, &nsec, &offset) == 3 && offset > 0 && strcmp(stampLine + offset, p) == 0) {
+                    stamp[0] = size;
+                    stamp[1] = sec;
+                    stamp[2] = nsec;
+                    stamped  = 1;
+                }
+            }
+        }
+
+        const size_t pathLength = strlen(p);
+
+        if ((type == 'd' || type == 'D') && pathLength > 0 && p[pathLength - 1] == '/') {
+            p[pathLength - 1] = '\0';
+        }
+
+        path.len = 0;
+
+        sb_append(&path, pkg->dir);
+        sb_append_c(&path, '/');
+        sb_append(&path, p);
+
+        const size_t * found = (const size_t *)bsearch(path.buf, sortedEntries + pkg->begin, pkg->end - pkg->begin, sizeof(size_t), compare_path_to_entry_index);
+
+        if (found == NULL) {
+            strings_push(&pkg->missing, strdup2(p));
+            continue;
+        }
+
+        seen[*found] = 1;
+
+        Entry * e = &entries.items[*found];
+
+        if (e->type != type) {
+            strings_push(&pkg->modified, strdup2(p));
+            continue;
+        }
+
+        // a directory, a dangling symlink, a special file or a file unreadable when it was installed.
+        if (type == 'd' || type == 'D' || sha256[0] == '\0' || !e->hash) {
+            continue;
+        }
+
+        if (!deep) {
+            if (stamped && stamp[0] == e->size && stamp[1] == e->mtimeSec && stamp[2] == e->mtimeNsec) {
+                continue;
+            }
+
+            // the size differs from the one whose sha256sum was recorded.
+            if (stamped && stamp[0] != e->size) {
+                strings_push(&pkg->modified, strdup2(p));
+                continue;
+            }
+
+            const CacheEntry * c = cache_find(cache, e);
+
+            if (c != NULL) {
+                if (strcmp(c->sha256, sha256) != 0) {
+                    strings_push(&pkg->modified, strdup2(p));
+                }
+
+                continue;
+            }
+        }
+
+        e->hash = 2;
+
+        add_check(index, *found, p, sha256);
+    }
+
+    free(line);
+    free(stampLine);
+    free(path.buf);
+
+    fclose(manifestFile);
+
+    if (stampsFile != NULL) {
+        fclose(stampsFile);
+    }
+
+    free(manifestFilePath);
+    free(stampsFilePath);
+
+    for (size_t i = pkg->begin; i < pkg->end; i++) {
+        if (!seen[i]) {
+            strings_push(&pkg->extra, strdup2(entries.items[i].path + prefixLength));
+        }
+    }
+
+    return 0;
+}
+
+static void print_json_string(const char * s) {
+    putchar('"');
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+
+        switch (c) {
+            case '"':  fputs("\\\"", stdout); break;
+            case '\\': fputs("\\\\", stdout); break;
+            case '\b': fputs("\\b",  stdout); break;
+            case '\f': fputs("\\f",  stdout); break;
+            case '\n': fputs("\\n",  stdout); break;
+            case '\r': fputs("\\r",  stdout); break;
+            case '\t': fputs("\\t",  stdout); break;
+            default:
+                if (c < 0x20 || c == 0x7F) {
+                    printf("\\u%04x", c);
+                } else {
+                    putchar(c);
+                }
+        }
+    }
+
+    putchar('"');
+}
+
+static void print_json_strings(const char * key, const Strings * strings) {
+    printf(",\"%s\":[", key);
+
+    for (size_t i = 0; i < strings->size; i++) {
+        if (i > 0) putchar(',');
+        print_json_string(strings->items[i]);
+    }
+
+    putchar(']');
+}
+
+static int verify(const char * installedRoot, char * specs[], int specCount, int deep, int json, const char * cacheFilePath, int workerCount) {
+    Cache cache = {0};
+
+    if (cacheFilePath != NULL && cache_read(cacheFilePath, &cache) != 0) {
+        return 1;
+    }
+
+    const size_t oldCacheSize = cache.size;
+
+    packages = (Package*)calloc((size_t)specCount + 1, sizeof(Package));
+
+    if (packages == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (int i = 0; i < specCount; i++) {
+        Package * pkg = &packages[i];
+
+        pkg->spec  = specs[i];
+        pkg->dir   = strdup3(installedRoot, "/", specs[i]);
+        pkg->begin = entries.size;
+
+        if (walk_install_dir(pkg->dir, &entries) != 0) {
+            pkg->failed = 1;
+            entries.size = pkg->begin;
+        }
+
+        pkg->end = entries.size;
+    }
+
+    sortedEntries = (size_t*)malloc((entries.size + 1) * sizeof(size_t));
+
+    char * seen = (char*)calloc(entries.size + 1, 1);
+
+    if (sortedEntries == NULL || seen == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (size_t i = 0; i < entries.size; i++) {
+        sortedEntries[i] = i;
+    }
+
+    for (int i = 0; i < specCount; i++) {
+        qsort(sortedEntries + packages[i].begin, packages[i].end - packages[i].begin, sizeof(size_t), compare_entry_index);
+    }
+
+    for (int i = 0; i < specCount; i++) {
+        if (!packages[i].failed && verify_package((size_t)i, deep, &cache, seen) != 0) {
+            packages[i].failed = 1;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    // only the files which could not be verified by their stamps or the cache are hashed.
+    for (size_t i = 0; i < entries.size; i++) {
+        entries.items[i].hash = entries.items[i].hash == 2;
+    }
+
+    if (hash_entries(workerCount) < 0) {
+        fprintf(stderr, "failed to hash the installed files.\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < checkCount; i++) {
+        const Check * c   = &checks[i];
+        const Entry * e   = &entries.items[c->entry];
+        Package *     pkg = &packages[c->package];
+
+        if (results[c->entry].status != 1) {
+            strings_push(&pkg->modified, c->path);
+            continue;
+        }
+
+        pkg->hashed++;
+
+        CacheEntry * x = cache_add(&cache);
+
+        x->dev       = e->dev;
+        x->ino       = e->ino;
+        x->size      = e->size;
+        x->mtimeSec  = e->mtimeSec;
+        x->mtimeNsec = e->mtimeNsec;
+
+        sha256_to_hex(results[c->entry].digest, x->sha256);
+
+        if (strcmp(x->sha256, c->sha256) != 0) {
+            strings_push(&pkg->modified, c->path);
+        }
+    }
+
+    if (cacheFilePath != NULL && cache.size > oldCacheSize && cache_write(cacheFilePath, &cache, oldCacheSize) != 0) {
+        return 1;
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    size_t totalFiles    = 0;
+    size_t totalHashed   = 0;
+    size_t totalMissing  = 0;
+    size_t totalModified = 0;
+    size_t totalExtra    = 0;
+    size_t totalFailed   = 0;
+
+    if (json) printf("{\"packages\":[");
+
+    for (int i = 0; i < specCount; i++) {
+        Package * pkg = &packages[i];
+
+        qsort(pkg->missing.items,  pkg->missing.size,  sizeof(char*), compare_string);
+        qsort(pkg->modified.items, pkg->modified.size, sizeof(char*), compare_string);
+        qsort(pkg->extra.items,    pkg->extra.size,    sizeof(char*), compare_string);
+
+        totalFiles    += pkg->files;
+        totalHashed   += pkg->hashed;
+        totalMissing  += pkg->missing.size;
+        totalModified += pkg->modified.size;
+        totalExtra    += pkg->extra.size;
+        totalFailed   += (size_t)pkg->failed;
+
+        if (json) {
+            if (i > 0) putchar(',');
+
+            printf("{\"spec\":");
+            print_json_string(pkg->spec);
+            printf(",\"ok\":%s,\"files\":%zu,\"hashed\":%zu", (pkg->failed || pkg->missing.size || pkg->modified.size || pkg->extra.size) ? "false" : "true", pkg->files, pkg->hashed);
+
+            if (pkg->failed) {
+                printf(",\"error\":\"can not be verified\"");
+            }
+
+            print_json_strings("missing",  &pkg->missing);
+            print_json_strings("modified", &pkg->modified);
+            print_json_strings("extra",    &pkg->extra);
+
+            putchar('}');
+        } else {
+            if (pkg->failed) {
+                printf("error    %s can not be verified\n", pkg->spec);
+            }
+
+            for (size_t j = 0; j < pkg->missing.size; j++) {
+                printf("missing  %s %s\n", pkg->spec, pkg->missing.items[j]);
+            }
+
+            for (size_t j = 0; j < pkg->modified.size; j++) {
+                printf("modified %s %s\n", pkg->spec, pkg->modified.items[j]);
+            }
+
+            for (size_t j = 0; j < pkg->extra.size; j++) {
+                printf("extra    %s %s\n", pkg->spec, pkg->extra.items[j]);
+            }
+        }
+    }
+
+    if (json) {
+        printf("],\"files\":%zu,\"hashed\":%zu,\"missing\":%zu,\"modified\":%zu,\"extra\":%zu}\n", totalFiles, totalHashed, totalMissing, totalModified, totalExtra);
+    } else {
+        printf("%d packages, %zu files, %zu hashed, %zu missing, %zu modified, %zu extra\n", specCount, totalFiles, totalHashed, totalMissing, totalModified, totalExtra);
+    }
+
+    if (totalFailed > 0) {
+        return 1;
+    }
+
+    return (totalMissing + totalModified + totalExtra) == 0 ? 0 : 10;
+}
+
+/////////////////////////////////////////////////////////////////
+
+static double seconds_since(const struct timespec * begin) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - begin->tv_sec) + (double)(now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static int benchmark(const char * dir, int workerCount) {
+    struct timespec begin;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    if (walk(strdup2(dir), &entries) != 0) {
+        return 1;
+    }
+
+    printf("walk: %zu files in %.3fs\n", entries.size, seconds_since(&begin));
+
+    // resolve the implementation the cpu supports
+    {
+        SHA256 ctx;
+        uint8_t block[64] = {0};
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, block, sizeof(block));
+    }
+
+    void (*implementations[2])(uint32_t state[8], const uint8_t * data, size_t blocks);
+
+    const char * implementationNames[2];
+
+    int implementationCount = 0;
+
+    if (sha256_transform_blocks != sha256_transform_blocks_generic) {
+        implementations[implementationCount] = sha256_transform_blocks;
+        implementationNames[implementationCount] = "sha-ni";
+        implementationCount++;
+    }
+
+    implementations[implementationCount] = sha256_transform_blocks_generic;
+    implementationNames[implementationCount] = "generic";
+    implementationCount++;
+
+    for (int k = 0; k < implementationCount; k++) {
+        sha256_transform_blocks = implementations[k];
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+
+        const int n = hash_entries(workerCount);
+
+        const double seconds = seconds_since(&begin);
+
+        if (n < 0) {
+            fprintf(stderr, "failed to hash the files of %s\n", dir);
+            return 1;
+        }
+
+        int64_t bytes  = 0;
+        size_t  files  = 0;
+        size_t  failed = 0;
+
+        for (size_t i = 0; i < entries.size; i++) {
+            if (results[i].status == 1) {
+                bytes += entries.items[i].size;
+                files++;
+            } else if (results[i].status == -1) {
+                failed++;
+            }
+        }
+
+        const double elapsed = seconds > 1e-9 ? seconds : 1e-9;
+
+        printf("%s: %zu files, %lld bytes in %.3fs by %d workers, %.1f MB/s, %.0f files/s", implementationNames[k], files, (long long)bytes, seconds, n, (double)bytes / 1e6 / elapsed, (double)files / elapsed);
+
+        if (failed > 0) {
+            printf(", %zu unreadable", failed);
+        }
+
+        printf("\n");
+    }
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <generate|verify|benchmark> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    const char * action = argv[1];
+
+    const int isGenerate = strcmp(action, "generate")  == 0;
+    const int isVerify   = strcmp(action, "verify")    == 0;
+    const int isBench    = strcmp(action, "benchmark") == 0;
+
+    if (!isGenerate && !isVerify && !isBench) {
+        fprintf(stderr, "unrecognized action: %s\n", action);
+        return 1;
+    }
+
+    const char * usage;
+
+    if (isGenerate) {
+        usage = "[--jobs=<N>] [--stamps=<FILE>] <INSTALL-DIR>";
+    } else if (isVerify) {
+        usage = "[--jobs=<N>] [--deep] [--json] [--cache=<FILE>] <INSTALLED-ROOT> <PACKAGE-SPEC>...";
+    } else {
+        usage = "[--jobs=<N>] <DIR>";
+    }
+
+    int workerCount = default_worker_count();
+
+    int deep = 0;
+    int json = 0;
+
+    const char * stampsFilePath = NULL;
+    const char * cacheFilePath  = NULL;
+
+    char ** args = (char**)calloc((size_t)argc, sizeof(char*));
+
+    int argCount = 0;
+
+    if (args == NULL) {
+        perror(NULL);
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (starts_with(argv[i], "--jobs=")) {
+            if (parse_jobs(argv[i] + 7, &workerCount) != 0) {
+                fprintf(stderr, "--jobs=<N>, <N> must be a positive integer, but it is %s\n", argv[i] + 7);
+                return 1;
+            }
+        } else if (isGenerate && starts_with(argv[i], "--stamps=") && argv[i][9] != '\0') {
+            stampsFilePath = argv[i] + 9;
+        } else if (isVerify && starts_with(argv[i], "--cache=") && argv[i][8] != '\0') {
+            cacheFilePath = argv[i] + 8;
+        } else if (isVerify && strcmp(argv[i], "--deep") == 0) {
+            deep = 1;
+        } else if (isVerify && strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (argv[i][0] != '-' && argv[i][0] != '\0' && (isVerify || argCount == 0)) {
+            args[argCount++] = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s %s %s, unrecognized argument: %s\n", argv[0], action, usage, argv[i]);
+            return 1;
+        }
+    }
+
+    if (argCount < (isVerify ? 2 : 1)) {
+        fprintf(stderr, "Usage: %s %s %s\n", argv[0], action, usage);
+        return 1;
+    }
+
+    int ret;
+
+    if (isGenerate) {
+        ret = generate(args[0], stampsFilePath, workerCount);
+    } else if (isVerify) {
+        ret = verify(args[0], args + 1, argCount - 1, deep, json, cacheFilePath, workerCount);
+    } else {
+        ret = benchmark(args[0], workerCount);
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        perror("stdout");
+        return 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,679 @@
+#define _XOPEN_SOURCE 700
+
+#include <regex.h>
+
+#include <unistd.h>
+
+#include "util.h"
+
+// pc-tool tweak --install-dir=<DIR> --ppkg-home=<DIR> --shared-library-suffix=<SUFFIX> [--sysroot=<DIR>] <PC-FILE>...
+//
+// tweak : rewrite every <PC-FILE> in place. each file is read once, the following edits are applied in memory in this order,
+//         then the file is written to a temporary file in the same directory and renamed into place, only if it has been changed.
+//
+//         1. <INSTALL-DIR> is replaced with ${pcfiledir}/../..
+//         2. -I<PPKG-HOME>... -L<PPKG-HOME>... -R... -F... -idirafter... '-isysroot ...' are removed, up to the next space or '
+//         3. -flto -Wl,--strip-debug -Wl,-search_paths_first -Wl,-S are removed
+//         4. <PPKG-HOME>/.../lib<NAME>.<SUFFIX> and <PPKG-HOME>/.../lib<NAME>.a are replaced with -l<NAME>
+//         5. -L<SYSROOT>... and the first --sysroot=<SYSROOT> of a line are removed if --sysroot is given and not empty
+//         6. the value of Libs.private is appended to the Libs line, then the Libs.private line is removed
+//         7. the value of Requires.private is appended to the Requires line, then the Requires.private line is removed.
+//            if there is no Requires line, Requires.private is renamed to Requires
+//
+//         the result is byte-identical to the sed -i commands which __tweak_pc_files ran before, one per edit.
+//         every pattern is a POSIX basic regular expression built in the same way as those commands built it,
+//         so that for example a . in <INSTALL-DIR> matches any character, and .* matches as much as it can.
+//         a file whose Libs.private or Requires.private can not be folded, e.g. it has two Libs lines, is reported and left untouched,
+//         sed failed on such a file as well. the other files are still rewritten, exit 1 if any file failed.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char ** items;      // NULL if the line has been removed
+    size_t  size;
+    size_t  capacity;
+    int     lastNewline; // 1 if the last line ends with a newline
+} PcLines;
+
+static void pc_lines_push(PcLines * lines, char * line) {
+    if (lines->size == lines->capacity) {
+        lines->capacity = lines->capacity == 0 ? 64 : lines->capacity << 1;
+
+        lines->items = (char**)realloc(lines->items, lines->capacity * sizeof(char*));
+
+        if (lines->items == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+    }
+
+    lines->items[lines->size++] = line;
+}
+
+static void pc_lines_free(PcLines * lines) {
+    for (size_t i = 0; i < lines->size; i++) {
+        free(lines->items[i]);
+    }
+
+    free(lines->items);
+}
+
+// the same as sed, a file which does not end with a newline is written back without it.
+static int pc_lines_read(const char * filepath, PcLines * lines, char ** content, size_t * contentSize) {
+    FILE * file = fopen(filepath, "rb");
+
+    if (file == NULL) {
+        perror(filepath);
+        return 1;
+    }
+
+    StringBuffer sb = {0};
+
+    char buf[4096];
+
+    for (;;) {
+        size_t n = fread(buf, 1, sizeof(buf), file);
+
+        if (n > 0) {
+            sb_append_n(&sb, buf, n);
+        }
+
+        if (n < sizeof(buf)) {
+            if (ferror(file)) {
+                perror(filepath);
+                fclose(file);
+                free(sb.buf);
+                return 1;
+            }
+            break;
+        }
+    }
+
+    fclose(file);
+
+    *contentSize = sb.len;
+    *content     = sb_take(&sb);
+
+    if (memchr(*content, '\0', *contentSize) != NULL) {
+        fprintf(stderr, "%s: contains NUL bytes, it is not a pkg-config file.\n", filepath);
+        return 1;
+    }
+
+    lines->lastNewline = 1;
+
+    char * p = *content;
+
+    while (*p != '\0') {
+        char * q = strchr(p, '\n');
+
+        StringBuffer line = {0};
+
+        if (q == NULL) {
+            sb_append(&line, p);
+            pc_lines_push(lines, sb_take(&line));
+            lines->lastNewline = 0;
+            break;
+        }
+
+        sb_append_n(&line, p, (size_t)(q - p));
+        pc_lines_push(lines, sb_take(&line));
+
+        p = q + 1;
+    }
+
+    return 0;
+}
+
+static void pc_lines_write_to(const PcLines * lines, StringBuffer * sb) {
+    for (size_t i = 0; i < lines->size; i++) {
+        if (lines->items[i] == NULL) {
+            continue;
+        }
+
+        sb_append(sb, lines->items[i]);
+
+        if (i + 1 < lines->size || lines->lastNewline) {
+            sb_append_c(sb, '\n');
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+
+static int compile_regex(regex_t * re, const char * pattern) {
+    int ret = regcomp(re, pattern, 0);
+
+    if (ret != 0) {
+        char msg[256];
+        regerror(ret, re, msg, sizeof(msg));
+        fprintf(stderr, "invalid regular expression: %s : %s\n", pattern, msg);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int line_matches(const regex_t * re, const char * line) {
+    return regexec(re, line, 0, NULL, 0) == 0;
+}
+
+// & is the matched text, \1 to \9 are the groups, \n is a newline, any other \c is c, the same as the replacement of sed s command.
+static void expand_replacement(StringBuffer * sb, const char * replacement, const char * s, const regmatch_t m[10]) {
+    for (const char * r = replacement; *r != '\0'; r++) {
+        if (*r == '&') {
+            sb_append_n(sb, s + m[0].rm_so, (size_t)(m[0].rm_eo - m[0].rm_so));
+        } else if (*r == '\\' && r[1] != '\0') {
+            r++;
+
+            if (*r >= '0' && *r <= '9') {
+                int i = *r - '0';
+
+                if (m[i].rm_so != -1) {
+                    sb_append_n(sb, s + m[i].rm_so, (size_t)(m[i].rm_eo - m[i].rm_so));
+                }
+            } else if (*r == 'n') {
+                sb_append_c(sb, '\n');
+            } else if (*r == 't') {
+                sb_append_c(sb, '\t');
+            } else {
+                sb_append_c(sb, *r);
+            }
+        } else {
+            sb_append_c(sb, *r);
+        }
+    }
+}
+
+// sed rejects a replacement which refers to a group that the regular expression does not have.
+static int is_valid_replacement(const char * replacement, size_t groupCount) {
+    for (const char * r = replacement; *r != '\0'; r++) {
+        if (*r == '\\' && r[1] != '\0') {
+            r++;
+
+            if (*r >= '1' && *r <= '9' && (size_t)(*r - '0') > groupCount) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// the same as sed 's|<RE>|<REPLACEMENT>|' or 's|<RE>|<REPLACEMENT>|g' on one line.
+// returns 1 and replaces *line if anything matched.
+static int substitute(char ** line, const regex_t * re, const char * replacement, int global) {
+    const char * p = *line;
+
+    StringBuffer sb = {0};
+
+    regmatch_t m[10];
+
+    int eflags  = 0;
+    int matched = 0;
+
+    for (;;) {
+        if (regexec(re, p, 10, m, eflags) != 0) {
+            break;
+        }
+
+        matched = 1;
+
+        sb_append_n(&sb, p, (size_t)m[0].rm_so);
+
+        expand_replacement(&sb, replacement, p, m);
+
+        const char * end = p + m[0].rm_eo;
+
+        if (m[0].rm_eo == m[0].rm_so) {
+            // an empty match, step over one character so that it does not match again.
+            if (*end == '\0') {
+                p = end;
+                break;
+            }
+
+            sb_append_c(&sb, *end);
+            end++;
+        }
+
+        p = end;
+
+        eflags = REG_NOTBOL;
+
+        if (!global || *p == '\0') {
+            break;
+        }
+    }
+
+    if (!matched) {
+        return 0;
+    }
+
+    sb_append(&sb, p);
+
+    free(*line);
+
+    *line = sb_take(&sb);
+
+    return 1;
+}
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    regex_t re;
+    char *  replacement;
+    int     global;
+} Edit;
+
+typedef struct {
+    Edit    edits[16];
+    size_t  editCount;
+
+    regex_t libs;               // Libs:
+    regex_t libsPrivate;        // Libs.private:
+    regex_t libsPrivateLine;    // Libs.private
+    regex_t requires;           // Requires:
+    regex_t requiresPrivate;    // Requires.private:
+    regex_t lineEnd;            // $
+} Tweaker;
+
+static int tweaker_add(Tweaker * tweaker, const char * pattern, const char * replacement, int global) {
+    Edit * edit = &tweaker->edits[tweaker->editCount];
+
+    if (compile_regex(&edit->re, pattern) != 0) {
+        return 1;
+    }
+
+    edit->replacement = strdup2(replacement);
+    edit->global      = global;
+
+    tweaker->editCount++;
+
+    return 0;
+}
+
+static int tweaker_init(Tweaker * tweaker, const char * installDir, const char * ppkgHome, const char * sharedLibrarySuffix, const char * sysroot) {
+    memset(tweaker, 0, sizeof(Tweaker));
+
+    if (sharedLibrarySuffix[0] == '.') {
+        sharedLibrarySuffix++;
+    }
+
+    char * a = strdup3("-I", ppkgHome, "[^' ]*");
+    char * b = strdup3("-L", ppkgHome, "[^' ]*");
+    char * c = strdup3(ppkgHome, "/.*/lib\\(.*\\)\\.", sharedLibrarySuffix);
+    char * d = strdup3(ppkgHome, "/.*/lib\\(.*\\)\\.a", "");
+
+    int ret = tweaker_add(tweaker, installDir, "${pcfiledir}/../..", 1)
+           || tweaker_add(tweaker, a, "", 1)
+           || tweaker_add(tweaker, b, "", 1)
+           || tweaker_add(tweaker, "-R[^' ]*", "", 1)
+           || tweaker_add(tweaker, "-F[^' ]*", "", 1)
+           || tweaker_add(tweaker, "-idirafter[^' ]*", "", 1)
+           || tweaker_add(tweaker, "-isysroot [^' ]*", "", 1)
+           || tweaker_add(tweaker, "-flto", "", 1)
+           || tweaker_add(tweaker, "-Wl,--strip-debug", "", 1)
+           || tweaker_add(tweaker, "-Wl,-search_paths_first", "", 1)
+           || tweaker_add(tweaker, "-Wl,-S", "", 1)
+           || tweaker_add(tweaker, c, "-l\\1", 1)
+           || tweaker_add(tweaker, d, "-l\\1", 1);
+
+    free(a);
+    free(b);
+    free(c);
+    free(d);
+
+    if (ret != 0) {
+        return 1;
+    }
+
+    if (sysroot != NULL && sysroot[0] != '\0') {
+        char * e = strdup3("-L", sysroot, "[^' ]*");
+        char * f = strdup3("--sysroot=", sysroot, "");
+
+        ret = tweaker_add(tweaker, e, "", 1)
+           || tweaker_add(tweaker, f, "", 0);
+
+        free(e);
+        free(f);
+
+        if (ret != 0) {
+            return 1;
+        }
+    }
+
+    return compile_regex(&tweaker->libs,            "Libs:")
+        || compile_regex(&tweaker->libsPrivate,     "Libs.private:")
+        || compile_regex(&tweaker->libsPrivateLine, "Libs.private")
+        || compile_regex(&tweaker->requires,        "Requires:")
+        || compile_regex(&tweaker->requiresPrivate, "Requires.private:")
+        || compile_regex(&tweaker->lineEnd,         "$");
+}
+
+static int any_line_matches(const PcLines * lines, const regex_t * re) {
+    for (size_t i = 0; i < lines->size; i++) {
+        if (lines->items[i] != NULL && line_matches(re, lines->items[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void remove_matched_lines(PcLines * lines, const regex_t * re) {
+    for (size_t i = 0; i < lines->size; i++) {
+        if (lines->items[i] != NULL && line_matches(re, lines->items[i])) {
+            free(lines->items[i]);
+            lines->items[i] = NULL;
+        }
+    }
+}
+
+// the same as $(...) of sh, the trailing newlines are removed.
+static char * take_command_output(StringBuffer * sb) {
+    while (sb->len > 0 && sb->buf[sb->len - 1] == '\n') {
+        sb->buf[--sb->len] = '\0';
+    }
+
+    return sb_take(sb);
+}
+
+// the value which was embedded into a sed s|||, it could not contain a newline nor the delimiter.
+static int can_be_embedded(const char * s) {
+    return strchr(s, '\n') == NULL && strchr(s, '|') == NULL;
+}
+
+// LIBS_CONTENT=$(awk '/Libs:/{print}')
+// LIBS_PRIVATE_CONTENT=$(awk -F: '/Libs.private:/{print $2}')
+// sed "s|$LIBS_CONTENT|$LIBS_CONTENT$LIBS_PRIVATE_CONTENT|"
+// sed '/Libs.private/d'
+static int fold_libs_private(const char * filepath, PcLines * lines, const Tweaker * tweaker) {
+    StringBuffer libs        = {0};
+    StringBuffer libsPrivate = {0};
+
+    for (size_t i = 0; i < lines->size; i++) {
+        const char * line = lines->items[i];
+
+        if (line == NULL) {
+            continue;
+        }
+
+        if (line_matches(&tweaker->libs, line)) {
+            sb_append(&libs, line);
+            sb_append_c(&libs, '\n');
+        }
+
+        if (line_matches(&tweaker->libsPrivate, line)) {
+            const char * p = strchr(line, ':') + 1;
+            const char * q = strchr(p, ':');
+
+            sb_append_n(&libsPrivate, p, q == NULL ? strlen(p) : (size_t)(q - p));
+            sb_append_c(&libsPrivate, '\n');
+        }
+    }
+
+    char * pattern = take_command_output(&libs);
+    char * value   = take_command_output(&libsPrivate);
+
+    if (pattern[0] == '\0' || !can_be_embedded(pattern) || !can_be_embedded(value)) {
+        fprintf(stderr, "%s: Libs.private can not be folded into Libs, there must be exactly one Libs line and one Libs.private line.\n", filepath);
+        free(pattern);
+        free(value);
+        return 1;
+    }
+
+    regex_t re;
+
+    if (compile_regex(&re, pattern) != 0) {
+        fprintf(stderr, "%s: Libs.private can not be folded into Libs.\n", filepath);
+        free(pattern);
+        free(value);
+        return 1;
+    }
+
+    char * replacement = strdup3(pattern, value, "");
+
+    if (!is_valid_replacement(replacement, re.re_nsub)) {
+        fprintf(stderr, "%s: Libs.private can not be folded into Libs.\n", filepath);
+        regfree(&re);
+        free(pattern);
+        free(value);
+        free(replacement);
+        return 1;
+    }
+
+    for (size_t i = 0; i < lines->size; i++) {
+        if (lines->items[i] != NULL) {
+            substitute(&lines->items[i], &re, replacement, 0);
+        }
+    }
+
+    regfree(&re);
+
+    free(pattern);
+    free(value);
+    free(replacement);
+
+    remove_matched_lines(lines, &tweaker->libsPrivateLine);
+
+    return 0;
+}
+
+// REQUIRES_PRIVATE_CONTENT=$(sed -n '/Requires.private:/p' | cut -c18-)
+// sed "/Requires:/s|\$|$REQUIRES_PRIVATE_CONTENT|"
+// sed '/Requires.private:/d'
+static int fold_requires_private(const char * filepath, PcLines * lines, const Tweaker * tweaker) {
+    if (!any_line_matches(lines, &tweaker->requires)) {
+        for (size_t i = 0; i < lines->size; i++) {
+            if (lines->items[i] != NULL) {
+                substitute(&lines->items[i], &tweaker->requiresPrivate, "Requires:", 0);
+            }
+        }
+
+        return 0;
+    }
+
+    StringBuffer requiresPrivate = {0};
+
+    for (size_t i = 0; i < lines->size; i++) {
+        const char * line = lines->items[i];
+
+        if (line != NULL && line_matches(&tweaker->requiresPrivate, line)) {
+            size_t n = strlen(line);
+
+            // cut -c18- , Requires.private: is 17 characters
+            if (n > 17) {
+                sb_append(&requiresPrivate, line + 17);
+            }
+
+            sb_append_c(&requiresPrivate, '\n');
+        }
+    }
+
+    char * value = take_command_output(&requiresPrivate);
+
+    if (!can_be_embedded(value) || !is_valid_replacement(value, 0)) {
+        fprintf(stderr, "%s: Requires.private can not be folded into Requires, there must be exactly one Requires.private line.\n", filepath);
+        free(value);
+        return 1;
+    }
+
+    for (size_t i = 0; i < lines->size; i++) {
+        if (lines->items[i] != NULL && line_matches(&tweaker->requires, lines->items[i])) {
+            substitute(&lines->items[i], &tweaker->lineEnd, value, 0);
+        }
+    }
+
+    free(value);
+
+    remove_matched_lines(lines, &tweaker->requiresPrivate);
+
+    return 0;
+}
+
+static int write_file_atomically(const char * filepath, const char * content, size_t size) {
+    struct stat st;
+
+    if (stat(filepath, &st) != 0) {
+        perror(filepath);
+        return 1;
+    }
+
+    char * tmpFilePath = strdup3(filepath, ".XXXXXX", "");
+
+    int fd = mkstemp(tmpFilePath);
+
+    if (fd == -1) {
+        perror(tmpFilePath);
+        free(tmpFilePath);
+        return 1;
+    }
+
+    size_t written = 0;
+
+    while (written < size) {
+        ssize_t n = write(fd, content + written, size - written);
+
+        if (n == -1) {
+            perror(tmpFilePath);
+            close(fd);
+            unlink(tmpFilePath);
+            free(tmpFilePath);
+            return 1;
+        }
+
+        written += (size_t)n;
+    }
+
+    if (fchmod(fd, st.st_mode & 07777) != 0 || close(fd) != 0) {
+        perror(tmpFilePath);
+        unlink(tmpFilePath);
+        free(tmpFilePath);
+        return 1;
+    }
+
+    if (rename(tmpFilePath, filepath) != 0) {
+        perror(filepath);
+        unlink(tmpFilePath);
+        free(tmpFilePath);
+        return 1;
+    }
+
+    free(tmpFilePath);
+
+    return 0;
+}
+
+static int tweak_pc_file(const char * filepath, const Tweaker * tweaker) {
+    PcLines lines = {0};
+
+    char * content = NULL;
+    size_t contentSize = 0;
+
+    if (pc_lines_read(filepath, &lines, &content, &contentSize) != 0) {
+        pc_lines_free(&lines);
+        free(content);
+        return 1;
+    }
+
+    // every edit is confined to a line, applying all of them line by line is the same as applying them one after another to the whole file.
+    for (size_t i = 0; i < lines.size; i++) {
+        for (size_t j = 0; j < tweaker->editCount; j++) {
+            const Edit * edit = &tweaker->edits[j];
+            substitute(&lines.items[i], &edit->re, edit->replacement, edit->global);
+        }
+    }
+
+    int ret = 0;
+
+    if (any_line_matches(&lines, &tweaker->libsPrivate)) {
+        ret = fold_libs_private(filepath, &lines, tweaker);
+    }
+
+    if (ret == 0 && any_line_matches(&lines, &tweaker->requiresPrivate)) {
+        ret = fold_requires_private(filepath, &lines, tweaker);
+    }
+
+    if (ret == 0) {
+        StringBuffer sb = {0};
+
+        pc_lines_write_to(&lines, &sb);
+
+        if (sb.len != contentSize || memcmp(sb.buf, content, contentSize) != 0) {
+            ret = write_file_atomically(filepath, sb.buf == NULL ? "" : sb.buf, sb.len);
+        }
+
+        free(sb.buf);
+    }
+
+    pc_lines_free(&lines);
+    free(content);
+
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <tweak> [ARG]...\n", argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "tweak") != 0) {
+        fprintf(stderr, "unrecognized action: %s\n", argv[1]);
+        return 1;
+    }
+
+    const char * usage = "--install-dir=<DIR> --ppkg-home=<DIR> --shared-library-suffix=<SUFFIX> [--sysroot=<DIR>] <PC-FILE>...";
+
+    const char * installDir          = NULL;
+    const char * ppkgHome            = NULL;
+    const char * sharedLibrarySuffix = NULL;
+    const char * sysroot             = NULL;
+
+    int i = 2;
+
+    for (; i < argc; i++) {
+        if (starts_with(argv[i], "--install-dir=") && argv[i][14] != '\0') {
+            installDir = argv[i] + 14;
+        } else if (starts_with(argv[i], "--ppkg-home=") && argv[i][12] != '\0') {
+            ppkgHome = argv[i] + 12;
+        } else if (starts_with(argv[i], "--shared-library-suffix=") && argv[i][24] != '\0') {
+            sharedLibrarySuffix = argv[i] + 24;
+        } else if (starts_with(argv[i], "--sysroot=")) {
+            sysroot = argv[i] + 10;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unrecognized option: %s\nUsage: %s tweak %s\n", argv[i], argv[0], usage);
+            return 1;
+        } else {
+            break;
+        }
+    }
+
+    if (installDir == NULL || ppkgHome == NULL || sharedLibrarySuffix == NULL) {
+        fprintf(stderr, "Usage: %s tweak %s\n", argv[0], usage);
+        return 1;
+    }
+
+    Tweaker tweaker;
+
+    if (tweaker_init(&tweaker, installDir, ppkgHome, sharedLibrarySuffix, sysroot) != 0) {
+        return 1;
+    }
+
+    int ret = 0;
+
+    for (; i < argc; i++) {
+        if (tweak_pc_file(argv[i], &tweaker) != 0) {
+            ret = 1;
+        }
+    }
+
+    if (fflush(stdout) != 0) {
+        perror(NULL);
+        return 1;
+    }
+
+    return ret;
+}
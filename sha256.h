@@ -0,0 +1,307 @@
+#ifndef PPKG_SHA256_H
+#define PPKG_SHA256_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined (__x86_64__) && (defined (__GNUC__) || defined (__clang__))
+#define SHA256_X86_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// FIPS 180-4 SHA-256
+//
+// the blocks are compressed by the SHA extensions of x86-64 (SHA-NI) if the cpu has them, by the portable C code otherwise.
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t  buffer[64];
+    size_t   bufferSize;
+} SHA256;
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t S1 = SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + S1 + ch + SHA256_K[i] + w[i];
+        uint32_t S0 = SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22);
+        uint32_t mj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = S0 + mj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void sha256_transform_blocks_generic(uint32_t state[8], const uint8_t * data, size_t blocks) {
+    for (size_t i = 0; i < blocks; i++) {
+        sha256_transform(state, data + i * 64);
+    }
+}
+
+#if defined (SHA256_X86_SHA_NI)
+
+// the same as sha256_transform, the state is kept in the ABEF/CDGH order sha256rnds2 wants.
+__attribute__((target("sha,sse4.1")))
+static void sha256_transform_blocks_sha_ni(uint32_t state[8], const uint8_t * data, size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);  // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);  // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                       // ABEF
+
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                            // CDGH
+
+    for (; blocks > 0; blocks--, data += 64) {
+        const __m128i abef = state0;
+        const __m128i cdgh = state1;
+
+        __m128i w[4];
+
+        for (int i = 0; i < 4; i++) {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), MASK);
+        }
+
+        // 4 rounds per iteration, w[i & 3] holds W[4i] ... W[4i + 3]
+        for (int i = 0; i < 16; i++) {
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i *)&SHA256_K[i * 4]));
+
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg    = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+            if (i < 12) {
+                __m128i x = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+
+                x = _mm_add_epi32(x, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+
+                w[i & 3] = _mm_sha256msg2_epu32(x, w[(i + 3) & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);   // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);   // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // ABEF
+
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+static int sha256_cpu_has_sha_ni(void) {
+    unsigned int a, b, c, d;
+
+    // SSSE3 and SSE4.1
+    if (!__get_cpuid(1, &a, &b, &c, &d) || (c & (1U << 9)) == 0 || (c & (1U << 19)) == 0) {
+        return 0;
+    }
+
+    // SHA
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d) || (b & (1U << 29)) == 0) {
+        return 0;
+    }
+
+    return 1;
+}
+
+#endif
+
+static void sha256_transform_blocks_auto(uint32_t state[8], const uint8_t * data, size_t blocks);
+
+// compress <BLOCKS> 64-byte blocks, the implementation is chosen by the cpu at the first call.
+static void (*sha256_transform_blocks)(uint32_t state[8], const uint8_t * data, size_t blocks) = sha256_transform_blocks_auto;
+
+static void sha256_transform_blocks_auto(uint32_t state[8], const uint8_t * data, size_t blocks) {
+    sha256_transform_blocks = sha256_transform_blocks_generic;
+
+#if defined (SHA256_X86_SHA_NI)
+    if (sha256_cpu_has_sha_ni()) {
+        sha256_transform_blocks = sha256_transform_blocks_sha_ni;
+    }
+#endif
+
+    sha256_transform_blocks(state, data, blocks);
+}
+
+static inline void sha256_init(SHA256 * ctx) {
+    static const uint32_t H0[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+    memcpy(ctx->state, H0, sizeof(H0));
+
+    ctx->length = 0;
+    ctx->bufferSize = 0;
+}
+
+static inline void sha256_update(SHA256 * ctx, const void * data, size_t size) {
+    const uint8_t * p = (const uint8_t *)data;
+
+    ctx->length += size;
+
+    if (ctx->bufferSize > 0) {
+        size_t n = 64 - ctx->bufferSize;
+
+        if (n > size) n = size;
+
+        memcpy(ctx->buffer + ctx->bufferSize, p, n);
+
+        ctx->bufferSize += n;
+
+        p    += n;
+        size -= n;
+
+        if (ctx->bufferSize < 64) {
+            return;
+        }
+
+        sha256_transform_blocks(ctx->state, ctx->buffer, 1);
+
+        ctx->bufferSize = 0;
+    }
+
+    if (size >= 64) {
+        const size_t blocks = size / 64;
+
+        sha256_transform_blocks(ctx->state, p, blocks);
+
+        p    += blocks * 64;
+        size -= blocks * 64;
+    }
+
+    if (size > 0) {
+        memcpy(ctx->buffer, p, size);
+        ctx->bufferSize = size;
+    }
+}
+
+static inline void sha256_final(SHA256 * ctx, uint8_t digest[32]) {
+    uint64_t bits = ctx->length * 8;
+
+    uint8_t pad[72] = { 0x80 };
+
+    size_t padSize = (ctx->bufferSize < 56) ? (56 - ctx->bufferSize) : (120 - ctx->bufferSize);
+
+    for (int i = 0; i < 8; i++) {
+        pad[padSize + i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+
+    sha256_update(ctx, pad, padSize + 8);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4]     = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)(ctx->state[i]);
+    }
+}
+
+static inline void sha256_to_hex(const uint8_t digest[32], char hex[65]) {
+    static const char * const HEX = "0123456789abcdef";
+
+    for (int i = 0; i < 32; i++) {
+        hex[i * 2]     = HEX[digest[i] >> 4];
+        hex[i * 2 + 1] = HEX[digest[i] & 0x0F];
+    }
+
+    hex[64] = '\0';
+}
+
+// returns 0 on success, otherwise returns -1 and errno is set.
+static inline int sha256_of_file(const char * filepath, char hex[65]) {
+    FILE * file = fopen(filepath, "rb");
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    SHA256 ctx;
+
+    sha256_init(&ctx);
+
+    uint8_t buf[65536];
+
+    for (;;) {
+        size_t n = fread(buf, 1, sizeof(buf), file);
+
+        if (n > 0) {
+            sha256_update(&ctx, buf, n);
+        }
+
+        if (n < sizeof(buf)) {
+            break;
+        }
+    }
+
+    int failed = ferror(file);
+
+    fclose(file);
+
+    if (failed) {
+        return -1;
+    }
+
+    uint8_t digest[32];
+
+    sha256_final(&ctx, digest);
+    sha256_to_hex(digest, hex);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef PPKG_UTIL_H
+#define PPKG_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+// the string and file helpers shared by the core tools.
+// they are static inline, so that a tool which uses only some of them is not warned about the others.
+
+/////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char * buf;
+    size_t len;
+    size_t cap;
+} StringBuffer;
+
+static inline void sb_append_n(StringBuffer * sb, const char * s, size_t n) {
+    if (sb->len + n + 1 > sb->cap) {
+        size_t cap = sb->cap == 0 ? 256 : sb->cap;
+
+        while (sb->len + n + 1 > cap) {
+            cap <<= 1;
+        }
+
+        char * p = (char*)realloc(sb->buf, cap);
+
+        if (p == NULL) {
+            perror(NULL);
+            exit(1);
+        }
+
+        sb->buf = p;
+        sb->cap = cap;
+    }
+
+    memcpy(sb->buf + sb->len, s, n);
+    sb->len += n;
+    sb->buf[sb->len] = '\0';
+}
+
+static inline void sb_append(StringBuffer * sb, const char * s) {
+    sb_append_n(sb, s, strlen(s));
+}
+
+static inline void sb_append_c(StringBuffer * sb, char c) {
+    sb_append_n(sb, &c, 1);
+}
+
+static inline char * sb_take(StringBuffer * sb) {
+    if (sb->buf == NULL) {
+        sb_append_n(sb, "", 0);
+    }
+
+    char * p = sb->buf;
+
+    sb->buf = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+
+    return p;
+}
+
+static inline char * strdup2(const char * s) {
+    StringBuffer sb = {0};
+    sb_append(&sb, s);
+    return sb_take(&sb);
+}
+
+static inline char * strdup3(const char * a, const char * b, const char * c) {
+    StringBuffer sb = {0};
+    sb_append(&sb, a);
+    sb_append(&sb, b);
+    sb_append(&sb, c);
+    return sb_take(&sb);
+}
+
+static inline int starts_with(const char * s, const char * prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+static inline int ends_with(const char * s, const char * suffix) {
+    size_t m = strlen(s);
+    size_t n = strlen(suffix);
+    return m >= n && strcmp(s + m - n, suffix) == 0;
+}
+
+static inline int is_blank(const char * s) {
+    for (; *s != '\0'; s++) {
+        if (*s != ' ' && *s != '\t') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static inline int is_integer(const char * s) {
+    if (*s == '+' || *s == '-') s++;
+
+    if (*s == '\0') return 0;
+
+    for (; *s != '\0'; s++) {
+        if (*s < '0' || *s > '9') return 0;
+    }
+
+    return 1;
+}
+
+static inline int compare_string(const void * a, const void * b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// <S> is an integer with an optional K, M, G or T suffix, e.g. 5G. returns 1 if it is not.
+static inline int parse_size(const char * s, int64_t * size) {
+    char * end;
+
+    long long n = strtoll(s, &end, 10);
+
+    if (end == s || n < 0) {
+        return 1;
+    }
+
+    switch (*end) {
+        case '\0': break;
+        case 'K': case 'k': n <<= 10; end++; break;
+        case 'M': case 'm': n <<= 20; end++; break;
+        case 'G': case 'g': n <<= 30; end++; break;
+        case 'T': case 't': n <<= 40; end++; break;
+        default: return 1;
+    }
+
+    if (*end != '\0') {
+        return 1;
+    }
+
+    *size = (int64_t)n;
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+
+#if defined (__APPLE__)
+#define ST_MTIME_SEC(st)  ((int64_t)(st).st_mtimespec.tv_sec)
+#define ST_MTIME_NSEC(st) ((int64_t)(st).st_mtimespec.tv_nsec)
+#else
+#define ST_MTIME_SEC(st)  ((int64_t)(st).st_mtim.tv_sec)
+#define ST_MTIME_NSEC(st) ((int64_t)(st).st_mtim.tv_nsec)
+#endif
+
+static inline int exists(const char * path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+static inline int is_regular_file(const char * path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static inline int is_directory(const char * path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// write all of <BUF>, a write interrupted by a signal is resumed. returns -1 on error.
+static inline int write_fully(int fd, const void * buf, size_t size) {
+    const char * p = (const char *)buf;
+
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        p    += n;
+        size -= (size_t)n;
+    }
+
+    return 0;
+}
+
+static inline int copy_file(const char * from, const char * to) {
+    FILE * in = fopen(from, "rb");
+
+    if (in == NULL) {
+        perror(from);
+        return 1;
+    }
+
+    FILE * out = fopen(to, "wb");
+
+    if (out == NULL) {
+        perror(to);
+        fclose(in);
+        return 1;
+    }
+
+    char buf[8192];
+
+    for (;;) {
+        size_t n = fread(buf, 1, sizeof(buf), in);
+
+        if (n > 0 && fwrite(buf, 1, n, out) != n) {
+            perror(to);
+            fclose(in);
+            fclose(out);
+            return 1;
+        }
+
+        if (n < sizeof(buf)) break;
+    }
+
+    int ret = ferror(in);
+
+    if (ret != 0) {
+        perror(from);
+    }
+
+    fclose(in);
+
+    if (fclose(out) != 0) {
+        perror(to);
+        return 1;
+    }
+
+    return ret;
+}
+
+#endif
@@ -1,8 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "compile-trace.h"
+
 int main(int argc, char * argv[]) {
     char * const cxxc = getenv("PROXIED_CXX_FOR_BUILD");
 
@@ -34,6 +38,14 @@ int main(int argc, char * argv[]) {
         argv2[argc + 2] = NULL;
     }
 
+    CompileTrace trace;
+
+    if (compile_trace_begin(&trace)) {
+        int ret = compile_trace_spawn(cxxc, argv2);
+        compile_trace_end(&trace, compile_trace_action_of(argv2), NULL, argv2, ret);
+        return ret;
+    }
+
     execv (cxxc, argv2);
     perror(cxxc);
     return 255;
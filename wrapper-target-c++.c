@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -6,6 +8,10 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "compile-cache.h"
+#include "compile-commands.h"
+#include "compile-trace.h"
+
 #define ACTION_PREPROCESS                           1
 #define ACTION_COMPILE                              2
 #define ACTION_ASSEMBLE                             3
@@ -288,6 +294,36 @@ int main(int argc, char * argv[]) {
 
     /////////////////////////////////////////////////////////////////
 
+    if (action != ACTION_PREPROCESS) {
+        compile_commands_record(argv2);
+    }
+
+    /////////////////////////////////////////////////////////////////
+
+    static const char * const actionNames[] = { "link", "preprocess", "compile", "assemble", "shared", "static-exe" };
+
+    CompileTrace trace;
+
+    const int traced = compile_trace_begin(&trace);
+
+    if (action == ACTION_ASSEMBLE) {
+        int ret = compile_cache_run(compiler, argv2);
+
+        if (ret >= 0) {
+            if (traced) {
+                compile_trace_end(&trace, actionNames[action], compile_cache_outcome, argv2, ret);
+            }
+
+            return ret;
+        }
+    }
+
+    if (traced) {
+        int ret = compile_trace_spawn(compiler, argv2);
+        compile_trace_end(&trace, actionNames[action], compile_cache_outcome, argv2, ret);
+        return ret;
+    }
+
     execv (compiler, argv2);
     perror(compiler);
     return 255;